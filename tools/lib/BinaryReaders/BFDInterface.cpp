@@ -35,6 +35,7 @@
 
 #include "BFDInterface.h"
 #include "Binary.h"
+#include "DwarfReader.h"
 
 #include "Pe.h"
 #include "Macho.h"
@@ -42,7 +43,10 @@
 #include "llvm/Support/system_error.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <cassert>
+#include <pthread.h>
+#include <sys/stat.h>
 
 #include <algorithm>
 #include <iostream>
@@ -52,27 +56,96 @@
 namespace s2etools
 {
 
+namespace {
+
+//libbfd has global state, calls must not overlap even on different files
+pthread_mutex_t s_bfdLock = PTHREAD_MUTEX_INITIALIZER;
+
+class BfdLock
+{
+public:
+    BfdLock() {
+        pthread_mutex_lock(&s_bfdLock);
+    }
+
+    ~BfdLock() {
+        pthread_mutex_unlock(&s_bfdLock);
+    }
+};
+
+//BFD reads the file through the mapping held by m_file
+//instead of opening it a second time
+void *openMapping(struct bfd *abfd, void *closure)
+{
+    return closure;
+}
+
+file_ptr readMapping(struct bfd *abfd, void *stream, void *buf, file_ptr nbytes, file_ptr offset)
+{
+    llvm::MemoryBuffer *file = (llvm::MemoryBuffer*)stream;
+    file_ptr size = file->getBufferSize();
+    if (offset < 0 || nbytes < 0 || offset >= size) {
+        return 0;
+    }
+
+    if (nbytes > size - offset) {
+        nbytes = size - offset;
+    }
+    memcpy(buf, file->getBufferStart() + offset, nbytes);
+    return nbytes;
+}
+
+int closeMapping(struct bfd *abfd, void *stream)
+{
+    return 0;
+}
+
+int statMapping(struct bfd *abfd, void *stream, struct stat *sb)
+{
+    llvm::MemoryBuffer *file = (llvm::MemoryBuffer*)stream;
+    memset(sb, 0, sizeof(*sb));
+    sb->st_mode = S_IFREG | S_IRUSR;
+    sb->st_size = file->getBufferSize();
+    return 0;
+}
+
+}
+
 bool BFDInterface::s_bfdInited = false;
+const uint64_t BFDInterface::CowPageSize;
 
 BFDInterface::BFDInterface(const std::string &fileName):ExecutableFile(fileName)
 {
     m_bfd = NULL;
     m_symbolTable = NULL;
+    m_symbolCount = 0;
+    m_symbolsInited = false;
     //Fail loading if the image has no symbols
     m_requireSymbols = true;
 
-    llvm::MemoryBuffer::getFile(fileName.c_str(), m_file);
+    //Large files get mmapped, the mapping is shared with BFD and the readers
+    llvm::MemoryBuffer::getFile(fileName.c_str(), m_file, -1, false);
 
     m_binary = NULL;
+    m_binaryInited = false;
+    m_dwarf = NULL;
+    m_dwarfInited = false;
+    m_functionsInited = false;
 }
 
 BFDInterface::BFDInterface(const std::string &fileName, bool requireSymbols):ExecutableFile(fileName)
 {
     m_bfd = NULL;
     m_symbolTable = NULL;
+    m_symbolCount = 0;
+    m_symbolsInited = false;
     m_requireSymbols = requireSymbols;
-    llvm::MemoryBuffer::getFile(fileName.c_str(), m_file);
+    llvm::MemoryBuffer::getFile(fileName.c_str(), m_file, -1, false);
     m_binary = NULL;
+    m_binaryInited = false;
+    m_dwarf = NULL;
+    m_dwarfInited = false;
+    m_functionsInited = false;
 }
 
 BFDInterface::~BFDInterface()
@@ -81,7 +154,10 @@ BFDInterface::~BFDInterface()
         delete m_binary;
     }
 
+    delete m_dwarf;
+
     if (m_bfd) {
+        BfdLock lock;
         free(m_symbolTable);
         bfd_close(m_bfd);
     }
@@ -95,18 +171,6 @@ void BFDInterface::initSections(bfd *abfd, asection *sect, void *obj)
     s.start = sect->vma;
     s.size = sect->size;
 
-    //Deal with relocations
-    if (bfd_get_section_flags(abfd, sect) & SEC_RELOC) {
-        long reloc_size = bfd_get_reloc_upper_bound(bfdptr->m_bfd, sect);
-        if (reloc_size > 0) {
-            arelent **relent = (arelent**)malloc (reloc_size);
-            long res = bfd_canonicalize_reloc(abfd, sect, relent, bfdptr->m_symbolTable);
-            if (res < 0) {
-                free(relent);
-            }
-        }
-    }
-
     bfdptr->m_sections[s] = sect;
 }
 
@@ -117,21 +181,28 @@ bool BFDInterface::initialize()
 
 bool BFDInterface::initialize(const std::string &format)
 {
+    if (m_bfd) {
+        return true;
+    }
+
+    BfdLock lock;
     if (!s_bfdInited) {
         bfd_init();
         s_bfdInited = true;
     }
 
-    if (m_bfd) {
-        return true;
-    }
-
     const char *bfdFormat = NULL;
     if (format.size() > 0) {
         bfdFormat = format.c_str();
     }
 
-    m_bfd = bfd_fopen(m_fileName.c_str(), bfdFormat, "rw", -1);
+    if (!m_file.get()) {
+        std::cerr << "Could not open bfd file " << m_fileName << std::endl;
+        return false;
+    }
+
+    m_bfd = bfd_openr_iovec(m_fileName.c_str(), bfdFormat, openMapping, m_file.get(),
+                            readMapping, closeMapping, statMapping);
     if (!m_bfd) {
         std::cerr << "Could not open bfd file " << m_fileName << " - ";
         std::cerr << bfd_errmsg(bfd_get_error()) << std::endl;
@@ -145,9 +216,8 @@ bool BFDInterface::initialize(const std::string &format)
         return false;
     }
 
+    //The symbols themselves are only read by loadSymbols()
     long storage_needed = bfd_get_symtab_upper_bound (m_bfd);
-    long number_of_symbols;
-
     if (storage_needed < 0) {
         std::cerr << "Failed to determine needed storage" << std::endl;
         bfd_close(m_bfd);
@@ -155,17 +225,6 @@ bool BFDInterface::initialize(const std::string &format)
         return false;
     }
 
-    m_symbolTable = (asymbol**)malloc (storage_needed);
-    number_of_symbols = bfd_canonicalize_symtab (m_bfd, m_symbolTable);
-    if (number_of_symbols < 0) {
-        std::cerr << "Failed to determine number of symbols" << std::endl;
-        bfd_close(m_bfd);
-        m_bfd = NULL;
-        return false;
-    }
-
-    m_symbolCount = number_of_symbols;
-
     if (m_requireSymbols && !(m_bfd->flags & HAS_SYMS)) {
         return false;
     }
@@ -185,12 +244,6 @@ bool BFDInterface::initialize(const std::string &format)
     assert(vma);
     m_imageBase = vma & (uint64_t)~0xFFF;
 
-    if (PeReader::isValid(m_file.get())) {
-        m_binary = new PeReader(this);
-    }else if (MachoReader::isValid(m_file.get())) {
-        m_binary = new MachoReader(this);
-    }
-
     //Extract module name
     size_t pos = m_fileName.find_last_of("\\/");
     if (pos == std::string::npos) {
@@ -202,12 +255,93 @@ bool BFDInterface::initialize(const std::string &format)
     return true;
 }
 
+//Canonicalizing the symbol table is expensive,
+//do it only for modules whose symbols are actually used
+void BFDInterface::loadSymbols() const
+{
+    if (m_symbolsInited || !m_bfd) {
+        return;
+    }
+
+    BfdLock lock;
+    m_symbolsInited = true;
+
+    long storage_needed = bfd_get_symtab_upper_bound (m_bfd);
+    if (storage_needed < 0) {
+        std::cerr << "Failed to determine needed storage" << std::endl;
+        return;
+    }
+
+    m_symbolTable = (asymbol**)malloc (storage_needed);
+    long number_of_symbols = bfd_canonicalize_symtab (m_bfd, m_symbolTable);
+    if (number_of_symbols < 0) {
+        std::cerr << "Failed to determine number of symbols" << std::endl;
+        return;
+    }
+
+    m_symbolCount = number_of_symbols;
+}
+
+//The PE and Mach-O readers patch imports and relocations into the image,
+//they must run before any contents are returned
+void BFDInterface::loadBinary() const
+{
+    if (m_binaryInited || !m_bfd) {
+        return;
+    }
+
+    //The readers call back into read() and write()
+    m_binaryInited = true;
+
+    BFDInterface *self = const_cast<BFDInterface*>(this);
+    if (PeReader::isValid(m_file.get())) {
+        m_binary = new PeReader(self);
+    }else if (MachoReader::isValid(m_file.get())) {
+        m_binary = new MachoReader(self);
+    }
+}
+
+//Decode the debug info once instead of letting BFD walk it per query
+DwarfReader *BFDInterface::getDwarf()
+{
+    if (!m_dwarfInited) {
+        m_dwarfInited = true;
+        if (DwarfReader::isValid(m_file.get())) {
+            m_dwarf = new DwarfReader(m_file.get());
+            if (!m_dwarf->initialize()) {
+                delete m_dwarf;
+                m_dwarf = NULL;
+            }
+        }
+    }
+    return m_dwarf;
+}
+
+//The native tables are read-only once built, BFD itself is not reentrant
+bool BFDInterface::isReentrant()
+{
+    return initialize() && getDwarf();
+}
+
+void BFDInterface::getInfoBatch(DebugInfos &infos)
+{
+    if (initialize() && getDwarf()) {
+        m_dwarf->getTables().getInfoBatch(infos);
+        return;
+    }
+    ExecutableFile::getInfoBatch(infos);
+}
+
 bool BFDInterface::getInfo(uint64_t addr, std::string &source, uint64_t &line, std::string &function)
 {
     if (!initialize()) {
         return false;
     }
 
+    if (getDwarf()) {
+        return m_dwarf->getInfo(addr, source, line, function);
+    }
+
     BFDSection s;
     s.start = addr;
     s.size = 1;
@@ -233,6 +367,9 @@ bool BFDInterface::getInfo(uint64_t addr, std::string &source, uint64_t &line, s
     const char *funcname;
     unsigned int sourceline;
 
+    loadSymbols();
+
+    BfdLock lock;
     if (bfd_find_nearest_line(m_bfd, section, m_symbolTable, addr - section->vma,
         &filename, &funcname, &sourceline)) {
 
@@ -308,34 +445,112 @@ asection *BFDInterface::getSection(uint64_t va, unsigned size) const
     return (*it).second;
 }
 
+const uint8_t *BFDInterface::getData(uint64_t va, uint64_t &size) const
+{
+    size = 0;
+    loadBinary();
+
+    asection *section = getSection(va, 1);
+    if (!section || !(bfd_get_section_flags(m_bfd, section) & SEC_HAS_CONTENTS)) {
+        return NULL;
+    }
+
+    uint64_t offset = section->filepos + (va - section->vma);
+    uint64_t end = section->filepos + section->size;
+    if (section->filepos < 0 || end > m_file->getBufferSize()) {
+        return NULL;
+    }
+
+    //Stop at the first written page
+    uint64_t page = va & ~(CowPageSize - 1);
+    CowPages::const_iterator it = m_cowPages.lower_bound(page);
+    if (it != m_cowPages.end()) {
+        if ((*it).first == page) {
+            return NULL;
+        }
+        end = std::min(end, offset + ((*it).first - va));
+    }
+
+    size = end - offset;
+    return (const uint8_t*)m_file->getBufferStart() + offset;
+}
+
 bool BFDInterface::read(uint64_t va, void *dest, unsigned size) const
 {
+    loadBinary();
+
     asection *section = getSection(va, 1);
     if (!section) {
         return false;
     }
 
+    uint64_t available;
+    const uint8_t *data = getData(va, available);
+    if (data && available >= size) {
+        memcpy(dest, data, size);
+        return true;
+    }
+
     bool b = bfd_get_section_contents(m_bfd, section, dest, va - section->vma, size);
+
     //Check for written changes
-    for (unsigned i=0; i<size; ++i) {
-        std::map<uint64_t, uint8_t>::const_iterator it = m_cowBuffer.find(va+i);
-        if (it != m_cowBuffer.end()) {
-            *(((uint8_t*)dest) + i) = (*it).second;
+    uint64_t end = va + size;
+    CowPages::const_iterator it = m_cowPages.upper_bound(va & ~(CowPageSize - 1));
+    if (it != m_cowPages.begin()) {
+        --it;
+    }
+    for (; it != m_cowPages.end() && (*it).first < end; ++it) {
+        uint64_t start = std::max(va, (*it).first);
+        uint64_t stop = std::min(end, (*it).first + CowPageSize);
+        if (start < stop) {
+            memcpy((uint8_t*)dest + (start - va), &(*it).second[start - (*it).first], stop - start);
         }
     }
     return b;
 }
 
+//Initial contents of a page that is about to be written.
+//Pages may span several sections, bytes outside of them are zero.
+void BFDInterface::loadPage(uint64_t page, std::vector<uint8_t> &data) const
+{
+    data.assign(CowPageSize, 0);
+
+    uint64_t va = page;
+    while (va < page + CowPageSize) {
+        asection *section = getSection(va, 1);
+        if (!section) {
+            ++va;
+            continue;
+        }
+
+        uint64_t stop = std::min(page + CowPageSize, (uint64_t)(section->vma + section->size));
+        bfd_get_section_contents(m_bfd, section, &data[va - page], va - section->vma, stop - va);
+        va = stop;
+    }
+}
+
 bool BFDInterface::write(uint64_t va, void *source, unsigned size)
 {
+    loadBinary();
+
     asection *section = getSection(va, 1);
     if (!section) {
         return false;
     }
 
     //Write data to a local buffer instead of the bfd
-    for (unsigned i=0; i<size; ++i) {
-        m_cowBuffer[va+i] = *(((uint8_t*)source) + i);
+    uint64_t end = va + size;
+    uint64_t page = va & ~(CowPageSize - 1);
+    for (; page < end; page += CowPageSize) {
+        CowPages::iterator it = m_cowPages.find(page);
+        if (it == m_cowPages.end()) {
+            it = m_cowPages.insert(std::make_pair(page, std::vector<uint8_t>())).first;
+            loadPage(page, (*it).second);
+        }
+
+        uint64_t start = std::max(va, page);
+        uint64_t stop = std::min(end, page + CowPageSize);
+        memcpy(&(*it).second[start - page], (const uint8_t*)source + (start - va), stop - start);
     }
     return true;
     //XXX: This always seems to fail, because bfd_direction is not properly set for
@@ -377,6 +592,7 @@ int BFDInterface::getSectionFlags(uint64_t va) const
 
 const Imports &BFDInterface::getImports() const
 {
+    loadBinary();
     if (!m_binary) {
         return m_imports;
     }
@@ -385,10 +601,58 @@ const Imports &BFDInterface::getImports() const
 
 const RelocationEntries & BFDInterface::getRelocations() const
 {
+    loadBinary();
     if (!m_binary) {
         return m_relocations;
     }
     return m_binary->getRelocations();
 }
 
+//DWARF subprograms have exact bounds and win over the symbols.
+//Without debug info, only the function symbols of the code
+//sections are used, like DwarfReader does.
+void BFDInterface::loadFunctions()
+{
+    if (m_functionsInited || !initialize()) {
+        return;
+    }
+    m_functionsInited = true;
+
+    FunctionEntries functions;
+    if (getDwarf()) {
+        m_dwarf->getTables().getFunctionRanges(functions);
+        m_functions.swap(functions);
+        return;
+    }
+
+    FunctionEntries symbols;
+    asymbol **table = getSymbols();
+    for (long i = 0; i < getSymbolCount(); ++i) {
+        asymbol *sym = table[i];
+        if (!sym->name || !*sym->name || bfd_is_und_section(sym->section) ||
+            !(sym->flags & BSF_FUNCTION) ||
+            !(bfd_get_section_flags(m_bfd, sym->section) & SEC_CODE)) {
+            continue;
+        }
+
+        FunctionEntry e;
+        e.start = bfd_asymbol_value(sym);
+        e.end = sym->section->vma + sym->section->size;
+        e.name = sym->name;
+        if (e.start < e.end) {
+            symbols.push_back(e);
+        }
+    }
+    std::stable_sort(symbols.begin(), symbols.end());
+
+    mergeFunctionRanges(functions, symbols);
+    m_functions.swap(functions);
+}
+
+const FunctionEntries &BFDInterface::functionRanges()
+{
+    loadFunctions();
+    return m_functions;
+}
+
 }
@@ -44,6 +44,7 @@ extern "C" {
 #include <string>
 #include <map>
 #include <set>
+#include <vector>
 #include <inttypes.h>
 
 #include "ExecutableFile.h"
@@ -54,6 +55,7 @@ namespace s2etools
 {
 
 class Binary;
+class DwarfReader;
 
 //Maps an address to a pair of library and function name
 typedef std::map<uint64_t, std::pair<std::string, std::string> > Imports;
@@ -114,8 +116,11 @@ private:
 
     static bool s_bfdInited;
     bfd *m_bfd;
-    asymbol **m_symbolTable;
-    long m_symbolCount;
+
+    //Symbols and the PE/Mach-O readers are loaded on first use
+    mutable asymbol **m_symbolTable;
+    mutable long m_symbolCount;
+    mutable bool m_symbolsInited;
 
     std::string m_moduleName;
     Sections m_sections;
@@ -124,18 +129,34 @@ private:
     uint64_t m_imageBase;
     bool m_requireSymbols;
     llvm::OwningPtr<llvm::MemoryBuffer> m_file;
-    Binary *m_binary;
+    mutable Binary *m_binary;
+    mutable bool m_binaryInited;
+
+    //Native debug info lookups, BFD is used when it cannot read the file
+    DwarfReader *m_dwarf;
+    bool m_dwarfInited;
 
-    //This for copy-on-write, when we need to write stuff to the BFD
-    std::map<uint64_t, uint8_t> m_cowBuffer;
+    //This for copy-on-write, when we need to write stuff to the BFD.
+    //Written pages are copied from the image once, by page address.
+    static const uint64_t CowPageSize = 0x1000;
+    typedef std::map<uint64_t, std::vector<uint8_t> > CowPages;
+    CowPages m_cowPages;
 
     RelocationEntries m_relocations;
     Imports m_imports;
 
+    FunctionEntries m_functions;
+    bool m_functionsInited;
+
     static void initSections(bfd *abfd, asection *sect, void *obj);
 
     bool initPeImports();
     asection *getSection(uint64_t va, unsigned size) const;
+    void loadPage(uint64_t page, std::vector<uint8_t> &data) const;
+    void loadSymbols() const;
+    void loadBinary() const;
+    void loadFunctions();
+    DwarfReader *getDwarf();
 
 public:
     BFDInterface(const std::string &fileName);
@@ -149,6 +170,8 @@ public:
     bool initialize(const std::string &format);
 
     bool getInfo(uint64_t addr, std::string &source, uint64_t &line, std::string &function);
+    void getInfoBatch(DebugInfos &infos);
+    bool isReentrant();
     bool inited() const {
         return m_bfd != NULL;
     }
@@ -163,11 +186,19 @@ public:
     //Read the contents at virtual address va
     bool read(uint64_t va, void *dest, unsigned size) const;
 
+    //Returns a pointer to the contents at va in the mapped file, without copying.
+    //size receives the number of bytes available up to the end of the section
+    //or the first written page. Returns NULL if va is not backed by the file.
+    const uint8_t *getData(uint64_t va, uint64_t &size) const;
+
     bool write(uint64_t va, void *source, unsigned size);
 
     const Imports &getImports() const;
     const RelocationEntries &getRelocations() const;
 
+    //Built on first use from the DWARF subprograms and the symbol table
+    virtual const FunctionEntries &functionRanges();
+
     //Returns whether the supplied address is in an executable section
     bool isCode(uint64_t va) const;
     bool isData(uint64_t va) const;
@@ -178,10 +209,12 @@ public:
     }
 
     asymbol **getSymbols() const {
+        loadSymbols();
         return m_symbolTable;
     }
 
     long getSymbolCount() const {
+        loadSymbols();
         return m_symbolCount;
     }
 
@@ -0,0 +1,984 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#include "DwarfReader.h"
+
+#include <elf.h>
+#include <string.h>
+
+#include <algorithm>
+#include <set>
+
+namespace s2etools
+{
+
+namespace {
+
+//DWARF constants used by the reader
+enum {
+    DW_TAG_inlined_subroutine = 0x1d,
+    DW_TAG_compile_unit = 0x11,
+    DW_TAG_subprogram = 0x2e,
+
+    DW_AT_name = 0x03,
+    DW_AT_stmt_list = 0x10,
+    DW_AT_low_pc = 0x11,
+    DW_AT_high_pc = 0x12,
+    DW_AT_comp_dir = 0x1b,
+    DW_AT_abstract_origin = 0x31,
+    DW_AT_specification = 0x47,
+    DW_AT_ranges = 0x55,
+    DW_AT_linkage_name = 0x6e,
+    DW_AT_MIPS_linkage_name = 0x2007,
+
+    DW_FORM_addr = 0x01,
+    DW_FORM_block2 = 0x03,
+    DW_FORM_block4 = 0x04,
+    DW_FORM_data2 = 0x05,
+    DW_FORM_data4 = 0x06,
+    DW_FORM_data8 = 0x07,
+    DW_FORM_string = 0x08,
+    DW_FORM_block = 0x09,
+    DW_FORM_block1 = 0x0a,
+    DW_FORM_data1 = 0x0b,
+    DW_FORM_flag = 0x0c,
+    DW_FORM_sdata = 0x0d,
+    DW_FORM_strp = 0x0e,
+    DW_FORM_udata = 0x0f,
+    DW_FORM_ref_addr = 0x10,
+    DW_FORM_ref1 = 0x11,
+    DW_FORM_ref2 = 0x12,
+    DW_FORM_ref4 = 0x13,
+    DW_FORM_ref8 = 0x14,
+    DW_FORM_ref_udata = 0x15,
+    DW_FORM_indirect = 0x16,
+    DW_FORM_sec_offset = 0x17,
+    DW_FORM_exprloc = 0x18,
+    DW_FORM_flag_present = 0x19,
+    DW_FORM_ref_sig8 = 0x20,
+    DW_FORM_implicit_const = 0x21,
+    DW_FORM_GNU_ref_alt = 0x1f20,
+    DW_FORM_GNU_strp_alt = 0x1f21,
+
+    DW_LNS_copy = 1,
+    DW_LNS_advance_pc = 2,
+    DW_LNS_advance_line = 3,
+    DW_LNS_set_file = 4,
+    DW_LNS_const_add_pc = 8,
+    DW_LNS_fixed_advance_pc = 9,
+
+    DW_LNE_end_sequence = 1,
+    DW_LNE_set_address = 2,
+    DW_LNE_define_file = 3
+};
+
+//Bounds-checked little-endian cursor. Reading past the end
+//clears ok and returns zeros.
+struct DataReader {
+    const uint8_t *p, *end;
+    bool ok;
+
+    DataReader(const uint8_t *start, uint64_t size) : p(start), end(start + size), ok(true) {}
+
+    bool has(uint64_t n) {
+        if (!ok || (uint64_t)(end - p) < n) {
+            ok = false;
+            return false;
+        }
+        return true;
+    }
+
+    uint64_t fixed(unsigned n) {
+        if (!has(n)) {
+            return 0;
+        }
+        uint64_t v = 0;
+        for (unsigned i = 0; i < n; ++i) {
+            v |= (uint64_t)p[i] << (8 * i);
+        }
+        p += n;
+        return v;
+    }
+
+    uint8_t u8() { return fixed(1); }
+    uint16_t u16() { return fixed(2); }
+    uint32_t u32() { return fixed(4); }
+    uint64_t u64() { return fixed(8); }
+
+    uint64_t uleb() {
+        uint64_t v = 0;
+        unsigned shift = 0;
+        while (has(1)) {
+            uint8_t b = *p++;
+            if (shift < 64) {
+                v |= (uint64_t)(b & 0x7f) << shift;
+            }
+            shift += 7;
+            if (!(b & 0x80)) {
+                break;
+            }
+        }
+        return v;
+    }
+
+    int64_t sleb() {
+        int64_t v = 0;
+        unsigned shift = 0;
+        uint8_t b = 0;
+        while (has(1)) {
+            b = *p++;
+            if (shift < 64) {
+                v |= (int64_t)(b & 0x7f) << shift;
+            }
+            shift += 7;
+            if (!(b & 0x80)) {
+                break;
+            }
+        }
+        if (shift < 64 && (b & 0x40)) {
+            v |= -((int64_t)1 << shift);
+        }
+        return v;
+    }
+
+    const char *cstr() {
+        if (!ok) {
+            return "";
+        }
+        const uint8_t *nul = (const uint8_t*)memchr(p, 0, end - p);
+        if (!nul) {
+            ok = false;
+            return "";
+        }
+        const char *s = (const char*)p;
+        p = nul + 1;
+        return s;
+    }
+
+    void skip(uint64_t n) {
+        if (has(n)) {
+            p += n;
+        }
+    }
+
+    //Reads a unit length, returns the end of the unit
+    const uint8_t *unitLength(bool &dwarf64) {
+        uint64_t length = u32();
+        dwarf64 = false;
+        if (length == 0xffffffff) {
+            dwarf64 = true;
+            length = u64();
+        }
+        if (!has(length)) {
+            return NULL;
+        }
+        return p + length;
+    }
+};
+
+//Section header fields of both ELF classes
+struct Shdr {
+    uint32_t name, type, link;
+    uint64_t flags, addr, offset, size;
+};
+
+//Names of a subprogram entry, possibly through a reference
+//to its declaration or abstract instance
+struct DieNames {
+    uint32_t name, linkageName;
+    uint64_t ref;
+};
+
+struct Abbrev {
+    uint64_t tag;
+    bool hasChildren;
+    std::vector<std::pair<uint64_t, uint64_t> > attributes;
+    std::vector<int64_t> implicitValues;
+};
+
+typedef std::map<uint64_t, Abbrev> Abbrevs;
+
+struct UnitInfo {
+    uint64_t offset; //Of the unit header in .debug_info
+    unsigned version;
+    unsigned addressSize;
+    bool dwarf64;
+};
+
+struct FormValue {
+    uint64_t value;
+    const char *string;
+    bool isRef;       //value is an offset in .debug_info
+    bool isConstant;  //value is a constant, not an address
+};
+
+bool parseAbbrevs(const DwarfReader::Section &section, uint64_t offset, Abbrevs &abbrevs)
+{
+    if (offset >= section.size) {
+        return false;
+    }
+
+    DataReader r(section.data + offset, section.size - offset);
+    while (r.ok) {
+        uint64_t code = r.uleb();
+        if (!code) {
+            break;
+        }
+
+        Abbrev &a = abbrevs[code];
+        a.tag = r.uleb();
+        a.hasChildren = r.u8() != 0;
+        while (r.ok) {
+            uint64_t attr = r.uleb();
+            uint64_t form = r.uleb();
+            if (!attr && !form) {
+                break;
+            }
+            a.attributes.push_back(std::make_pair(attr, form));
+            a.implicitValues.push_back(form == DW_FORM_implicit_const ? r.sleb() : 0);
+        }
+    }
+    return r.ok;
+}
+
+//Reads or skips one attribute value, returns false on unsupported forms
+bool readForm(DataReader &r, uint64_t form, int64_t implicitValue, const UnitInfo &unit,
+              const DwarfReader::Section &strings, FormValue &v)
+{
+    unsigned offsetSize = unit.dwarf64 ? 8 : 4;
+
+    v.value = 0;
+    v.string = NULL;
+    v.isRef = false;
+    v.isConstant = false;
+
+    switch (form) {
+        case DW_FORM_addr: v.value = r.fixed(unit.addressSize); break;
+        case DW_FORM_block1: r.skip(r.u8()); break;
+        case DW_FORM_block2: r.skip(r.u16()); break;
+        case DW_FORM_block4: r.skip(r.u32()); break;
+        case DW_FORM_block:
+        case DW_FORM_exprloc: r.skip(r.uleb()); break;
+        case DW_FORM_data1: v.value = r.u8(); v.isConstant = true; break;
+        case DW_FORM_data2: v.value = r.u16(); v.isConstant = true; break;
+        case DW_FORM_data4: v.value = r.u32(); v.isConstant = true; break;
+        case DW_FORM_data8: v.value = r.u64(); v.isConstant = true; break;
+        case DW_FORM_sdata: v.value = r.sleb(); v.isConstant = true; break;
+        case DW_FORM_udata: v.value = r.uleb(); v.isConstant = true; break;
+        case DW_FORM_implicit_const: v.value = implicitValue; v.isConstant = true; break;
+        case DW_FORM_flag: v.value = r.u8(); break;
+        case DW_FORM_flag_present: v.value = 1; break;
+        case DW_FORM_string: v.string = r.cstr(); break;
+        case DW_FORM_strp: {
+            uint64_t offset = r.fixed(offsetSize);
+            if (offset < strings.size && memchr(strings.data + offset, 0, strings.size - offset)) {
+                v.string = (const char*)strings.data + offset;
+            }
+        } break;
+        case DW_FORM_ref1: v.value = unit.offset + r.u8(); v.isRef = true; break;
+        case DW_FORM_ref2: v.value = unit.offset + r.u16(); v.isRef = true; break;
+        case DW_FORM_ref4: v.value = unit.offset + r.u32(); v.isRef = true; break;
+        case DW_FORM_ref8: v.value = unit.offset + r.u64(); v.isRef = true; break;
+        case DW_FORM_ref_udata: v.value = unit.offset + r.uleb(); v.isRef = true; break;
+        case DW_FORM_ref_addr:
+            v.value = r.fixed(unit.version <= 2 ? unit.addressSize : offsetSize);
+            v.isRef = true;
+            break;
+        case DW_FORM_sec_offset: v.value = r.fixed(offsetSize); break;
+        case DW_FORM_ref_sig8: r.skip(8); break;
+        case DW_FORM_GNU_ref_alt:
+        case DW_FORM_GNU_strp_alt: r.skip(offsetSize); break;
+        case DW_FORM_indirect: {
+            uint64_t actual = r.uleb();
+            if (actual == DW_FORM_indirect || actual == DW_FORM_implicit_const) {
+                return false;
+            }
+            return readForm(r, actual, 0, unit, strings, v);
+        }
+        default:
+            return false;
+    }
+    return r.ok;
+}
+
+std::string joinPath(const std::string &dir, const std::string &file)
+{
+    if (dir.empty() || (!file.empty() && file[0] == '/')) {
+        return file;
+    }
+    if (dir[dir.size() - 1] == '/') {
+        return dir + file;
+    }
+    return dir + "/" + file;
+}
+
+}
+
+DwarfReader::DwarfReader(llvm::MemoryBuffer *file)
+{
+    m_file = file;
+    m_addressSize = 0;
+}
+
+bool DwarfReader::isValid(llvm::MemoryBuffer *file)
+{
+    if (!file || file->getBufferSize() < sizeof(Elf32_Ehdr)) {
+        return false;
+    }
+
+    const unsigned char *ident = (const unsigned char*)file->getBufferStart();
+    if (memcmp(ident, ELFMAG, SELFMAG)) {
+        return false;
+    }
+
+    if (ident[EI_DATA] != ELFDATA2LSB) {
+        return false;
+    }
+
+    if (ident[EI_CLASS] == ELFCLASS32) {
+        const Elf32_Ehdr *hdr = (const Elf32_Ehdr*)ident;
+        return hdr->e_type == ET_EXEC || hdr->e_type == ET_DYN;
+    } else if (ident[EI_CLASS] == ELFCLASS64) {
+        if (file->getBufferSize() < sizeof(Elf64_Ehdr)) {
+            return false;
+        }
+        const Elf64_Ehdr *hdr = (const Elf64_Ehdr*)ident;
+        return hdr->e_type == ET_EXEC || hdr->e_type == ET_DYN;
+    }
+    return false;
+}
+
+uint32_t DwarfReader::intern(const std::string &s)
+{
+    std::map<std::string, uint32_t>::iterator it = m_stringIds.find(s);
+    if (it != m_stringIds.end()) {
+        return (*it).second;
+    }
+
+    uint32_t id = m_strings.size();
+    m_strings.push_back(s);
+    m_stringIds[s] = id;
+    return id;
+}
+
+bool DwarfReader::loadSections()
+{
+    const uint8_t *image = (const uint8_t*)m_file->getBufferStart();
+    uint64_t imageSize = m_file->getBufferSize();
+    bool is64 = image[EI_CLASS] == ELFCLASS64;
+
+    uint64_t shoff;
+    unsigned shentsize, shnum, shstrndx;
+    if (is64) {
+        const Elf64_Ehdr *hdr = (const Elf64_Ehdr*)image;
+        shoff = hdr->e_shoff;
+        shentsize = hdr->e_shentsize;
+        shnum = hdr->e_shnum;
+        shstrndx = hdr->e_shstrndx;
+        m_addressSize = 8;
+    } else {
+        const Elf32_Ehdr *hdr = (const Elf32_Ehdr*)image;
+        shoff = hdr->e_shoff;
+        shentsize = hdr->e_shentsize;
+        shnum = hdr->e_shnum;
+        shstrndx = hdr->e_shstrndx;
+        m_addressSize = 4;
+    }
+
+    if (!shnum || shstrndx >= shnum || shoff > imageSize ||
+        (uint64_t)shnum * shentsize > imageSize - shoff ||
+        shentsize < (is64 ? sizeof(Elf64_Shdr) : sizeof(Elf32_Shdr))) {
+        return false;
+    }
+
+    //Normalize the section headers
+    std::vector<Shdr> headers(shnum);
+    for (unsigned i = 0; i < shnum; ++i) {
+        const uint8_t *p = image + shoff + (uint64_t)i * shentsize;
+        Shdr &s = headers[i];
+        if (is64) {
+            const Elf64_Shdr *sh = (const Elf64_Shdr*)p;
+            s.name = sh->sh_name; s.type = sh->sh_type; s.link = sh->sh_link;
+            s.flags = sh->sh_flags; s.addr = sh->sh_addr; s.offset = sh->sh_offset; s.size = sh->sh_size;
+        } else {
+            const Elf32_Shdr *sh = (const Elf32_Shdr*)p;
+            s.name = sh->sh_name; s.type = sh->sh_type; s.link = sh->sh_link;
+            s.flags = sh->sh_flags; s.addr = sh->sh_addr; s.offset = sh->sh_offset; s.size = sh->sh_size;
+        }
+
+        if (s.type != SHT_NOBITS && (s.offset > imageSize || s.size > imageSize - s.offset)) {
+            return false;
+        }
+    }
+
+    const Shdr &names = headers[shstrndx];
+    unsigned symtab = 0, dynsym = 0;
+    for (unsigned i = 0; i < shnum; ++i) {
+        const Shdr &s = headers[i];
+        if (s.name >= names.size) {
+            continue;
+        }
+
+        const char *name = (const char*)image + names.offset + s.name;
+        if (!memchr(name, 0, names.size - s.name)) {
+            continue;
+        }
+
+        //TLS templates overlap the regular sections
+        if ((s.flags & SHF_ALLOC) && s.size && !((s.flags & SHF_TLS) && s.type == SHT_NOBITS)) {
+            SectionRange range;
+            range.start = s.addr;
+            range.size = s.size;
+            range.name = intern(name);
+            range.flags = (s.flags & SHF_EXECINSTR ? SectionRange::CODE : 0) |
+                          (s.flags & SHF_WRITE ? SectionRange::WRITABLE : 0);
+            m_sections.push_back(range);
+        }
+
+        if (s.type == SHT_NOBITS) {
+            continue;
+        }
+
+        Section section;
+        section.data = image + s.offset;
+        section.size = s.size;
+
+        Section *target = NULL;
+        if (!strcmp(name, ".debug_line")) {
+            target = &m_debugLine;
+        } else if (!strcmp(name, ".debug_info")) {
+            target = &m_debugInfo;
+        } else if (!strcmp(name, ".debug_abbrev")) {
+            target = &m_debugAbbrev;
+        } else if (!strcmp(name, ".debug_str")) {
+            target = &m_debugStr;
+        } else if (!strcmp(name, ".debug_ranges")) {
+            target = &m_debugRanges;
+        } else if (s.type == SHT_SYMTAB) {
+            symtab = i;
+        } else if (s.type == SHT_DYNSYM) {
+            dynsym = i;
+        }
+
+        if (target) {
+            //Compressed debug sections are left to BFD
+            if (s.flags & 0x800 /* SHF_COMPRESSED */) {
+                return false;
+            }
+            *target = section;
+        }
+    }
+
+    //Prefer the full symbol table
+    unsigned symbols = symtab ? symtab : dynsym;
+    if (symbols && headers[symbols].link < shnum) {
+        const Shdr &s = headers[symbols];
+        const Shdr &str = headers[s.link];
+        m_symtab.data = image + s.offset;
+        m_symtab.size = s.size;
+        if (str.type != SHT_NOBITS) {
+            m_symtabStrings.data = image + str.offset;
+            m_symtabStrings.size = str.size;
+        }
+    }
+
+    return m_debugLine.data != NULL;
+}
+
+//Collects the functions and the line table of each compilation unit.
+//Fails if some unit cannot be decoded, so that BFD handles the image.
+bool DwarfReader::parseUnits(std::map<uint64_t, std::string> &lineTables)
+{
+    if (!m_debugInfo.data || !m_debugAbbrev.data) {
+        return false;
+    }
+
+    std::map<uint64_t, Abbrevs> abbrevCache;
+
+    //Function names are resolved once all the units are read,
+    //references may point to other units
+    std::map<uint64_t, DieNames> dies;
+    std::vector<uint64_t> functionDies;
+
+    DataReader r(m_debugInfo.data, m_debugInfo.size);
+    while (r.ok && r.p < r.end) {
+        UnitInfo unit;
+        unit.offset = r.p - m_debugInfo.data;
+
+        const uint8_t *unitEnd = r.unitLength(unit.dwarf64);
+        if (!unitEnd) {
+            return false;
+        }
+
+        unit.version = r.u16();
+        uint64_t abbrevOffset = r.fixed(unit.dwarf64 ? 8 : 4);
+        unit.addressSize = r.u8();
+        if (!r.ok || unit.version < 2 || unit.version > 4 ||
+            (unit.addressSize != 4 && unit.addressSize != 8)) {
+            return false;
+        }
+
+        std::map<uint64_t, Abbrevs>::iterator ait = abbrevCache.find(abbrevOffset);
+        if (ait == abbrevCache.end()) {
+            ait = abbrevCache.insert(std::make_pair(abbrevOffset, Abbrevs())).first;
+            if (!parseAbbrevs(m_debugAbbrev, abbrevOffset, (*ait).second)) {
+                return false;
+            }
+        }
+        const Abbrevs &abbrevs = (*ait).second;
+
+        //Base of the range lists
+        uint64_t unitBase = 0;
+
+        DataReader die(r.p, unitEnd - r.p);
+        while (die.ok && die.p < die.end) {
+            uint64_t dieOffset = die.p - m_debugInfo.data;
+            uint64_t code = die.uleb();
+            if (!code) {
+                continue;
+            }
+
+            Abbrevs::const_iterator it = abbrevs.find(code);
+            if (it == abbrevs.end()) {
+                return false;
+            }
+            const Abbrev &abbrev = (*it).second;
+
+            const char *name = NULL, *linkageName = NULL, *compDir = NULL;
+            uint64_t low = 0, high = 0, ref = 0, stmtList = 0, ranges = 0;
+            bool hasLow = false, hasHigh = false, highIsOffset = false;
+            bool hasRef = false, hasStmt = false, hasRanges = false;
+
+            for (unsigned i = 0; i < abbrev.attributes.size(); ++i) {
+                FormValue v;
+                if (!readForm(die, abbrev.attributes[i].second, abbrev.implicitValues[i], unit, m_debugStr, v)) {
+                    return false;
+                }
+
+                switch (abbrev.attributes[i].first) {
+                    case DW_AT_name: name = v.string; break;
+                    case DW_AT_linkage_name:
+                    case DW_AT_MIPS_linkage_name: linkageName = v.string; break;
+                    case DW_AT_comp_dir: compDir = v.string; break;
+                    case DW_AT_low_pc: low = v.value; hasLow = true; break;
+                    case DW_AT_high_pc: high = v.value; hasHigh = true; highIsOffset = v.isConstant; break;
+                    case DW_AT_ranges: ranges = v.value; hasRanges = true; break;
+                    case DW_AT_stmt_list: stmtList = v.value; hasStmt = true; break;
+                    case DW_AT_specification:
+                    case DW_AT_abstract_origin:
+                        if (v.isRef) {
+                            ref = v.value;
+                            hasRef = true;
+                        }
+                        break;
+                }
+            }
+
+            if (abbrev.tag == DW_TAG_compile_unit) {
+                unitBase = low;
+                if (hasStmt) {
+                    lineTables[stmtList] = compDir ? compDir : "";
+                }
+                continue;
+            }
+
+            if (abbrev.tag != DW_TAG_subprogram && abbrev.tag != DW_TAG_inlined_subroutine) {
+                continue;
+            }
+
+            DieNames &names = dies[dieOffset];
+            names.name = name ? intern(name) : 0;
+            names.linkageName = linkageName ? intern(linkageName) : 0;
+            names.ref = hasRef ? ref : 0;
+
+            FunctionRange f;
+            f.name = 0;
+            f.parent = ~0U;
+            f.linkage = false;
+            f.inlined = abbrev.tag == DW_TAG_inlined_subroutine;
+
+            if (hasLow && hasHigh) {
+                f.low = low;
+                f.high = highIsOffset ? low + high : high;
+                if (f.high > f.low) {
+                    m_functions.push_back(f);
+                    functionDies.push_back(dieOffset);
+                }
+            } else if (hasRanges && m_debugRanges.data && ranges < m_debugRanges.size) {
+                DataReader rl(m_debugRanges.data + ranges, m_debugRanges.size - ranges);
+                uint64_t base = unitBase;
+                uint64_t baseMarker = unit.addressSize == 8 ? ~0ULL : 0xffffffffULL;
+                while (rl.ok) {
+                    uint64_t start = rl.fixed(unit.addressSize);
+                    uint64_t end = rl.fixed(unit.addressSize);
+                    if (!rl.ok || (!start && !end)) {
+                        break;
+                    }
+                    if (start == baseMarker) {
+                        base = end;
+                        continue;
+                    }
+                    f.low = base + start;
+                    f.high = base + end;
+                    if (f.high > f.low) {
+                        m_functions.push_back(f);
+                        functionDies.push_back(dieOffset);
+                    }
+                }
+            }
+        }
+
+        r.p = unitEnd;
+    }
+
+    //Linkage names are what BFD reports, they may be on the declaration
+    //while the abstract instance only has the plain name
+    std::map<uint64_t, std::pair<uint32_t, bool> > resolved;
+    for (unsigned i = 0; i < m_functions.size(); ++i) {
+        uint64_t offset = functionDies[i];
+        std::map<uint64_t, std::pair<uint32_t, bool> >::const_iterator cached = resolved.find(offset);
+        if (cached != resolved.end()) {
+            m_functions[i].name = (*cached).second.first;
+            m_functions[i].linkage = (*cached).second.second;
+            continue;
+        }
+
+        uint32_t name = 0;
+        bool linkage = false;
+        uint64_t current = offset;
+        for (unsigned hops = 0; hops < 8; ++hops) {
+            std::map<uint64_t, DieNames>::const_iterator dit = dies.find(current);
+            if (dit == dies.end()) {
+                break;
+            }
+            const DieNames &names = (*dit).second;
+            if (names.linkageName) {
+                name = names.linkageName;
+                linkage = true;
+                break;
+            }
+            if (!name) {
+                name = names.name;
+            }
+            if (!names.ref) {
+                break;
+            }
+            current = names.ref;
+        }
+
+        resolved[offset] = std::make_pair(name, linkage);
+        m_functions[i].name = name;
+        m_functions[i].linkage = linkage;
+    }
+
+    return true;
+}
+
+bool DwarfReader::parseLineTable(uint64_t offset, const std::string &compDir, uint64_t &next)
+{
+    if (offset >= m_debugLine.size) {
+        return false;
+    }
+
+    DataReader r(m_debugLine.data + offset, m_debugLine.size - offset);
+    bool dwarf64;
+    const uint8_t *unitEnd = r.unitLength(dwarf64);
+    if (!unitEnd) {
+        return false;
+    }
+    next = unitEnd - m_debugLine.data;
+
+    unsigned version = r.u16();
+    if (version < 2 || version > 4) {
+        return false;
+    }
+
+    uint64_t headerLength = r.fixed(dwarf64 ? 8 : 4);
+    if (!r.has(headerLength)) {
+        return false;
+    }
+    const uint8_t *program = r.p + headerLength;
+
+    unsigned minInstLength = r.u8();
+    if (version >= 4) {
+        r.u8(); //maximum_operations_per_instruction, VLIW only
+    }
+    bool defaultIsStmt = r.u8() != 0;
+    int lineBase = (int8_t)r.u8();
+    unsigned lineRange = r.u8();
+    unsigned opcodeBase = r.u8();
+    if (!r.ok || !lineRange || !opcodeBase) {
+        return false;
+    }
+    (void)defaultIsStmt;
+
+    std::vector<uint8_t> opcodeLengths(opcodeBase);
+    for (unsigned i = 1; i < opcodeBase; ++i) {
+        opcodeLengths[i] = r.u8();
+    }
+
+    std::vector<std::string> dirs;
+    dirs.push_back(compDir);
+    while (r.ok) {
+        const char *dir = r.cstr();
+        if (!*dir) {
+            break;
+        }
+        dirs.push_back(joinPath(compDir, dir));
+    }
+
+    //File numbers start at 1
+    std::vector<uint32_t> files(1, intern(""));
+    while (r.ok) {
+        const char *file = r.cstr();
+        if (!*file) {
+            break;
+        }
+        uint64_t dir = r.uleb();
+        r.uleb();
+        r.uleb();
+        files.push_back(intern(joinPath(dir < dirs.size() ? dirs[dir] : compDir, file)));
+    }
+
+    if (!r.ok || program > unitEnd) {
+        return false;
+    }
+
+    DataReader p(program, unitEnd - program);
+
+    uint64_t address = 0, file = 1;
+    int64_t line = 1;
+
+    while (p.ok && p.p < p.end) {
+        uint8_t opcode = p.u8();
+        bool emit = false, endSequence = false;
+
+        if (opcode >= opcodeBase) {
+            unsigned adjusted = opcode - opcodeBase;
+            address += (adjusted / lineRange) * minInstLength;
+            line += lineBase + (int)(adjusted % lineRange);
+            emit = true;
+        } else if (opcode == 0) {
+            uint64_t length = p.uleb();
+            if (!length || !p.has(length)) {
+                break;
+            }
+            const uint8_t *next = p.p + length;
+            uint8_t sub = p.u8();
+            switch (sub) {
+                case DW_LNE_end_sequence: emit = true; endSequence = true; break;
+                case DW_LNE_set_address: address = p.fixed(length - 1 <= 8 ? length - 1 : 8); break;
+                case DW_LNE_define_file: {
+                    const char *name = p.cstr();
+                    uint64_t dir = p.uleb();
+                    files.push_back(intern(joinPath(dir < dirs.size() ? dirs[dir] : compDir, name)));
+                } break;
+                default: break;
+            }
+            p.p = next;
+        } else {
+            switch (opcode) {
+                case DW_LNS_copy: emit = true; break;
+                case DW_LNS_advance_pc: address += p.uleb() * minInstLength; break;
+                case DW_LNS_advance_line: line += p.sleb(); break;
+                case DW_LNS_set_file: file = p.uleb(); break;
+                case DW_LNS_const_add_pc: address += ((255 - opcodeBase) / lineRange) * minInstLength; break;
+                case DW_LNS_fixed_advance_pc: address += p.u16(); break;
+                default:
+                    //Includes the opcodes that only change flags
+                    for (unsigned i = 0; i < opcodeLengths[opcode]; ++i) {
+                        p.uleb();
+                    }
+                    break;
+            }
+        }
+
+        if (emit && p.ok) {
+            LineRow row;
+            row.address = address;
+            row.file = file < files.size() ? files[file] : files[0];
+            row.line = line > 0 ? line : 0;
+            row.end = endSequence;
+            m_lines.push_back(row);
+        }
+
+        if (endSequence) {
+            address = 0;
+            file = 1;
+            line = 1;
+        }
+    }
+
+    return true;
+}
+
+//Function symbols cover what .debug_info does not describe.
+//Like BFD, an address belongs to the closest preceding symbol.
+void DwarfReader::parseSymbols()
+{
+    if (!m_symtab.data || !m_symtabStrings.data) {
+        return;
+    }
+
+    bool is64 = m_addressSize == 8;
+    unsigned entrySize = is64 ? sizeof(Elf64_Sym) : sizeof(Elf32_Sym);
+
+    for (uint64_t offset = 0; offset + entrySize <= m_symtab.size; offset += entrySize) {
+        uint64_t value;
+        uint32_t name;
+        unsigned type;
+        if (is64) {
+            const Elf64_Sym *sym = (const Elf64_Sym*)(m_symtab.data + offset);
+            value = sym->st_value; name = sym->st_name;
+            type = ELF64_ST_TYPE(sym->st_info);
+        } else {
+            const Elf32_Sym *sym = (const Elf32_Sym*)(m_symtab.data + offset);
+            value = sym->st_value; name = sym->st_name;
+            type = ELF32_ST_TYPE(sym->st_info);
+        }
+
+        if (type != STT_FUNC || !value || name >= m_symtabStrings.size) {
+            continue;
+        }
+
+        const char *s = (const char*)m_symtabStrings.data + name;
+        if (!*s || !memchr(s, 0, m_symtabStrings.size - name)) {
+            continue;
+        }
+
+        SymbolAddress sym;
+        sym.address = value;
+        sym.name = intern(s);
+        m_symbols.push_back(sym);
+    }
+}
+
+//Computes the enclosing range of each range, ranges are sorted
+//by start and then by decreasing end
+void DwarfReader::linkRanges()
+{
+    std::vector<uint32_t> stack;
+    for (unsigned i = 0; i < m_functions.size(); ++i) {
+        FunctionRange &f = m_functions[i];
+        while (!stack.empty() && m_functions[stack.back()].high <= f.low) {
+            stack.pop_back();
+        }
+        f.parent = stack.empty() ? ~0U : stack.back();
+        stack.push_back(i);
+    }
+}
+
+//The lookups only need the pool, drop the parsing copies
+void DwarfReader::packStrings()
+{
+    m_stringOffsets.reserve(m_strings.size());
+    for (unsigned i = 0; i < m_strings.size(); ++i) {
+        m_stringOffsets.push_back(m_stringPool.size());
+        m_stringPool.insert(m_stringPool.end(), m_strings[i].begin(), m_strings[i].end());
+        m_stringPool.push_back(0);
+    }
+
+    std::vector<std::string>().swap(m_strings);
+    std::map<std::string, uint32_t>().swap(m_stringIds);
+}
+
+bool DwarfReader::initialize()
+{
+    if (!isValid(m_file)) {
+        return false;
+    }
+
+    //Index 0 is the empty string
+    intern("");
+
+    if (!loadSections()) {
+        return false;
+    }
+
+    std::map<uint64_t, std::string> lineTables;
+    if (m_debugInfo.data) {
+        if (!parseUnits(lineTables)) {
+            return false;
+        }
+
+        std::map<uint64_t, std::string>::const_iterator it;
+        for (it = lineTables.begin(); it != lineTables.end(); ++it) {
+            uint64_t next;
+            if (!parseLineTable((*it).first, (*it).second, next)) {
+                return false;
+            }
+        }
+    } else {
+        //No units to tell where the tables are, walk the section
+        uint64_t offset = 0;
+        while (offset < m_debugLine.size) {
+            uint64_t next;
+            if (!parseLineTable(offset, "", next)) {
+                return false;
+            }
+            offset = next;
+        }
+    }
+
+    parseSymbols();
+
+    std::stable_sort(m_lines.begin(), m_lines.end());
+    std::stable_sort(m_functions.begin(), m_functions.end());
+    std::sort(m_symbols.begin(), m_symbols.end());
+    std::sort(m_sections.begin(), m_sections.end());
+    linkRanges();
+    packStrings();
+
+    m_tables.sections = m_sections.empty() ? NULL : &m_sections[0];
+    m_tables.sectionCount = m_sections.size();
+    m_tables.functions = m_functions.empty() ? NULL : &m_functions[0];
+    m_tables.functionCount = m_functions.size();
+    m_tables.lines = m_lines.empty() ? NULL : &m_lines[0];
+    m_tables.lineCount = m_lines.size();
+    m_tables.symbols = m_symbols.empty() ? NULL : &m_symbols[0];
+    m_tables.symbolCount = m_symbols.size();
+    m_tables.stringOffsets = &m_stringOffsets[0];
+    m_tables.stringCount = m_stringOffsets.size();
+    m_tables.strings = &m_stringPool[0];
+    m_tables.stringsSize = m_stringPool.size();
+    return true;
+}
+
+bool DwarfReader::getInfo(uint64_t addr, std::string &source, uint64_t &line, std::string &function) const
+{
+    return m_tables.getInfo(addr, source, line, function);
+}
+
+}
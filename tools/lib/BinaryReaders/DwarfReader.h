@@ -0,0 +1,128 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#ifndef S2ETOOLS_DWARFREADER_H
+#define S2ETOOLS_DWARFREADER_H
+
+#include <llvm/Support/MemoryBuffer.h>
+
+#include "SymbolTables.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <inttypes.h>
+
+namespace s2etools
+{
+
+/**
+ *  Decodes the DWARF line tables and function ranges of an ELF image
+ *  once, so that debug info lookups become binary searches.
+ *  Handles little-endian executables and shared objects with DWARF 2 to 4.
+ *  Anything else (relocatable objects, compressed sections, DWARF 5)
+ *  is rejected by initialize() and left to BFD.
+ */
+class DwarfReader
+{
+public:
+    struct Section {
+        const uint8_t *data;
+        uint64_t size;
+
+        Section() : data(NULL), size(0) {}
+    };
+
+private:
+    typedef std::vector<LineRow> LineRows;
+    typedef std::vector<FunctionRange> FunctionRanges;
+    typedef std::vector<SymbolAddress> SymbolAddresses;
+    typedef std::vector<SectionRange> SectionRanges;
+
+    llvm::MemoryBuffer *m_file;
+
+    Section m_debugLine, m_debugInfo, m_debugAbbrev, m_debugStr, m_debugRanges;
+    Section m_symtab, m_symtabStrings;
+    unsigned m_addressSize;
+
+    LineRows m_lines;
+    FunctionRanges m_functions; //From .debug_info
+    SymbolAddresses m_symbols;  //Function symbols, for code without DWARF
+    SectionRanges m_sections; //Symbols do not cross them
+
+    //Strings are interned while parsing, then packed into one pool
+    std::vector<std::string> m_strings;
+    std::map<std::string, uint32_t> m_stringIds;
+    std::vector<char> m_stringPool;
+    std::vector<uint32_t> m_stringOffsets;
+
+    SymbolTables m_tables;
+
+    uint32_t intern(const std::string &s);
+
+    bool loadSections();
+    bool parseUnits(std::map<uint64_t, std::string> &lineTables);
+    bool parseLineTable(uint64_t offset, const std::string &compDir, uint64_t &next);
+    void parseSymbols();
+
+    void linkRanges();
+    void packStrings();
+
+public:
+    DwarfReader(llvm::MemoryBuffer *file);
+
+    static bool isValid(llvm::MemoryBuffer *file);
+
+    bool initialize();
+
+    bool getInfo(uint64_t addr, std::string &source, uint64_t &line, std::string &function) const;
+
+    //Valid once initialize() succeeded, as long as the reader lives
+    const SymbolTables &getTables() const {
+        return m_tables;
+    }
+
+    size_t getLineCount() const {
+        return m_lines.size();
+    }
+
+    size_t getFunctionCount() const {
+        return m_functions.size() + m_symbols.size();
+    }
+};
+
+}
+
+#endif
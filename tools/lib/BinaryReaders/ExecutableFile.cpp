@@ -33,9 +33,12 @@
  * All contributors are listed in the S2E-AUTHORS file.
  */
 
+#include <algorithm>
+
 #include "ExecutableFile.h"
 #include "BFDInterface.h"
 #include "TextModule.h"
+#include "SymbolDatabase.h"
 
 namespace s2etools
 {
@@ -50,8 +53,80 @@ ExecutableFile::~ExecutableFile()
 
 }
 
-ExecutableFile *ExecutableFile::create(const std::string &fileName)
+void ExecutableFile::getInfoBatch(DebugInfos &infos)
 {
+    for (unsigned i = 0; i < infos.size(); ++i) {
+        DebugInfo &info = infos[i];
+        info.Found = getInfo(info.Address, info.File, info.Line, info.Function);
+    }
+}
+
+const FunctionEntries &ExecutableFile::functionRanges()
+{
+    static const FunctionEntries empty;
+    return empty;
+}
+
+const FunctionEntry *ExecutableFile::getFunction(uint64_t addr)
+{
+    return findFunction(functionRanges(), addr);
+}
+
+const FunctionEntry *ExecutableFile::findFunction(const FunctionEntries &functions, uint64_t addr)
+{
+    FunctionEntry key;
+    key.start = addr;
+    FunctionEntries::const_iterator it = std::upper_bound(functions.begin(), functions.end(), key);
+    if (it == functions.begin()) {
+        return NULL;
+    }
+    --it;
+    return addr < (*it).end ? &*it : NULL;
+}
+
+void ExecutableFile::mergeFunctionRanges(FunctionEntries &functions, const FunctionEntries &symbols)
+{
+    unsigned exactCount = functions.size();
+    for (unsigned i = 0; i < symbols.size(); ++i) {
+        FunctionEntry e = symbols[i];
+
+        //Aliases share the first name
+        if (i > 0 && symbols[i - 1].start == e.start) {
+            continue;
+        }
+
+        unsigned next = i + 1;
+        while (next < symbols.size() && symbols[next].start == e.start) {
+            ++next;
+        }
+        if (next < symbols.size() && symbols[next].start < e.end) {
+            e.end = symbols[next].start;
+        }
+
+        FunctionEntries::iterator it = std::upper_bound(functions.begin(), functions.begin() + exactCount, e);
+        if (it != functions.begin() && e.start < (*(it - 1)).end) {
+            continue;
+        }
+        if (it != functions.begin() + exactCount && (*it).start < e.end) {
+            e.end = (*it).start;
+        }
+        functions.push_back(e);
+    }
+
+    std::sort(functions.begin(), functions.end());
+}
+
+ExecutableFile *ExecutableFile::create(const std::string &fileName,
+                                       const std::string &databaseFile,
+                                       const std::string &descriptionFile)
+{
+    //A precompiled symbol database needs no parsing
+    SymbolDatabase *db = new SymbolDatabase(fileName, databaseFile);
+    if (db->initialize() && db->inited()) {
+        return db;
+    }
+    delete db;
+
     //Try to see if we can open the binary using BFD
     BFDInterface *bfd = new BFDInterface(fileName);
     if (bfd->initialize() && bfd->inited()) {
@@ -60,7 +135,7 @@ ExecutableFile *ExecutableFile::create(const std::string &fileName)
     delete bfd;
 
     //Check if there is a text description of the binary
-    TextModule *tm = new TextModule(fileName);
+    TextModule *tm = new TextModule(fileName, descriptionFile);
     if (tm->initialize() && tm->inited()) {
         return tm;
     }
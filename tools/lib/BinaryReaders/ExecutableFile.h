@@ -38,11 +38,24 @@
 
 
 #include <string>
+#include <vector>
 #include <inttypes.h>
 
 namespace s2etools
 {
 
+//A function of the image, end is the first address past it
+struct FunctionEntry {
+    uint64_t start, end;
+    std::string name;
+
+    bool operator<(const FunctionEntry &f) const {
+        return start < f.start;
+    }
+};
+
+typedef std::vector<FunctionEntry> FunctionEntries;
+
 /**
  *  XXX:We should get rid of BFD eventually because it does not handle all we needs
  *  For now the missing functionality is implemented by subclasses of Binary
@@ -53,6 +66,14 @@ protected:
     std::string m_fileName;
 
 public:
+    struct DebugInfo {
+        uint64_t Address;
+        bool Found;
+        std::string File, Function;
+        uint64_t Line;
+    };
+    typedef std::vector<DebugInfo> DebugInfos;
+
     ExecutableFile(const std::string &fileName);
     virtual ~ExecutableFile();
 
@@ -60,7 +81,34 @@ public:
     virtual bool getInfo(uint64_t addr, std::string &source, uint64_t &line, std::string &function) = 0;
     virtual bool inited() const = 0;
 
-    static ExecutableFile *create(const std::string &fileName);
+    //The addresses must be sorted. Formats with sorted tables
+    //resolve the whole batch in one pass over them.
+    virtual void getInfoBatch(DebugInfos &infos);
+
+    //Whether getInfo() can run on several threads at once.
+    //May finish loading the debug info to find out.
+    virtual bool isReentrant() {
+        return false;
+    }
+
+    //Sorted, non-overlapping function ranges of the image,
+    //empty if the format does not know them
+    virtual const FunctionEntries &functionRanges();
+
+    //Returns NULL if addr is not in any known function
+    const FunctionEntry *getFunction(uint64_t addr);
+    static const FunctionEntry *findFunction(const FunctionEntries &functions, uint64_t addr);
+
+    //Symbols only give the start of a function. Each one is extended up to the
+    //next symbol and clipped to the gaps between the exact ranges in functions.
+    //Both lists are sorted, the result is merged into functions.
+    static void mergeFunctionRanges(FunctionEntries &functions, const FunctionEntries &symbols);
+
+    //The precompiled symbol database and the .fcn description of the binary
+    //are looked up next to it, unless their location is given
+    static ExecutableFile *create(const std::string &fileName,
+                                  const std::string &databaseFile = "",
+                                  const std::string &descriptionFile = "");
 
     virtual bool getModuleName(std::string &name ) const = 0;
     virtual uint64_t getImageBase() const  = 0;
@@ -34,10 +34,14 @@
  */
 
 #include "Library.h"
+#include "SymbolDatabase.h"
 
 #include <sstream>
 #include <fstream>
 #include <iostream>
+#include <algorithm>
+
+#include <dirent.h>
 
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Path.h"
@@ -48,6 +52,9 @@
 namespace {
     llvm::cl::opt<unsigned>
             KernelStart("os", llvm::cl::desc("Start address of kernel space"),llvm::cl::init(0x80000000));
+
+    llvm::cl::opt<unsigned>
+            SymbolCacheSize("symcache", llvm::cl::desc("Number of debug info lookups to cache"),llvm::cl::init(65536));
 }
 
 namespace s2etools {
@@ -60,67 +67,140 @@ uint64_t Library::translatePid(uint64_t pid, uint64_t pc)
     return pid;
 }
 
-Library::Library()
+Library::Library() : m_symbolCache(SymbolCacheSize)
 {
-
+    m_indexed = false;
+    pthread_rwlock_init(&m_lock, NULL);
 }
 
 Library::~Library()
 {
-    ModuleNameToExec::iterator it;
+    Modules::iterator it;
     for(it = m_libraries.begin(); it != m_libraries.end(); ++it) {
-        delete (*it).second;
+        LoadedModule *module = (*it).second;
+        delete module->Exec;
+        pthread_mutex_destroy(&module->Lock);
+        delete module;
     }
+    pthread_rwlock_destroy(&m_lock);
+}
+
+//Names that were not found or could not be loaded may be in the new
+//directories. Called with the write lock held.
+void Library::invalidateLookups()
+{
+    m_missingFiles.clear();
+    m_badLibraries.clear();
+    m_indexed = false;
+    m_modules.clear();
+    m_symbolCache.clearMisses();
 }
 
 void Library::addPath(const std::string &path)
 {
+    pthread_rwlock_wrlock(&m_lock);
     m_libpath.push_back(path);
+    invalidateLookups();
+    pthread_rwlock_unlock(&m_lock);
 }
 
 void Library::setPaths(const PathList &s)
 {
+    pthread_rwlock_wrlock(&m_lock);
     m_libpath.clear();
     m_libpath = s;
+    invalidateLookups();
+    pthread_rwlock_unlock(&m_lock);
 }
 
-//Cycles through the list of paths and attempts to find the specified library
-bool Library::findLibrary(const std::string &libName, std::string &abspath)
+//Lists the module directories once instead of probing every
+//directory for every lookup. Earlier directories take precedence.
+void Library::buildIndex()
 {
-    PathList::const_iterator it;
+    m_fileIndex.clear();
 
+    PathList::const_iterator it;
     for (it = m_libpath.begin(); it != m_libpath.end(); ++it) {
-        llvm::sys::Path lib(*it);
-        lib.appendComponent(libName);
+        DIR *dir = opendir((*it).c_str());
+        if (!dir) {
+            continue;
+        }
 
-        bool exists = false;
-        llvm::sys::fs::exists(lib.str(), exists);
+        struct dirent *entry;
+        while ((entry = readdir(dir))) {
+            std::string name = entry->d_name;
+            if (name == "." || name == ".." || m_fileIndex.count(name)) {
+                continue;
+            }
 
-        if (exists) {
-            abspath = lib.str();
-            return true;
+            llvm::sys::Path path(*it);
+            path.appendComponent(name);
+            m_fileIndex[name] = path.str();
         }
+        closedir(dir);
     }
-    return false;
+
+    m_indexed = true;
 }
 
-bool Library::findSuffixedModule(const std::string &moduleName, const std::string &suffix, llvm::sys::Path &path)
+//The index is rebuilt when a file is not found, in case it was added
+//after the last scan. Each missing name triggers at most one rescan.
+bool Library::findFile(const std::string &name, std::string &abspath)
 {
-    PathList::const_iterator it;
+    //Names with directories are not in the index
+    if (name.find('/') != std::string::npos) {
+        PathList::const_iterator it;
+        for (it = m_libpath.begin(); it != m_libpath.end(); ++it) {
+            llvm::sys::Path lib(*it);
+            lib.appendComponent(name);
+
+            bool exists = false;
+            llvm::sys::fs::exists(lib.str(), exists);
+            if (exists) {
+                abspath = lib.str();
+                return true;
+            }
+        }
+        return false;
+    }
 
-    for (it = m_libpath.begin(); it != m_libpath.end(); ++it) {
-        llvm::sys::Path list(*it);
-        list.appendComponent(moduleName);
-        list.appendSuffix(suffix);
-
-        bool exists = false;
-        llvm::sys::fs::exists(list.str(), exists);
-        if (exists) {
-            path = list;
-            return true;
+    if (!m_indexed) {
+        buildIndex();
+    }
+
+    FileIndex::const_iterator it = m_fileIndex.find(name);
+    if (it == m_fileIndex.end()) {
+        if (m_missingFiles.count(name)) {
+            return false;
+        }
+
+        buildIndex();
+        it = m_fileIndex.find(name);
+        if (it == m_fileIndex.end()) {
+            m_missingFiles.insert(name);
+            return false;
         }
     }
-    return false;
+
+    abspath = (*it).second;
+    return true;
+}
+
+//Looks for the specified library in the list of paths
+bool Library::findLibrary(const std::string &libName, std::string &abspath)
+{
+    return findFile(libName, abspath);
+}
+
+bool Library::findSuffixedModule(const std::string &moduleName, const std::string &suffix, llvm::sys::Path &path)
+{
+    std::string abspath;
+    if (!findFile(moduleName + "." + suffix, abspath)) {
+        return false;
+    }
+
+    path = llvm::sys::Path(abspath);
+    return true;
 }
 
 bool Library::findBasicBlockList(const std::string &moduleName, llvm::sys::Path &path)
@@ -136,6 +216,27 @@ bool Library::findDisassemblyListing(const std::string &moduleName, llvm::sys::P
 
 
 
+//Files generated for a binary (symbol databases, function lists) are looked
+//up in the module directories by the name of the binary. Most binaries
+//have none, so a missing companion does not trigger a rescan.
+bool Library::findCompanion(const std::string &binary, const std::string &suffix, std::string &abspath)
+{
+    if (!m_indexed) {
+        buildIndex();
+    }
+
+    size_t pos = binary.find_last_of("\\/");
+    std::string name = pos == std::string::npos ? binary : binary.substr(pos + 1);
+
+    FileIndex::const_iterator it = m_fileIndex.find(name + suffix);
+    if (it == m_fileIndex.end()) {
+        return false;
+    }
+
+    abspath = (*it).second;
+    return true;
+}
+
 //Add a library using a relative path
 bool Library::addLibrary(const std::string &libName)
 {
@@ -160,52 +261,285 @@ bool Library::addLibraryAbs(const std::string &libName)
 
     std::string ProgFile = libName;
 
-    s2etools::ExecutableFile *exec = s2etools::ExecutableFile::create(ProgFile);
+    std::string databaseFile, descriptionFile;
+    findCompanion(ProgFile, SymbolDatabase::Suffix, databaseFile);
+    findCompanion(ProgFile, ".fcn", descriptionFile);
+
+    s2etools::ExecutableFile *exec = s2etools::ExecutableFile::create(ProgFile, databaseFile, descriptionFile);
     if (!exec) {
         m_badLibraries.insert(ProgFile);
         return false;
     }
 
-    m_libraries[libName] = exec;
+    LoadedModule *module = new LoadedModule();
+    module->Exec = exec;
+    module->ReentrantKnown = false;
+    module->Reentrant = false;
+    module->Functions = NULL;
+    pthread_mutex_init(&module->Lock, NULL);
+    m_libraries[libName] = module;
     return true;
 }
 
+//Modules are looked up under the read lock, only the first
+//request for a name takes the write lock to load it
+Library::LoadedModule *Library::getModule(const std::string &name)
+{
+    pthread_rwlock_rdlock(&m_lock);
+    Modules::const_iterator it = m_modules.find(name);
+    if (it != m_modules.end()) {
+        LoadedModule *module = (*it).second;
+        pthread_rwlock_unlock(&m_lock);
+        return module;
+    }
+    pthread_rwlock_unlock(&m_lock);
+
+    pthread_rwlock_wrlock(&m_lock);
+    LoadedModule *module = NULL;
+    it = m_modules.find(name);
+    if (it != m_modules.end()) {
+        module = (*it).second;
+    } else {
+        std::string s;
+        if (findLibrary(name, s) && addLibraryAbs(s)) {
+            module = m_libraries[s];
+        }
+        m_modules[name] = module;
+    }
+    pthread_rwlock_unlock(&m_lock);
+    return module;
+}
+
 //Get a library using a name
 ExecutableFile *Library::get(const std::string &name)
 {
-    std::string s;
-    if (!findLibrary(name, s)) {
-        return NULL;
+    LoadedModule *module = getModule(name);
+    return module ? module->Exec : NULL;
+}
+
+//Returns with the module lock held unless the format is reentrant.
+//Asking the format may decode its debug info, so this is left to the
+//first lookup instead of slowing down the loading of the module.
+bool Library::lockModule(LoadedModule *module)
+{
+    pthread_mutex_lock(&module->Lock);
+    if (!module->ReentrantKnown) {
+        module->Reentrant = module->Exec->isReentrant();
+        module->ReentrantKnown = true;
     }
 
-    if (!addLibraryAbs(s)) {
-        return NULL;
+    if (module->Reentrant) {
+        pthread_mutex_unlock(&module->Lock);
+        return false;
     }
+    return true;
+}
 
-    ModuleNameToExec::const_iterator it = m_libraries.find(s);
-    if (it == m_libraries.end()) {
+bool Library::getModuleInfo(LoadedModule *module, uint64_t reladdr,
+                            std::string &file, uint64_t &line, std::string &func)
+{
+    bool locked = lockModule(module);
+    bool ret = module->Exec->getInfo(reladdr, file, line, func);
+    if (locked) {
+        pthread_mutex_unlock(&module->Lock);
+    }
+    return ret;
+}
 
-        return NULL;
+//Debug info lookups are slow, the same pcs are looked up over and over
+bool Library::getCachedInfo(ModuleId id, uint64_t reladdr,
+                            std::string &file, uint64_t &line, std::string &func)
+{
+    SymbolCache::Info info;
+    if (m_symbolCache.lookup(id, reladdr, info)) {
+        if (!info.Found) {
+            return false;
+        }
+        file = *info.File;
+        func = *info.Function;
+        line = info.Line;
+        return true;
+    }
+
+    info.Found = false;
+    info.File = info.Function = NULL;
+    info.Line = 0;
+
+    LoadedModule *module = getModule(ModuleNames::getName(id));
+    if (module && getModuleInfo(module, reladdr, file, line, func)) {
+        info.Found = true;
+        info.File = m_symbolCache.intern(file);
+        info.Function = m_symbolCache.intern(func);
+        info.Line = line;
     }
 
-    return (*it).second;
+    m_symbolCache.insert(id, reladdr, info);
+    return info.Found;
 }
 
 bool Library::getInfo(const ModuleInstance *mi, uint64_t pc, std::string &file, uint64_t &line, std::string &func)
 {
     if(!mi)
         return false;
-    ExecutableFile *exec = get(mi->Name);
-    if (!exec) {
-        return false;
+
+    uint64_t reladdr = pc - mi->LoadBase + mi->ImageBase;
+    return getCachedInfo(mi->Id, reladdr, file, line, func);
+}
+
+//The ranges are built once under the module lock, they do not change afterwards
+const FunctionEntries *Library::getFunctionRanges(ModuleId id)
+{
+    LoadedModule *module = getModule(ModuleNames::getName(id));
+    if (!module) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&module->Lock);
+    if (!module->Functions) {
+        module->Functions = &module->Exec->functionRanges();
+    }
+    const FunctionEntries *functions = module->Functions;
+    pthread_mutex_unlock(&module->Lock);
+    return functions;
+}
+
+const FunctionEntry *Library::getFunction(const ModuleInstance *mi, uint64_t pc)
+{
+    if (!mi) {
+        return NULL;
+    }
+
+    const FunctionEntries *functions = getFunctionRanges(mi->Id);
+    if (!functions) {
+        return NULL;
     }
 
     uint64_t reladdr = pc - mi->LoadBase + mi->ImageBase;
-    if (!exec->getInfo(reladdr, file, line, func)) {
-        return false;
+    return ExecutableFile::findFunction(*functions, reladdr);
+}
+
+Library::SymbolQuery::SymbolQuery(const ModuleInstance *mi, uint64_t pc)
+{
+    if (mi) {
+        Module = mi->Id;
+        Address = pc - mi->LoadBase + mi->ImageBase;
+    } else {
+        Module = ModuleNames::NoModule;
+        Address = pc;
     }
+    Found = false;
+    Line = 0;
+}
 
-    return true;
+Library::SymbolQuery::SymbolQuery(ModuleId module, uint64_t address)
+{
+    Module = module;
+    Address = address;
+    Found = false;
+    Line = 0;
+}
+
+void Library::getInfoBatch(SymbolQueries &queries)
+{
+    //Queries sorted by module and address, the index keeps the caller's order
+    typedef std::pair<std::pair<ModuleId, uint64_t>, unsigned> QueryKey;
+    std::vector<QueryKey> keys;
+    keys.reserve(queries.size());
+
+    for (unsigned i = 0; i < queries.size(); ++i) {
+        SymbolQuery &q = queries[i];
+        q.Found = false;
+        q.File.clear();
+        q.Function.clear();
+        q.Line = 0;
+        if (q.Module != ModuleNames::NoModule) {
+            keys.push_back(std::make_pair(std::make_pair(q.Module, q.Address), i));
+        }
+    }
+
+    std::sort(keys.begin(), keys.end());
+
+    unsigned begin = 0;
+    while (begin < keys.size()) {
+        ModuleId id = keys[begin].first.first;
+        unsigned end = begin;
+        while (end < keys.size() && keys[end].first.first == id) {
+            ++end;
+        }
+
+        //Distinct addresses that are not cached yet
+        ExecutableFile::DebugInfos infos;
+        std::vector<unsigned> pending;
+        for (unsigned i = begin; i < end; ++i) {
+            if (i > begin && keys[i].first == keys[i - 1].first) {
+                continue;
+            }
+
+            SymbolQuery &q = queries[keys[i].second];
+            SymbolCache::Info info;
+            if (m_symbolCache.lookup(id, q.Address, info)) {
+                if (info.Found) {
+                    q.Found = true;
+                    q.File = *info.File;
+                    q.Function = *info.Function;
+                    q.Line = info.Line;
+                }
+                continue;
+            }
+
+            ExecutableFile::DebugInfo d;
+            d.Address = q.Address;
+            d.Found = false;
+            d.Line = 0;
+            infos.push_back(d);
+            pending.push_back(keys[i].second);
+        }
+
+        if (!infos.empty()) {
+            LoadedModule *module = getModule(ModuleNames::getName(id));
+            if (module) {
+                bool locked = lockModule(module);
+                module->Exec->getInfoBatch(infos);
+                if (locked) {
+                    pthread_mutex_unlock(&module->Lock);
+                }
+            }
+
+            for (unsigned i = 0; i < infos.size(); ++i) {
+                const ExecutableFile::DebugInfo &d = infos[i];
+                SymbolQuery &q = queries[pending[i]];
+
+                SymbolCache::Info info;
+                info.Found = module && d.Found;
+                info.File = info.Function = NULL;
+                info.Line = 0;
+                if (info.Found) {
+                    q.Found = true;
+                    q.File = d.File;
+                    q.Function = d.Function;
+                    q.Line = d.Line;
+                    info.File = m_symbolCache.intern(d.File);
+                    info.Function = m_symbolCache.intern(d.Function);
+                    info.Line = d.Line;
+                }
+                m_symbolCache.insert(id, d.Address, info);
+            }
+        }
+
+        //Duplicates copy the result of the previous query of their address
+        for (unsigned i = begin + 1; i < end; ++i) {
+            if (keys[i].first == keys[i - 1].first) {
+                const SymbolQuery &src = queries[keys[i - 1].second];
+                SymbolQuery &dst = queries[keys[i].second];
+                dst.Found = src.Found;
+                dst.File = src.File;
+                dst.Function = src.Function;
+                dst.Line = src.Line;
+            }
+        }
+
+        begin = end;
+    }
 }
 
 //Helper function to quickly print debug info
@@ -213,16 +547,10 @@ bool Library::print(
         const std::string &modName, uint64_t loadBase, uint64_t imageBase,
         uint64_t pc, std::string &out, bool file, bool line, bool func)
 {
-
-    ExecutableFile *exec = get(modName);
-    if (!exec) {
-        return false;
-    }
-
     uint64_t reladdr = pc - loadBase + imageBase;
     std::string source, function;
     uint64_t ln;
-    if (!exec->getInfo(reladdr, source, ln, function)) {
+    if (!getCachedInfo(ModuleNames::intern(modName), reladdr, source, ln, function)) {
         return false;
     }
 
@@ -251,7 +579,7 @@ bool Library::print(const ModuleInstance *mi, uint64_t pc, std::string &out, boo
         return false;
     }
 
-    return print(mi->Name,
+    return print(mi->getName(),
                  mi->LoadBase, mi->ImageBase,
                  pc, out, file, line, func);
 }
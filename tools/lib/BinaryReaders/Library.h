@@ -38,6 +38,7 @@
 #define S2ETOOLS_LIBRARY_H
 
 #include "ExecutableFile.h"
+#include "SymbolCache.h"
 
 #include "lib/ExecutionTracer/ModuleParser.h"
 #include "llvm/Support/Path.h"
@@ -45,10 +46,17 @@
 #include <string>
 #include <set>
 #include <inttypes.h>
+#include <pthread.h>
 
 namespace s2etools
 {
 
+/**
+ *  Debug info lookups (get, getInfo, getInfoBatch and print) may be
+ *  called from several threads. The module table is read-mostly,
+ *  a module is loaded once by the first thread that needs it.
+ *  The search paths and the find* helpers are set up beforehand.
+ */
 class Library
 {
 public:
@@ -56,6 +64,21 @@ public:
     typedef std::vector<std::string> PathList;
     typedef std::set<std::string> StringSet;
 
+    //A pc to symbolize later with getInfoBatch(), the address
+    //is relative to the image base of the module
+    struct SymbolQuery {
+        ModuleId Module;
+        uint64_t Address;
+
+        bool Found;
+        std::string File, Function;
+        uint64_t Line;
+
+        SymbolQuery(const ModuleInstance *mi, uint64_t pc);
+        SymbolQuery(ModuleId module, uint64_t address);
+    };
+    typedef std::vector<SymbolQuery> SymbolQueries;
+
     Library();
     virtual ~Library();
 
@@ -74,6 +97,15 @@ public:
     bool print(const ModuleInstance *ni, uint64_t pc, std::string &out, bool file, bool line, bool func);
     bool getInfo(const ModuleInstance *ni, uint64_t pc, std::string &file, uint64_t &line, std::string &func);
 
+    //Function ranges of a module, relative to its image base.
+    //NULL if the module could not be loaded.
+    const FunctionEntries *getFunctionRanges(ModuleId id);
+    const FunctionEntry *getFunction(const ModuleInstance *mi, uint64_t pc);
+
+    //Resolves the queries of each module in one pass over its tables,
+    //results are stored in the queries
+    void getInfoBatch(SymbolQueries &queries);
+
     bool findLibrary(const std::string &libName, std::string &abspath);
     bool findSuffixedModule(const std::string &moduleName, const std::string &suffix, llvm::sys::Path &path);
     bool findBasicBlockList(const std::string &moduleName, llvm::sys::Path &path);
@@ -81,12 +113,53 @@ public:
 
 
 
+    const SymbolCache &getSymbolCache() const {
+        return m_symbolCache;
+    }
+
     static uint64_t translatePid(uint64_t pid, uint64_t pc);
 private:
+    //Formats that are not reentrant serialize the lookups of each module.
+    //Reentrancy is only known after the first lookup.
+    struct LoadedModule {
+        ExecutableFile *Exec;
+        bool ReentrantKnown;
+        bool Reentrant;
+        const FunctionEntries *Functions;
+        pthread_mutex_t Lock;
+    };
+
+    //Modules by absolute path, and by the names they were requested
+    //with (NULL when they could not be loaded)
+    typedef std::map<std::string, LoadedModule*> Modules;
+
     PathList m_libpath;
     //std::string m_libpath;
-    ModuleNameToExec m_libraries;
+    Modules m_libraries;
+    Modules m_modules;
     StringSet m_badLibraries;
+    pthread_rwlock_t m_lock;
+
+    SymbolCache m_symbolCache;
+
+    //File names found in the module directories, mapped to the path
+    //in the first directory that has them
+    typedef std::map<std::string, std::string> FileIndex;
+    FileIndex m_fileIndex;
+    StringSet m_missingFiles;
+    bool m_indexed;
+
+    void buildIndex();
+    void invalidateLookups();
+    bool findFile(const std::string &name, std::string &abspath);
+    bool findCompanion(const std::string &binary, const std::string &suffix, std::string &abspath);
+
+    LoadedModule *getModule(const std::string &name);
+    static bool lockModule(LoadedModule *module);
+    static bool getModuleInfo(LoadedModule *module, uint64_t reladdr,
+                              std::string &file, uint64_t &line, std::string &func);
+    bool getCachedInfo(ModuleId id, uint64_t reladdr,
+                       std::string &file, uint64_t &line, std::string &func);
 
 };
 
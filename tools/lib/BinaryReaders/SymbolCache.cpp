@@ -0,0 +1,214 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#include "SymbolCache.h"
+
+namespace s2etools {
+
+namespace {
+
+//64-bit finalizer of MurmurHash3
+uint64_t mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+}
+
+SymbolCache::SymbolCache(unsigned capacity, unsigned shards)
+{
+    if (!shards) {
+        shards = 1;
+    }
+
+    m_SetsPerShard = (capacity + shards * Ways - 1) / (shards * Ways);
+    if (!m_SetsPerShard) {
+        m_SetsPerShard = 1;
+    }
+
+    m_ShardCount = shards;
+    m_Shards = new Shard[shards];
+    for (unsigned i = 0; i < shards; ++i) {
+        m_Shards[i].Entries.resize(m_SetsPerShard * Ways);
+        pthread_mutex_init(&m_Shards[i].Lock, NULL);
+    }
+    pthread_mutex_init(&m_StringsLock, NULL);
+
+    clear();
+}
+
+SymbolCache::~SymbolCache()
+{
+    for (unsigned i = 0; i < m_ShardCount; ++i) {
+        pthread_mutex_destroy(&m_Shards[i].Lock);
+    }
+    pthread_mutex_destroy(&m_StringsLock);
+    delete [] m_Shards;
+}
+
+void SymbolCache::clear()
+{
+    for (unsigned i = 0; i < m_ShardCount; ++i) {
+        Shard &shard = m_Shards[i];
+        pthread_mutex_lock(&shard.Lock);
+        for (unsigned j = 0; j < shard.Entries.size(); ++j) {
+            shard.Entries[j].LastUse = 0;
+        }
+        shard.Clock = 0;
+        shard.Hits = shard.Misses = shard.Evictions = 0;
+        pthread_mutex_unlock(&shard.Lock);
+    }
+}
+
+void SymbolCache::clearMisses()
+{
+    for (unsigned i = 0; i < m_ShardCount; ++i) {
+        Shard &shard = m_Shards[i];
+        pthread_mutex_lock(&shard.Lock);
+        for (unsigned j = 0; j < shard.Entries.size(); ++j) {
+            if (!shard.Entries[j].Data.Found) {
+                shard.Entries[j].LastUse = 0;
+            }
+        }
+        pthread_mutex_unlock(&shard.Lock);
+    }
+}
+
+SymbolCache::Shard &SymbolCache::getShard(ModuleId module, uint64_t pc, Entry *&set)
+{
+    uint64_t h = mix(pc ^ ((uint64_t)module << 48));
+    Shard &shard = m_Shards[h % m_ShardCount];
+    unsigned index = (h / m_ShardCount) % m_SetsPerShard;
+    set = &shard.Entries[index * Ways];
+    return shard;
+}
+
+uint64_t SymbolCache::sum(uint64_t Shard::*counter) const
+{
+    uint64_t total = 0;
+    for (unsigned i = 0; i < m_ShardCount; ++i) {
+        Shard &shard = m_Shards[i];
+        pthread_mutex_lock(&shard.Lock);
+        total += shard.*counter;
+        pthread_mutex_unlock(&shard.Lock);
+    }
+    return total;
+}
+
+bool SymbolCache::lookup(ModuleId module, uint64_t pc, Info &info)
+{
+    Entry *set;
+    Shard &shard = getShard(module, pc, set);
+
+    pthread_mutex_lock(&shard.Lock);
+    for (unsigned i = 0; i < Ways; ++i) {
+        Entry &e = set[i];
+        if (e.LastUse && e.Module == module && e.Pc == pc) {
+            e.LastUse = ++shard.Clock;
+            info = e.Data;
+            ++shard.Hits;
+            pthread_mutex_unlock(&shard.Lock);
+            return true;
+        }
+    }
+
+    ++shard.Misses;
+    pthread_mutex_unlock(&shard.Lock);
+    return false;
+}
+
+void SymbolCache::insert(ModuleId module, uint64_t pc, const Info &info)
+{
+    Entry *set;
+    Shard &shard = getShard(module, pc, set);
+
+    pthread_mutex_lock(&shard.Lock);
+    Entry *victim = &set[0];
+    for (unsigned i = 0; i < Ways; ++i) {
+        Entry &e = set[i];
+        if (e.LastUse && e.Module == module && e.Pc == pc) {
+            victim = &e;
+            break;
+        }
+        if (e.LastUse < victim->LastUse) {
+            victim = &e;
+        }
+    }
+
+    if (victim->LastUse && (victim->Module != module || victim->Pc != pc)) {
+        ++shard.Evictions;
+    }
+
+    victim->Module = module;
+    victim->Pc = pc;
+    victim->Data = info;
+    victim->LastUse = ++shard.Clock;
+    pthread_mutex_unlock(&shard.Lock);
+}
+
+const std::string *SymbolCache::intern(const std::string &s)
+{
+    pthread_mutex_lock(&m_StringsLock);
+    std::map<std::string, const std::string*>::iterator it = m_StringIds.find(s);
+    if (it != m_StringIds.end()) {
+        const std::string *ret = (*it).second;
+        pthread_mutex_unlock(&m_StringsLock);
+        return ret;
+    }
+
+    m_Strings.push_back(s);
+    const std::string *ret = &m_Strings.back();
+    m_StringIds[s] = ret;
+    pthread_mutex_unlock(&m_StringsLock);
+    return ret;
+}
+
+void SymbolCache::printStats(std::ostream &os) const
+{
+    uint64_t hits = getHits(), misses = getMisses();
+    uint64_t total = hits + misses;
+    os << std::dec << "Symbol cache: " << hits << " hits, " << misses << " misses";
+    if (total) {
+        os << " (" << (hits * 100 / total) << "% hit rate)";
+    }
+    os << ", " << getEvictions() << " evictions, capacity " << getCapacity() << std::endl;
+}
+
+}
@@ -0,0 +1,134 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#ifndef S2ETOOLS_SYMBOLCACHE_H
+#define S2ETOOLS_SYMBOLCACHE_H
+
+#include <lib/ExecutionTracer/ModuleParser.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <ostream>
+#include <inttypes.h>
+#include <pthread.h>
+
+namespace s2etools
+{
+
+/**
+ *  Bounded cache of debug information lookups, keyed by module and
+ *  module-relative pc. Failed lookups are cached too.
+ *  The cache is split into shards, each shard is a set-associative
+ *  table that evicts the least recently used entry of a set.
+ *  Each shard has its own lock, threads only contend when they
+ *  hit the same shard.
+ */
+class SymbolCache
+{
+public:
+    struct Info {
+        const std::string *File, *Function; //Interned strings
+        uint64_t Line;
+        bool Found;
+    };
+
+private:
+    static const unsigned Ways = 4;
+
+    struct Entry {
+        ModuleId Module;
+        uint64_t Pc;
+        Info Data;
+        uint64_t LastUse; //0 for free entries
+    };
+
+    struct Shard {
+        std::vector<Entry> Entries;
+        pthread_mutex_t Lock;
+        uint64_t Clock;
+        uint64_t Hits, Misses, Evictions;
+    };
+
+    Shard *m_Shards;
+    unsigned m_ShardCount;
+    unsigned m_SetsPerShard;
+
+    //Strings are never freed, a deque keeps them in place
+    std::map<std::string, const std::string*> m_StringIds;
+    std::deque<std::string> m_Strings;
+    pthread_mutex_t m_StringsLock;
+
+    Shard &getShard(ModuleId module, uint64_t pc, Entry *&set);
+    uint64_t sum(uint64_t Shard::*counter) const;
+
+public:
+    //The capacity is rounded up to a whole number of sets per shard
+    SymbolCache(unsigned capacity, unsigned shards = 16);
+    ~SymbolCache();
+
+    bool lookup(ModuleId module, uint64_t pc, Info &info);
+    void insert(ModuleId module, uint64_t pc, const Info &info);
+    void clear();
+
+    //Drops the pcs that could not be symbolized, keeps the statistics
+    void clearMisses();
+
+    //The returned string stays valid as long as the cache
+    const std::string *intern(const std::string &s);
+
+    uint64_t getHits() const {
+        return sum(&Shard::Hits);
+    }
+
+    uint64_t getMisses() const {
+        return sum(&Shard::Misses);
+    }
+
+    uint64_t getEvictions() const {
+        return sum(&Shard::Evictions);
+    }
+
+    unsigned getCapacity() const {
+        return m_ShardCount * m_SetsPerShard * Ways;
+    }
+
+    void printStats(std::ostream &os) const;
+};
+
+}
+
+#endif
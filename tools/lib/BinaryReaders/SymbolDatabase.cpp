@@ -0,0 +1,308 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#include "SymbolDatabase.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fstream>
+#include <iostream>
+
+namespace s2etools
+{
+
+namespace {
+
+const char Magic[8] = {'S', '2', 'E', 'S', 'Y', 'M', 0, 0};
+const uint32_t Version = 1;
+
+//Tables start on 8-byte boundaries so that they can be used in place
+bool checkTable(uint64_t fileSize, uint64_t offset, uint64_t count, uint64_t recordSize)
+{
+    if (offset % 8 || offset > fileSize) {
+        return false;
+    }
+    return count <= (fileSize - offset) / recordSize;
+}
+
+void writeTable(std::ofstream &os, uint64_t &offset, const void *data, uint64_t size)
+{
+    static const char padding[8] = {0};
+    os.write((const char*)data, size);
+    offset += size;
+    if (offset % 8) {
+        os.write(padding, 8 - offset % 8);
+        offset += 8 - offset % 8;
+    }
+}
+
+}
+
+const char *SymbolDatabase::Suffix = ".s2esym";
+
+SymbolDatabase::SymbolDatabase(const std::string &fileName, const std::string &databaseName):
+        ExecutableFile(fileName), m_databaseName(databaseName)
+{
+    m_mapping = NULL;
+    m_mappingSize = 0;
+    m_header = NULL;
+    m_functionsInited = false;
+}
+
+SymbolDatabase::~SymbolDatabase()
+{
+    if (m_mapping) {
+        munmap(m_mapping, m_mappingSize);
+    }
+}
+
+bool SymbolDatabase::load(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (uint64_t)st.st_size < sizeof(Header)) {
+        close(fd);
+        return false;
+    }
+
+    void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    m_mapping = mapping;
+    m_mappingSize = st.st_size;
+
+    const Header *hdr = (const Header*)mapping;
+    if (memcmp(hdr->magic, Magic, sizeof(Magic)) || hdr->version != Version ||
+        hdr->headerSize != sizeof(Header)) {
+        std::cerr << path << " is not a symbol database of this version" << std::endl;
+        return false;
+    }
+
+    if (!checkTable(m_mappingSize, hdr->sectionsOffset, hdr->sectionCount, sizeof(SectionRange)) ||
+        !checkTable(m_mappingSize, hdr->functionsOffset, hdr->functionCount, sizeof(FunctionRange)) ||
+        !checkTable(m_mappingSize, hdr->linesOffset, hdr->lineCount, sizeof(LineRow)) ||
+        !checkTable(m_mappingSize, hdr->symbolsOffset, hdr->symbolCount, sizeof(SymbolAddress)) ||
+        !checkTable(m_mappingSize, hdr->stringOffsetsOffset, hdr->stringCount, sizeof(uint32_t)) ||
+        !checkTable(m_mappingSize, hdr->stringsOffset, hdr->stringsSize, 1) ||
+        !hdr->stringsSize) {
+        std::cerr << path << " is truncated" << std::endl;
+        return false;
+    }
+
+    const char *base = (const char*)mapping;
+    if (base[hdr->stringsOffset + hdr->stringsSize - 1]) {
+        std::cerr << path << " has an unterminated string pool" << std::endl;
+        return false;
+    }
+
+    m_tables.sections = (const SectionRange*)(base + hdr->sectionsOffset);
+    m_tables.sectionCount = hdr->sectionCount;
+    m_tables.functions = (const FunctionRange*)(base + hdr->functionsOffset);
+    m_tables.functionCount = hdr->functionCount;
+    m_tables.lines = (const LineRow*)(base + hdr->linesOffset);
+    m_tables.lineCount = hdr->lineCount;
+    m_tables.symbols = (const SymbolAddress*)(base + hdr->symbolsOffset);
+    m_tables.symbolCount = hdr->symbolCount;
+    m_tables.stringOffsets = (const uint32_t*)(base + hdr->stringOffsetsOffset);
+    m_tables.stringCount = hdr->stringCount;
+    m_tables.strings = base + hdr->stringsOffset;
+    m_tables.stringsSize = hdr->stringsSize;
+
+    m_header = hdr;
+    return true;
+}
+
+bool SymbolDatabase::initialize()
+{
+    if (m_header) {
+        return true;
+    }
+
+    std::string path = m_databaseName.empty() ? m_fileName + Suffix : m_databaseName;
+    if (!load(path)) {
+        if (m_mapping) {
+            munmap(m_mapping, m_mappingSize);
+            m_mapping = NULL;
+        }
+        return false;
+    }
+
+    //A rebuilt binary makes the database useless
+    struct stat st;
+    if (stat(m_fileName.c_str(), &st) == 0 &&
+        ((uint64_t)st.st_size != m_header->binarySize || (uint64_t)st.st_mtime != m_header->binaryTime)) {
+        std::cerr << path << " is older than " << m_fileName << ", ignoring it" << std::endl;
+        munmap(m_mapping, m_mappingSize);
+        m_mapping = NULL;
+        m_header = NULL;
+        return false;
+    }
+
+    size_t pos = m_fileName.find_last_of("\\/");
+    if (pos == std::string::npos) {
+        m_moduleName = m_fileName;
+    }else {
+        m_moduleName = m_fileName.substr(pos);
+    }
+
+    return true;
+}
+
+bool SymbolDatabase::getInfo(uint64_t addr, std::string &source, uint64_t &line, std::string &function)
+{
+    if (!m_header) {
+        return false;
+    }
+    return m_tables.getInfo(addr, source, line, function);
+}
+
+void SymbolDatabase::getInfoBatch(DebugInfos &infos)
+{
+    if (!m_header) {
+        ExecutableFile::getInfoBatch(infos);
+        return;
+    }
+    m_tables.getInfoBatch(infos);
+}
+
+bool SymbolDatabase::getModuleName(std::string &name ) const
+{
+    if (!m_header) {
+        return false;
+    }
+
+    name = m_moduleName;
+    return true;
+}
+
+uint64_t SymbolDatabase::getImageBase() const
+{
+    return m_header ? m_header->imageBase : 0;
+}
+
+uint64_t SymbolDatabase::getImageSize() const
+{
+    return m_header ? m_header->imageSize : 0;
+}
+
+//Only place where the database is not read-only, the callers of a
+//reentrant file must build the ranges before sharing them
+const FunctionEntries &SymbolDatabase::functionRanges()
+{
+    if (!m_functionsInited && m_header) {
+        m_functionsInited = true;
+        m_tables.getFunctionRanges(m_functions);
+    }
+    return m_functions;
+}
+
+//Writes to a temporary file first, a reader never sees half a database
+bool SymbolDatabase::write(const std::string &path, const SymbolTables &tables,
+                           uint64_t imageBase, uint64_t imageSize,
+                           const std::string &binary)
+{
+    struct stat st;
+    if (stat(binary.c_str(), &st) < 0) {
+        std::cerr << "Could not stat " << binary << std::endl;
+        return false;
+    }
+
+    Header hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, Magic, sizeof(Magic));
+    hdr.version = Version;
+    hdr.headerSize = sizeof(Header);
+    hdr.imageBase = imageBase;
+    hdr.imageSize = imageSize;
+    hdr.binarySize = st.st_size;
+    hdr.binaryTime = st.st_mtime;
+
+    uint64_t offset = sizeof(Header);
+    hdr.sectionsOffset = offset;
+    hdr.sectionCount = tables.sectionCount;
+    offset += tables.sectionCount * sizeof(SectionRange);
+    hdr.functionsOffset = offset;
+    hdr.functionCount = tables.functionCount;
+    offset += tables.functionCount * sizeof(FunctionRange);
+    hdr.linesOffset = offset;
+    hdr.lineCount = tables.lineCount;
+    offset += tables.lineCount * sizeof(LineRow);
+    hdr.symbolsOffset = offset;
+    hdr.symbolCount = tables.symbolCount;
+    offset += tables.symbolCount * sizeof(SymbolAddress);
+    hdr.stringOffsetsOffset = offset;
+    hdr.stringCount = tables.stringCount;
+    offset += (tables.stringCount * sizeof(uint32_t) + 7) & ~7ULL;
+    hdr.stringsOffset = offset;
+    hdr.stringsSize = tables.stringsSize;
+
+    std::string tmp = path + ".tmp";
+    std::ofstream os(tmp.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!os) {
+        std::cerr << "Could not create " << tmp << std::endl;
+        return false;
+    }
+
+    offset = 0;
+    writeTable(os, offset, &hdr, sizeof(hdr));
+    writeTable(os, offset, tables.sections, tables.sectionCount * sizeof(SectionRange));
+    writeTable(os, offset, tables.functions, tables.functionCount * sizeof(FunctionRange));
+    writeTable(os, offset, tables.lines, tables.lineCount * sizeof(LineRow));
+    writeTable(os, offset, tables.symbols, tables.symbolCount * sizeof(SymbolAddress));
+    writeTable(os, offset, tables.stringOffsets, tables.stringCount * sizeof(uint32_t));
+    writeTable(os, offset, tables.strings, tables.stringsSize);
+    os.close();
+
+    if (!os || rename(tmp.c_str(), path.c_str()) < 0) {
+        std::cerr << "Could not write " << path << std::endl;
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,122 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#ifndef S2ETOOLS_SYMBOLDATABASE_H
+#define S2ETOOLS_SYMBOLDATABASE_H
+
+#include "ExecutableFile.h"
+#include "SymbolTables.h"
+
+namespace s2etools
+{
+
+/**
+ *  Precompiled debug info of a module, stored as <binary>.s2esym
+ *  by s2esym-build, next to the binary or in a module directory. The file is mapped as is:
+ *  the tables are already sorted and lookups are binary searches
+ *  in the mapping, without any parsing at load time.
+ *  The records are in host byte order.
+ */
+class SymbolDatabase:public ExecutableFile
+{
+public:
+    static const char *Suffix;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t headerSize;
+
+        uint64_t imageBase, imageSize;
+
+        //Detects databases older than their binary
+        uint64_t binarySize, binaryTime;
+
+        uint64_t sectionsOffset, sectionCount;
+        uint64_t functionsOffset, functionCount;
+        uint64_t linesOffset, lineCount;
+        uint64_t symbolsOffset, symbolCount;
+        uint64_t stringOffsetsOffset, stringCount;
+        uint64_t stringsOffset, stringsSize;
+    };
+
+private:
+    void *m_mapping;
+    uint64_t m_mappingSize;
+    const Header *m_header;
+    SymbolTables m_tables;
+    std::string m_moduleName;
+    std::string m_databaseName;
+    FunctionEntries m_functions;
+    bool m_functionsInited;
+
+    bool load(const std::string &path);
+
+public:
+    //fileName is the binary. The database is <fileName>.s2esym
+    //if databaseName is empty.
+    SymbolDatabase(const std::string &fileName, const std::string &databaseName = "");
+    virtual ~SymbolDatabase();
+
+    virtual bool initialize();
+    virtual bool getInfo(uint64_t addr, std::string &source, uint64_t &line, std::string &function);
+    virtual void getInfoBatch(DebugInfos &infos);
+
+    //The mapping is never written to
+    virtual bool isReentrant() {
+        return m_header != NULL;
+    }
+    virtual bool inited() const {
+        return m_header != NULL;
+    }
+
+    virtual bool getModuleName(std::string &name ) const;
+    virtual uint64_t getImageBase() const;
+    virtual uint64_t getImageSize() const;
+
+    virtual const FunctionEntries &functionRanges();
+
+    const SymbolTables &getTables() const {
+        return m_tables;
+    }
+
+    static bool write(const std::string &path, const SymbolTables &tables,
+                      uint64_t imageBase, uint64_t imageSize,
+                      const std::string &binary);
+};
+
+}
+
+#endif
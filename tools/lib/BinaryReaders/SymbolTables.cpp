@@ -0,0 +1,256 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#include "SymbolTables.h"
+
+#include <algorithm>
+
+namespace s2etools
+{
+
+namespace {
+
+//Upper bound of key in [first, last) when it is likely near first:
+//the range doubles until it contains the bound
+template <class T>
+const T *gallop(const T *first, const T *last, const T &key)
+{
+    size_t step = 1;
+    while ((size_t)(last - first) > step && !(key < first[step])) {
+        first += step;
+        step *= 2;
+    }
+    return std::upper_bound(first, first + std::min(step, (size_t)(last - first)), key);
+}
+
+}
+
+SymbolTables::SymbolTables()
+{
+    sections = NULL;
+    sectionCount = 0;
+    functions = NULL;
+    functionCount = 0;
+    lines = NULL;
+    lineCount = 0;
+    symbols = NULL;
+    symbolCount = 0;
+    stringOffsets = NULL;
+    stringCount = 0;
+    strings = NULL;
+    stringsSize = 0;
+}
+
+const SectionRange *SymbolTables::findSection(uint64_t addr) const
+{
+    SectionRange key;
+    key.start = addr;
+
+    const SectionRange *it = std::upper_bound(sections, sections + sectionCount, key);
+    if (it == sections) {
+        return NULL;
+    }
+    --it;
+    return addr - it->start < it->size ? it : NULL;
+}
+
+//Innermost range that contains addr
+const FunctionRange *SymbolTables::findFunction(uint64_t addr, Sweep *sweep) const
+{
+    FunctionRange key;
+    key.low = addr;
+    key.high = 0;
+
+    const FunctionRange *it;
+    if (sweep && sweep->function) {
+        it = gallop(sweep->function, functions + functionCount, key);
+    } else {
+        it = std::upper_bound(functions, functions + functionCount, key);
+    }
+    if (sweep) {
+        sweep->function = it;
+    }
+    if (it == functions) {
+        return NULL;
+    }
+
+    //Parents always precede their children, which also
+    //bounds the walk on a damaged database
+    uint64_t index = (it - functions) - 1;
+    while (true) {
+        const FunctionRange &f = functions[index];
+        if (addr < f.high) {
+            return &f;
+        }
+        if (f.parent >= index) {
+            return NULL;
+        }
+        index = f.parent;
+    }
+}
+
+//Like BFD, an address belongs to the closest preceding symbol
+//of the same code section
+const SymbolAddress *SymbolTables::findSymbol(uint64_t addr, Sweep *sweep) const
+{
+    const SectionRange *section = findSection(addr);
+    if (!section || !(section->flags & SectionRange::CODE)) {
+        return NULL;
+    }
+
+    SymbolAddress key;
+    key.address = addr;
+    const SymbolAddress *it;
+    if (sweep && sweep->symbol) {
+        it = gallop(sweep->symbol, symbols + symbolCount, key);
+    } else {
+        it = std::upper_bound(symbols, symbols + symbolCount, key);
+    }
+    if (sweep) {
+        sweep->symbol = it;
+    }
+    if (it == symbols) {
+        return NULL;
+    }
+    --it;
+
+    if (it->address < section->start) {
+        return NULL;
+    }
+    return it;
+}
+
+//Last row at or before addr. Sequence ends sort first,
+//so landing on one means addr is in a gap.
+const LineRow *SymbolTables::findLine(uint64_t addr, Sweep *sweep) const
+{
+    LineRow key;
+    key.address = addr;
+
+    const LineRow *it;
+    if (sweep && sweep->line) {
+        it = gallop(sweep->line, lines + lineCount, key);
+    } else {
+        it = std::upper_bound(lines, lines + lineCount, key);
+    }
+    if (sweep) {
+        sweep->line = it;
+    }
+    if (it == lines) {
+        return NULL;
+    }
+    --it;
+    return it->end ? NULL : it;
+}
+
+bool SymbolTables::getInfo(uint64_t addr, std::string &source, uint64_t &line, std::string &function,
+                           Sweep *sweep) const
+{
+    const LineRow *row = findLine(addr, sweep);
+
+    //Like BFD, prefer the symbol table over plain DWARF names
+    //of out-of-line functions
+    uint32_t name = 0;
+    const FunctionRange *f = findFunction(addr, sweep);
+    if (f) {
+        name = f->name;
+    }
+    if (!f || (!f->linkage && !f->inlined) || !name) {
+        const SymbolAddress *s = findSymbol(addr, sweep);
+        if (s) {
+            name = s->name;
+        }
+    }
+
+    if (!row && !name) {
+        return false;
+    }
+
+    const char *file = row ? getString(row->file) : "";
+    source = *file ? file : "<unknown source>";
+    line = row ? row->line : 0;
+    function = name ? getString(name) : "<unknown function>";
+    return true;
+}
+
+void SymbolTables::getInfoBatch(ExecutableFile::DebugInfos &infos) const
+{
+    Sweep sweep;
+    for (unsigned i = 0; i < infos.size(); ++i) {
+        ExecutableFile::DebugInfo &info = infos[i];
+        info.Found = getInfo(info.Address, info.File, info.Line, info.Function, &sweep);
+    }
+}
+
+//The symbols only have a start, they end with their section at the latest
+void SymbolTables::getFunctionRanges(FunctionEntries &functions) const
+{
+    functions.clear();
+    for (uint64_t i = 0; i < functionCount; ++i) {
+        const FunctionRange &f = this->functions[i];
+        if (f.inlined || !f.name) {
+            continue;
+        }
+
+        //Sorted by start and decreasing end, keep the outermost
+        if (!functions.empty() && f.low < functions.back().end) {
+            continue;
+        }
+
+        FunctionEntry e;
+        e.start = f.low;
+        e.end = f.high;
+        e.name = getString(f.name);
+        functions.push_back(e);
+    }
+
+    FunctionEntries entries;
+    for (uint64_t i = 0; i < symbolCount; ++i) {
+        const SectionRange *section = findSection(symbols[i].address);
+        if (!section || !(section->flags & SectionRange::CODE)) {
+            continue;
+        }
+
+        FunctionEntry e;
+        e.start = symbols[i].address;
+        e.end = section->start + section->size;
+        e.name = getString(symbols[i].name);
+        entries.push_back(e);
+    }
+
+    ExecutableFile::mergeFunctionRanges(functions, entries);
+}
+
+}
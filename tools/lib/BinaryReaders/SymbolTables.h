@@ -0,0 +1,176 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#ifndef S2ETOOLS_SYMBOLTABLES_H
+#define S2ETOOLS_SYMBOLTABLES_H
+
+#include "ExecutableFile.h"
+
+#include <string>
+#include <inttypes.h>
+
+namespace s2etools
+{
+
+//The records have a fixed layout: DwarfReader builds them in memory
+//and SymbolDatabase maps them straight from a .s2esym file.
+
+struct LineRow {
+    uint64_t address;
+    uint32_t file;
+    uint32_t line;
+    uint32_t end; //First address after a sequence
+    uint32_t reserved;
+
+    LineRow() : address(0), file(0), line(0), end(0), reserved(0) {}
+
+    bool operator<(const LineRow &r) const {
+        if (address == r.address) {
+            return end && !r.end;
+        }
+        return address < r.address;
+    }
+};
+
+//Inlined subroutines are nested in their caller,
+//parent is the index of the enclosing range
+struct FunctionRange {
+    uint64_t low, high;
+    uint32_t name;
+    uint32_t parent;
+    uint8_t linkage; //The name is mangled
+    uint8_t inlined;
+    uint8_t reserved[6];
+
+    FunctionRange() : low(0), high(0), name(0), parent(~0U), linkage(0), inlined(0) {
+        for (unsigned i = 0; i < sizeof(reserved); ++i) {
+            reserved[i] = 0;
+        }
+    }
+
+    bool operator<(const FunctionRange &r) const {
+        if (low == r.low) {
+            return high > r.high;
+        }
+        return low < r.low;
+    }
+};
+
+struct SymbolAddress {
+    uint64_t address;
+    uint32_t name;
+    uint32_t reserved;
+
+    SymbolAddress() : address(0), name(0), reserved(0) {}
+
+    bool operator<(const SymbolAddress &s) const {
+        return address < s.address;
+    }
+};
+
+//Allocated sections of the image, they do not overlap
+struct SectionRange {
+    enum {
+        CODE = 1,
+        WRITABLE = 2
+    };
+
+    uint64_t start, size;
+    uint32_t name;
+    uint32_t flags;
+
+    SectionRange() : start(0), size(0), name(0), flags(0) {}
+
+    bool operator<(const SectionRange &s) const {
+        return start < s.start;
+    }
+};
+
+/**
+ *  Sorted views of the debug info of a module, wherever they are stored.
+ *  Strings are referenced by index, index 0 is the empty string.
+ *  The pool must end with a null character.
+ */
+struct SymbolTables {
+    //Where the previous lookup landed, for addresses looked up in increasing order
+    struct Sweep {
+        const LineRow *line;
+        const FunctionRange *function;
+        const SymbolAddress *symbol;
+
+        Sweep() : line(NULL), function(NULL), symbol(NULL) {}
+    };
+
+    const SectionRange *sections;
+    uint64_t sectionCount;
+    const FunctionRange *functions;
+    uint64_t functionCount;
+    const LineRow *lines;
+    uint64_t lineCount;
+    const SymbolAddress *symbols;
+    uint64_t symbolCount;
+
+    const uint32_t *stringOffsets;
+    uint64_t stringCount;
+    const char *strings;
+    uint64_t stringsSize;
+
+    SymbolTables();
+
+    const char *getString(uint32_t id) const {
+        if (id >= stringCount || stringOffsets[id] >= stringsSize) {
+            return "";
+        }
+        return strings + stringOffsets[id];
+    }
+
+    const SectionRange *findSection(uint64_t addr) const;
+    const FunctionRange *findFunction(uint64_t addr, Sweep *sweep = NULL) const;
+    const SymbolAddress *findSymbol(uint64_t addr, Sweep *sweep = NULL) const;
+    const LineRow *findLine(uint64_t addr, Sweep *sweep = NULL) const;
+
+    bool getInfo(uint64_t addr, std::string &source, uint64_t &line, std::string &function,
+                 Sweep *sweep = NULL) const;
+
+    //Each search starts where the previous one stopped
+    void getInfoBatch(ExecutableFile::DebugInfos &infos) const;
+
+    //Out-of-line subprograms, completed with the function symbols
+    void getFunctionRanges(FunctionEntries &functions) const;
+};
+
+}
+
+#endif
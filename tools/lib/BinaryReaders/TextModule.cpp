@@ -41,7 +41,8 @@
 
 namespace s2etools {
 
-TextModule::TextModule(const std::string &fileName):ExecutableFile(fileName)
+TextModule::TextModule(const std::string &fileName, const std::string &descriptionFile):
+        ExecutableFile(fileName), m_descriptionFile(descriptionFile)
 {
     m_inited = false;
     m_imageBase = 0;
@@ -59,7 +60,7 @@ bool TextModule::initialize()
         return true;
     }
 
-    if (!parseTextDescription(m_fileName + ".fcn")) {
+    if (!parseTextDescription(m_descriptionFile.empty() ? m_fileName + ".fcn" : m_descriptionFile)) {
         return false;
     }
 
@@ -87,6 +87,7 @@ protected:
     uint64_t m_imageSize;
     std::string m_imageName;
     bool m_inited;
+    std::string m_descriptionFile;
 
     RangeToNameMap m_ObjectNames;
     FunctionNameToAddressesMap m_Functions;
@@ -95,7 +96,8 @@ protected:
     bool parseTextDescription(const std::string &fileName);
 
 public:
-    TextModule(const std::string &fileName);
+    //Reads <fileName>.fcn if descriptionFile is empty
+    TextModule(const std::string &fileName, const std::string &descriptionFile = "");
     virtual ~TextModule();
 
     virtual bool initialize();
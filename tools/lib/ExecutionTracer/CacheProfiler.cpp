@@ -54,6 +54,23 @@ CacheProfiler::~CacheProfiler()
     m_connection.disconnect();
 }
 
+void CacheProfiler::loadParameters(LogParser *parser)
+{
+    s2e::plugins::ExecutionTraceItemHeader hdr;
+    void *data;
+
+    for (unsigned i = 0; i < parser->getItemCount(); ++i) {
+        if (!parser->getItem(i, hdr, &data) || hdr.type != s2e::plugins::TRACE_CACHESIM) {
+            continue;
+        }
+
+        ExecutionTraceCache *cacheItem = (ExecutionTraceCache*)data;
+        if (cacheItem->type != s2e::plugins::CACHE_ENTRY) {
+            onItem(i, hdr, data);
+        }
+    }
+}
+
 void CacheProfiler::onItem(unsigned traceIndex,
         const s2e::plugins::ExecutionTraceItemHeader &hdr,
         void *item)
@@ -127,6 +144,36 @@ ItemProcessorState *CacheProfilerState::clone() const
     return new CacheProfilerState(*this);
 }
 
+//Unlike serialize(), also covers the per-instruction statistics
+uint64_t CacheProfilerState::getMemoryUsage() const
+{
+    uint64_t bytes = sizeof(*this) + getNodeMemory(m_cacheStats) + getNodeMemory(m_perInstructionStats);
+    InstructionCacheStats::const_iterator it;
+    for (it = m_perInstructionStats.begin(); it != m_perInstructionStats.end(); ++it) {
+        bytes += getNodeMemory((*it).second);
+    }
+    return bytes;
+}
+
+//Only the global statistics are maintained for now.
+//The per-cache maps are keyed by Cache pointers, which do not survive a snapshot.
+bool CacheProfilerState::serialize(std::ostream &os) const
+{
+    if (!m_perInstructionStats.empty() || !m_cacheStats.empty()) {
+        return false;
+    }
+
+    writeValue(os, m_globalStats.readMissCount);
+    writeValue(os, m_globalStats.writeMissCount);
+    return os.good();
+}
+
+bool CacheProfilerState::deserialize(std::istream &is)
+{
+    return readValue(is, m_globalStats.readMissCount) &&
+           readValue(is, m_globalStats.writeMissCount);
+}
+
 void CacheProfilerState::processCacheItem(CacheProfiler *cp,
                       const s2e::plugins::ExecutionTraceItemHeader &hdr,
                       const s2e::plugins::ExecutionTraceCacheSimEntry &e)
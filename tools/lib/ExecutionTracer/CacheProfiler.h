@@ -64,6 +64,10 @@ public:
 
     ~CacheProfiler();
 
+    //Reads the cache descriptions from the whole trace.
+    //They are in segments that are not replayed when resuming from a snapshot.
+    void loadParameters(LogParser *parser);
+
     friend class CacheProfilerState;
 };
 
@@ -116,6 +120,9 @@ public:
 
     static ItemProcessorState *factory();
     virtual ItemProcessorState *clone() const;
+    virtual bool serialize(std::ostream &os) const;
+    virtual bool deserialize(std::istream &is);
+    virtual uint64_t getMemoryUsage() const;
 
     void processCacheItem(CacheProfiler *cp,
                           const s2e::plugins::ExecutionTraceItemHeader &hdr,
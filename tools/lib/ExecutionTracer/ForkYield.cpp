@@ -0,0 +1,264 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#include <algorithm>
+#include <stack>
+#include <cassert>
+
+#include "ForkYield.h"
+#include "Path.h"
+
+using namespace s2e::plugins;
+
+namespace s2etools
+{
+
+namespace {
+
+struct ForkSiteCostCmp
+{
+    bool operator()(const ForkSiteYield *s1, const ForkSiteYield *s2) const {
+        uint64_t u1 = s1->getUsefulOutcomes(), u2 = s2->getUsefulOutcomes();
+        if ((u1 == 0) != (u2 == 0)) {
+            return u1 == 0;
+        }
+
+        if (u1 == 0) {
+            return s1->getCost() > s2->getCost();
+        }
+
+        double r1 = (double) s1->getCost() / u1;
+        double r2 = (double) s2->getCost() / u2;
+        if (r1 != r2) {
+            return r1 > r2;
+        }
+        return s1->pc < s2->pc;
+    }
+};
+
+}
+
+ForkYield::ForkYield(LogParser *parser, PathBuilder *pb)
+{
+    m_Parser = parser;
+    m_Builder = pb;
+}
+
+//Collects the cost of the segment itself. y.endICount must be
+//initialized with the instruction count at the start of the segment.
+void ForkYield::scanSegment(const PathSegment *seg, SegmentYield &y, FirstBlocks &firstBlocks)
+{
+    const PathFragmentList &fra = seg->getFragmentList();
+    PathFragmentList::const_iterator it;
+    ExecutionTraceItemHeader hdr;
+    void *data;
+
+    uint64_t startICount = y.endICount;
+
+    for (it = fra.begin(); it != fra.end(); ++it) {
+        uint64_t firstTime = 0;
+
+        for (uint32_t s = (*it).startIndex; s <= (*it).endIndex; ++s) {
+            if (!m_Parser->getItem(s, hdr, &data)) {
+                assert(false && "Trace is broken");
+            }
+
+            if (s == (*it).startIndex) {
+                firstTime = hdr.timeStamp;
+            }
+
+            if (hdr.type == TRACE_TB_START) {
+                const ExecutionTraceTb *te = static_cast<ExecutionTraceTb*>(data);
+                ++y.blocks;
+
+                SiteKey block(hdr.pid, te->pc);
+                FirstBlocks::iterator fit = firstBlocks.find(block);
+                if (fit == firstBlocks.end() || hdr.timeStamp < (*fit).second.first) {
+                    firstBlocks[block] = std::make_pair(hdr.timeStamp, seg);
+                }
+            } else if (hdr.type == TRACE_ICOUNT) {
+                const ExecutionTraceICount *te = static_cast<ExecutionTraceICount*>(data);
+                if (te->count > y.endICount) {
+                    y.endICount = te->count;
+                }
+            } else if (hdr.type == TRACE_TESTCASE) {
+                y.hasTestCase = true;
+            }
+        }
+
+        //Other states run between the fragments
+        y.time += hdr.timeStamp - firstTime;
+    }
+
+    y.instructions = y.endICount - startICount;
+}
+
+//Forks are the last items of their segment
+bool ForkYield::getFork(const PathSegment *seg, SiteKey &site) const
+{
+    const PathFragmentList &fra = seg->getFragmentList();
+    if (seg->getChildren().empty() || fra.empty()) {
+        return false;
+    }
+
+    ExecutionTraceItemHeader hdr;
+    void *data;
+    if (!m_Parser->getItem(fra.back().endIndex, hdr, &data) || hdr.type != TRACE_FORK) {
+        return false;
+    }
+
+    site = SiteKey(hdr.pid, static_cast<ExecutionTraceFork*>(data)->pc);
+    return true;
+}
+
+void ForkYield::compute()
+{
+    SegmentYields yields;
+    FirstBlocks firstBlocks;
+    const PathSegment *root = m_Builder->getRoot();
+
+    m_Sites.clear();
+
+    //Costs of each segment, parents first for the instruction counts
+    std::stack<const PathSegment*> s;
+    s.push(root);
+    while (!s.empty()) {
+        const PathSegment *seg = s.top();
+        s.pop();
+
+        SegmentYield y;
+        y.endICount = seg->getParent() ? yields[seg->getParent()].endICount : 0;
+        y.instructions = y.blocks = y.time = y.newBlocks = 0;
+        y.leaves = y.testCases = 0;
+        y.hasTestCase = false;
+        scanSegment(seg, y, firstBlocks);
+        yields[seg] = y;
+
+        const PathSegmentList &children = seg->getChildren();
+        PathSegmentList::const_iterator it;
+        for (it = children.begin(); it != children.end(); ++it) {
+            s.push(*it);
+        }
+    }
+
+    FirstBlocks::const_iterator fit;
+    for (fit = firstBlocks.begin(); fit != firstBlocks.end(); ++fit) {
+        ++yields[(*fit).second.second].newBlocks;
+    }
+
+    //Subtree totals. Forks of a site nested below another
+    //fork of the same site are already accounted for.
+    std::map<SiteKey, unsigned> active;
+    std::stack<std::pair<const PathSegment*, bool> > ps;
+    ps.push(std::make_pair(root, false));
+
+    while (!ps.empty()) {
+        const PathSegment *seg = ps.top().first;
+        const PathSegmentList &children = seg->getChildren();
+        SiteKey site;
+        bool isFork = getFork(seg, site);
+
+        if (!ps.top().second) {
+            ps.top().second = true;
+            if (isFork) {
+                ++active[site];
+                ++m_Sites[site].forks;
+            }
+
+            PathSegmentList::const_iterator it;
+            for (it = children.begin(); it != children.end(); ++it) {
+                ps.push(std::make_pair(*it, false));
+            }
+            continue;
+        }
+
+        ps.pop();
+
+        SegmentYield &y = yields[seg];
+        if (children.empty()) {
+            y.leaves = 1;
+            y.testCases = y.hasTestCase ? 1 : 0;
+            continue;
+        }
+
+        ForkSiteYield below;
+        PathSegmentList::const_iterator it;
+        for (it = children.begin(); it != children.end(); ++it) {
+            const SegmentYield &cy = yields[*it];
+            below.instructions += cy.instructions;
+            below.blocks += cy.blocks;
+            below.time += cy.time;
+            below.leaves += cy.leaves;
+            below.testCases += cy.testCases;
+            below.newBlocks += cy.newBlocks;
+        }
+
+        if (isFork) {
+            if (active[site] == 1) {
+                ForkSiteYield &f = m_Sites[site];
+                f.pid = site.first;
+                f.pc = site.second;
+                f.instructions += below.instructions;
+                f.blocks += below.blocks;
+                f.time += below.time;
+                f.leaves += below.leaves;
+                f.testCases += below.testCases;
+                f.newBlocks += below.newBlocks;
+            }
+            --active[site];
+        }
+
+        y.instructions += below.instructions;
+        y.blocks += below.blocks;
+        y.time += below.time;
+        y.leaves += below.leaves;
+        y.testCases += below.testCases;
+        y.newBlocks += below.newBlocks;
+    }
+}
+
+void ForkYield::getRanking(Ranking &ranking) const
+{
+    ranking.clear();
+
+    Sites::const_iterator it;
+    for (it = m_Sites.begin(); it != m_Sites.end(); ++it) {
+        ranking.push_back(&(*it).second);
+    }
+
+    std::sort(ranking.begin(), ranking.end(), ForkSiteCostCmp());
+}
+
+}
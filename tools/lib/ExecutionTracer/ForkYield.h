@@ -0,0 +1,141 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#ifndef S2ETOOLS_EXECTRACER_FORKYIELD_H
+#define S2ETOOLS_EXECTRACER_FORKYIELD_H
+
+#include <inttypes.h>
+#include <vector>
+#include <map>
+
+#include "LogParser.h"
+
+namespace s2etools
+{
+
+class PathBuilder;
+class PathSegment;
+
+/**
+ *  Work done under the forks of one program counter,
+ *  and what it produced.
+ */
+struct ForkSiteYield
+{
+    uint64_t pid, pc;
+
+    //Number of fork instances at this site
+    uint64_t forks;
+
+    //Totals over the subtrees of the outermost instances
+    uint64_t instructions;
+    uint64_t blocks;
+    uint64_t time;
+    uint64_t leaves;
+    uint64_t testCases;
+    uint64_t newBlocks;
+
+    ForkSiteYield() {
+        pid = pc = 0;
+        forks = 0;
+        instructions = blocks = time = 0;
+        leaves = testCases = newBlocks = 0;
+    }
+
+    uint64_t getUsefulOutcomes() const {
+        return testCases + newBlocks;
+    }
+
+    //Instructions if the trace has them, translation blocks otherwise
+    uint64_t getCost() const {
+        return instructions ? instructions : blocks;
+    }
+};
+
+/**
+ *  Aggregates, for each fork site, the cost of the subtrees below its
+ *  forks (instructions, translation blocks, time) and their yield
+ *  (test cases, basic blocks covered for the first time in the run).
+ *  Nested forks at the same site are only counted once.
+ */
+class ForkYield
+{
+public:
+    //(pid, pc)
+    typedef std::pair<uint64_t, uint64_t> SiteKey;
+    typedef std::map<SiteKey, ForkSiteYield> Sites;
+    typedef std::vector<const ForkSiteYield*> Ranking;
+
+private:
+    struct SegmentYield {
+        uint64_t endICount;
+        uint64_t instructions;
+        uint64_t blocks;
+        uint64_t time;
+        uint64_t newBlocks;
+        uint64_t leaves;
+        uint64_t testCases;
+        bool hasTestCase;
+    };
+
+    typedef std::map<const PathSegment*, SegmentYield> SegmentYields;
+
+    //Earliest execution of each (pid, pc) block
+    typedef std::map<SiteKey, std::pair<uint64_t, const PathSegment*> > FirstBlocks;
+
+    LogParser *m_Parser;
+    PathBuilder *m_Builder;
+    Sites m_Sites;
+
+    void scanSegment(const PathSegment *seg, SegmentYield &y, FirstBlocks &firstBlocks);
+    bool getFork(const PathSegment *seg, SiteKey &site) const;
+
+public:
+    ForkYield(LogParser *parser, PathBuilder *pb);
+
+    void compute();
+
+    const Sites &getSites() const {
+        return m_Sites;
+    }
+
+    //Highest cost per useful outcome first. Sites that produced
+    //nothing come first, by decreasing cost.
+    void getRanking(Ranking &ranking) const;
+};
+
+}
+
+#endif
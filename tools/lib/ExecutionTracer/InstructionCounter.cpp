@@ -99,4 +99,15 @@ ItemProcessorState *InstructionCounterState::clone() const
     return new InstructionCounterState(*this);
 }
 
+bool InstructionCounterState::serialize(std::ostream &os) const
+{
+    writeValue(os, m_icount);
+    return os.good();
+}
+
+bool InstructionCounterState::deserialize(std::istream &is)
+{
+    return readValue(is, m_icount);
+}
+
 }
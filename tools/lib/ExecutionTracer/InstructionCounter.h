@@ -71,7 +71,11 @@ public:
 
     static ItemProcessorState *factory();
     virtual ItemProcessorState *clone() const;
-
+    virtual bool serialize(std::ostream &os) const;
+    virtual bool deserialize(std::istream &is);
+    virtual uint64_t getMemoryUsage() const {
+        return sizeof(*this);
+    }
 
 
     void printCounter(std::ostream &os);
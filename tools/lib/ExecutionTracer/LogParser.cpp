@@ -182,6 +182,7 @@ bool LogParser::parse(const std::string &fileName)
 
     uint64_t currentOffset = 0;
     unsigned currentItem = m_ItemAddresses.size();
+    m_TraceFirstItems.push_back(currentItem);
 
     uint8_t *buffer = (uint8_t*)element.m_File;
 
@@ -241,6 +242,19 @@ bool LogParser::getItem(unsigned index, s2e::plugins::ExecutionTraceItemHeader &
     return true;
 }
 
+//Items of each trace file are numbered contiguously, in the order
+//in which the files were parsed.
+void LogParser::getTraceItems(unsigned trace, unsigned &first, unsigned &count) const
+{
+    assert(trace < m_TraceFirstItems.size());
+    first = m_TraceFirstItems[trace];
+    if (trace + 1 < m_TraceFirstItems.size()) {
+        count = m_TraceFirstItems[trace + 1] - first;
+    } else {
+        count = m_ItemAddresses.size() - first;
+    }
+}
+
 ItemProcessorState* LogParser::getState(void *processor, ItemProcessorStateFactory f)
 {
     if (processor == m_cachedProcessor) {
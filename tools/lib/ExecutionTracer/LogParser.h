@@ -43,6 +43,8 @@
 #include <vector>
 #include <map>
 #include <set>
+#include <istream>
+#include <ostream>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -61,8 +63,68 @@ class ItemProcessorState
 public:
     virtual ~ItemProcessorState() {};
     virtual ItemProcessorState *clone() const = 0;
+
+    //Binary form of the state, used by PathBuilder snapshots.
+    //States that cannot be saved return false.
+    virtual bool serialize(std::ostream &os) const {
+        return false;
+    }
+
+    //Reads back what serialize() wrote into a freshly created state
+    virtual bool deserialize(std::istream &is) {
+        return false;
+    }
+
+    //Bytes held by the state, for the memory accounting of PathBuilder.
+    //0 if unknown, the size of the serialized state is used instead.
+    virtual uint64_t getMemoryUsage() const {
+        return 0;
+    }
 };
 
+//Approximate footprint of the elements of a std::set or std::map,
+//each node has three links and a color besides the value
+template <typename C>
+inline uint64_t getNodeMemory(const C &c)
+{
+    return c.size() * (sizeof(typename C::value_type) + 4 * sizeof(void*));
+}
+
+//Helpers for the binary formats written by the tools.
+//Values are stored in host byte order.
+template <typename T>
+inline void writeValue(std::ostream &os, const T &v)
+{
+    os.write((const char*)&v, sizeof(v));
+}
+
+template <typename T>
+inline bool readValue(std::istream &is, T &v)
+{
+    return (bool)is.read((char*)&v, sizeof(v));
+}
+
+inline void writeString(std::ostream &os, const std::string &s)
+{
+    uint32_t size = s.size();
+    os.write((const char*)&size, sizeof(size));
+    os.write(s.data(), size);
+}
+
+inline bool readString(std::istream &is, std::string &s)
+{
+    uint32_t size;
+    if (!is.read((char*)&size, sizeof(size))) {
+        return false;
+    }
+
+    s.resize(size);
+    if (size > 0) {
+        is.read(&s[0], size);
+    }
+    return is.good();
+}
+
 //opaque references the registered trace processor
 typedef std::map<void *, ItemProcessorState*> ItemProcessors;
 typedef std::set<uint32_t> PathSet;
@@ -82,6 +144,12 @@ public:
     virtual ItemProcessorState* getState(void *processor, uint32_t pathId) = 0;
     virtual void getPaths(PathSet &s) = 0;
 
+    //Maps the state id of the item at traceIndex to an id that is unique
+    //across all the traces being processed.
+    virtual uint32_t getGlobalStateId(unsigned traceIndex, uint32_t stateId) const {
+        return stateId;
+    }
+
 protected:
     virtual void processItem(unsigned itemEntry,
                              const s2e::plugins::ExecutionTraceItemHeader &hdr,
@@ -121,6 +189,9 @@ private:
     LogFiles m_files;
     std::vector<uint8_t*> m_ItemAddresses;
 
+    //Index of the first item of each trace file
+    std::vector<unsigned> m_TraceFirstItems;
+
     ItemProcessors m_ItemProcessors;
     void *m_cachedProcessor;
     ItemProcessorState* m_cachedState;
@@ -136,6 +207,16 @@ public:
     bool parse(const std::string &file);
     bool getItem(unsigned index, s2e::plugins::ExecutionTraceItemHeader &hdr, void **data);
 
+    unsigned getItemCount() const {
+        return m_ItemAddresses.size();
+    }
+
+    unsigned getTraceCount() const {
+        return m_TraceFirstItems.size();
+    }
+
+    void getTraceItems(unsigned trace, unsigned &first, unsigned &count) const;
+
     virtual ItemProcessorState* getState(void *processor, ItemProcessorStateFactory f);
     virtual ItemProcessorState* getState(void *processor, uint32_t pathId);
     virtual void getPaths(PathSet &s);
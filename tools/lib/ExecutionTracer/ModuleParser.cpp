@@ -43,6 +43,7 @@
 
 #include <stdio.h>
 #include <inttypes.h>
+#include <algorithm>
 #include <string>
 #include <sstream>
 #include <iostream>
@@ -53,20 +54,77 @@ namespace s2etools {
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 
+const ModuleId ModuleNames::NoModule;
+
+ModuleNames::ModuleNames()
+{
+    m_Names.push_back("");
+    m_Ids[""] = NoModule;
+    pthread_mutex_init(&m_Lock, NULL);
+}
+
+ModuleNames &ModuleNames::get()
+{
+    static ModuleNames names;
+    return names;
+}
+
+ModuleId ModuleNames::intern(const std::string &name)
+{
+    ModuleNames &names = get();
+    pthread_mutex_lock(&names.m_Lock);
+    NameToId::iterator it = names.m_Ids.find(name);
+    if (it != names.m_Ids.end()) {
+        ModuleId id = (*it).second;
+        pthread_mutex_unlock(&names.m_Lock);
+        return id;
+    }
+
+    ModuleId id = names.m_Names.size();
+    names.m_Names.push_back(name);
+    names.m_Ids[name] = id;
+    pthread_mutex_unlock(&names.m_Lock);
+    return id;
+}
+
+bool ModuleNames::find(const std::string &name, ModuleId &id)
+{
+    ModuleNames &names = get();
+    pthread_mutex_lock(&names.m_Lock);
+    NameToId::const_iterator it = names.m_Ids.find(name);
+    bool found = it != names.m_Ids.end();
+    if (found) {
+        id = (*it).second;
+    }
+    pthread_mutex_unlock(&names.m_Lock);
+    return found;
+}
+
+const std::string &ModuleNames::getName(ModuleId id)
+{
+    //Growing the deque may move its index, not the strings
+    ModuleNames &names = get();
+    pthread_mutex_lock(&names.m_Lock);
+    assert(id < names.m_Names.size());
+    const std::string &name = names.m_Names[id];
+    pthread_mutex_unlock(&names.m_Lock);
+    return name;
+}
+
 ModuleInstance::ModuleInstance(
         const std::string &name, uint64_t pid, uint64_t loadBase, uint64_t size, uint64_t imageBase)
 {
     LoadBase = loadBase;
     ImageBase = imageBase;
     Size = size;
-    Name = name;
+    Id = ModuleNames::intern(name);
     //xxx: fix this
     Pid = pid;
 }
 
 void ModuleInstance::print(std::ostream &os) const
 {
-    os << "Instance of " << Name <<
+    os << "Instance of " << getName() <<
             " Pid=0x" << std::hex << Pid <<
             " LoadBase=0x" << LoadBase << std::endl;
 }
@@ -107,7 +165,8 @@ void ModuleCache::onItem(unsigned traceIndex,
             //std::cout << "Could not load driver " << load.name << std::endl;
         }
     }else if (hdr.type == s2e::plugins::TRACE_PROC_UNLOAD) {
-        std::cerr << "Process unloading not implemented" << std::endl;
+        ModuleCacheState *state = static_cast<ModuleCacheState*>(m_events->getState(this, &ModuleCacheState::factory));
+        state->unloadProcess(hdr.pid);
     }else {
         return;
     }
@@ -123,13 +182,78 @@ const ModuleInstance *ModuleCacheState::getInstance(uint64_t pid, uint64_t pc) c
 {
     pid = Library::translatePid(pid, pc);
 
-    ModuleInstance mi("", pid, pc, 1, 0);
-    ModuleInstanceSet::const_iterator it = m_Instances.find(&mi);
-    if (it == m_Instances.end()) {
+    const ModuleTable *table = m_LastTable;
+    if (!table || m_LastPid != pid) {
+        ModuleTables::const_iterator tit = m_Tables.find(pid);
+        if (tit == m_Tables.end()) {
+            return NULL;
+        }
+        table = &(*tit).second;
+        m_LastPid = pid;
+        m_LastTable = table;
+    }
+
+    //Most of the time we stay in the same module
+    const ModuleInterval *last = table->LastHit;
+    if (last && pc >= last->Start && pc < last->End) {
+        return last->Instance;
+    }
+
+    const std::vector<ModuleInterval> &intervals = table->Intervals;
+    ModuleInterval key;
+    key.Start = pc;
+
+    //First module that starts after pc, the candidate is the one before
+    std::vector<ModuleInterval>::const_iterator it =
+            std::upper_bound(intervals.begin(), intervals.end(), key);
+    if (it == intervals.begin()) {
         return NULL;
     }
+    --it;
+
+    if (pc >= (*it).End) {
+        return NULL;
+    }
+
+    table->LastHit = &*it;
+    return (*it).Instance;
+}
+
+void ModuleCacheState::addInstance(ModuleInstance *mi)
+{
+    ModuleTable &table = m_Tables[mi->Pid];
+    if (!table.Instances.insert(mi).second) {
+        delete mi;
+        return;
+    }
+
+    ModuleInterval interval;
+    interval.Start = mi->LoadBase;
+    interval.End = mi->LoadBase + mi->Size;
+    interval.Instance = mi;
+
+    //Insertion may reallocate the vector, drop the pointers into it
+    table.Intervals.insert(std::upper_bound(table.Intervals.begin(), table.Intervals.end(), interval),
+                           interval);
+    table.LastHit = NULL;
+    m_LastTable = NULL;
+}
+
+void ModuleCacheState::removeInstance(ModuleTable &table, ModuleInstanceSet::iterator it)
+{
+    const ModuleInstance *mi = *it;
+
+    std::vector<ModuleInterval>::iterator iit;
+    for (iit = table.Intervals.begin(); iit != table.Intervals.end(); ++iit) {
+        if ((*iit).Instance == mi) {
+            table.Intervals.erase(iit);
+            break;
+        }
+    }
+    table.LastHit = NULL;
+    m_LastTable = NULL;
 
-    return (*it);
+    table.Instances.erase(it);
 }
 
 
@@ -141,14 +265,15 @@ bool ModuleCacheState::loadModule(const std::string &name, uint64_t pid, uint64_
     pid = Library::translatePid(pid, loadBase);
 
     ModuleInstance *mi = new ModuleInstance(name, pid, loadBase, size, imageBase);
-    ModuleInstanceSet::iterator it = m_Instances.find(mi);
-    if (it != m_Instances.end()) {
+    ModuleTable &table = m_Tables[pid];
+    ModuleInstanceSet::iterator it = table.Instances.find(mi);
+    if (it != table.Instances.end()) {
         ModuleInstance *found = *it;
         std::cout << "Warning: Module already loaded (Linux exec?)\n";
-        m_Instances.erase(it);
+        removeInstance(table, it);
         delete found;
     }
-    m_Instances.insert(mi);
+    addInstance(mi);
     return true;
 }
 
@@ -160,10 +285,42 @@ bool ModuleCacheState::unloadModule(uint64_t pid, uint64_t loadBase)
     pid = Library::translatePid(pid, loadBase);
     ModuleInstance mi("", pid, loadBase, 1, 0);
 
+    ModuleTables::iterator tit = m_Tables.find(pid);
+    if (tit == m_Tables.end()) {
+        return false;
+    }
+
     //Sometimes we have duplicated items in the trace
     //assert(m_Instances.find(&mi) != m_Instances.end());
 
-    return m_Instances.erase(&mi);
+    ModuleTable &table = (*tit).second;
+    ModuleInstanceSet::iterator it = table.Instances.find(&mi);
+    if (it == table.Instances.end()) {
+        return false;
+    }
+
+    removeInstance(table, it);
+    return true;
+}
+
+//Drops all the user-space modules of a terminated process at once,
+//so that a reused pid does not see stale mappings.
+//Like unloadModule, this does not free the instances, processors
+//may still hold pointers to them.
+bool ModuleCacheState::unloadProcess(uint64_t pid)
+{
+    if (pid == 0) {
+        return false;
+    }
+
+    ModuleTables::iterator tit = m_Tables.find(pid);
+    if (tit == m_Tables.end()) {
+        return false;
+    }
+
+    m_Tables.erase(tit);
+    m_LastTable = NULL;
+    return true;
 }
 
 
@@ -175,7 +332,8 @@ ItemProcessorState *ModuleCacheState::factory()
 
 ModuleCacheState::ModuleCacheState()
 {
-
+    m_LastPid = 0;
+    m_LastTable = NULL;
 }
 
 ModuleCacheState::~ModuleCacheState()
@@ -187,13 +345,87 @@ ItemProcessorState *ModuleCacheState::clone() const
 {
     ModuleCacheState *ret = new ModuleCacheState();
 
-    ModuleInstanceSet::iterator it;
-    for (it = m_Instances.begin(); it != m_Instances.end(); ++it) {
-        ModuleInstance *newInstance = new ModuleInstance(*(*it));
-        ret->m_Instances.insert(newInstance);
+    ModuleTables::const_iterator tit;
+    for (tit = m_Tables.begin(); tit != m_Tables.end(); ++tit) {
+        const ModuleInstanceSet &instances = (*tit).second.Instances;
+        ModuleInstanceSet::const_iterator it;
+        for (it = instances.begin(); it != instances.end(); ++it) {
+            ModuleInstance *newInstance = new ModuleInstance(*(*it));
+            ret->addInstance(newInstance);
+        }
     }
 
     return ret;
 }
 
+void ModuleCacheState::print(std::ostream &os) const
+{
+    ModuleTables::const_iterator tit;
+    for (tit = m_Tables.begin(); tit != m_Tables.end(); ++tit) {
+        const ModuleInstanceSet &instances = (*tit).second.Instances;
+        ModuleInstanceSet::const_iterator it;
+        for (it = instances.begin(); it != instances.end(); ++it) {
+            (*it)->print(os);
+        }
+    }
+}
+
+//Pids are stored already translated
+uint64_t ModuleCacheState::getMemoryUsage() const
+{
+    uint64_t bytes = sizeof(*this) + getNodeMemory(m_Tables);
+    ModuleTables::const_iterator tit;
+    for (tit = m_Tables.begin(); tit != m_Tables.end(); ++tit) {
+        const ModuleTable &table = (*tit).second;
+        bytes += getNodeMemory(table.Instances);
+        bytes += table.Instances.size() * sizeof(ModuleInstance);
+        bytes += table.Intervals.capacity() * sizeof(ModuleInterval);
+    }
+    return bytes;
+}
+
+bool ModuleCacheState::serialize(std::ostream &os) const
+{
+    uint32_t count = 0;
+    ModuleTables::const_iterator tit;
+    for (tit = m_Tables.begin(); tit != m_Tables.end(); ++tit) {
+        count += (*tit).second.Instances.size();
+    }
+    writeValue(os, count);
+
+    for (tit = m_Tables.begin(); tit != m_Tables.end(); ++tit) {
+        const ModuleInstanceSet &instances = (*tit).second.Instances;
+        ModuleInstanceSet::const_iterator it;
+        for (it = instances.begin(); it != instances.end(); ++it) {
+            const ModuleInstance *mi = *it;
+            writeString(os, mi->getName());
+            writeValue(os, mi->Pid);
+            writeValue(os, mi->LoadBase);
+            writeValue(os, mi->ImageBase);
+            writeValue(os, mi->Size);
+        }
+    }
+    return os.good();
+}
+
+bool ModuleCacheState::deserialize(std::istream &is)
+{
+    uint32_t count;
+    if (!readValue(is, count)) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        std::string name;
+        uint64_t pid, loadBase, imageBase, size;
+        if (!readString(is, name) || !readValue(is, pid) || !readValue(is, loadBase) ||
+            !readValue(is, imageBase) || !readValue(is, size)) {
+            return false;
+        }
+
+        addInstance(new ModuleInstance(name, pid, loadBase, size, imageBase));
+    }
+    return true;
+}
+
 }
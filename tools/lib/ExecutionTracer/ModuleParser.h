@@ -39,22 +39,50 @@
 #include <string>
 #include <map>
 #include <set>
+#include <vector>
+#include <deque>
 #include <inttypes.h>
 #include <ostream>
 #include <cassert>
+#include <pthread.h>
 
 #include "LogParser.h"
 
 namespace s2etools
 {
 
+typedef uint32_t ModuleId;
+
+//Global table of module names. Module identity is a small integer
+//everywhere, names are only needed to display results.
+class ModuleNames
+{
+private:
+    typedef std::map<std::string, ModuleId> NameToId;
+
+    NameToId m_Ids;
+    std::deque<std::string> m_Names; //Stable references on growth
+    pthread_mutex_t m_Lock; //Symbolization may run on several threads
+
+    ModuleNames();
+    static ModuleNames &get();
+
+public:
+    //Id of the empty name, used for unknown modules
+    static const ModuleId NoModule = 0;
+
+    static ModuleId intern(const std::string &name);
+    static bool find(const std::string &name, ModuleId &id);
+    static const std::string &getName(ModuleId id);
+};
+
 struct ModuleInstance
 {
     uint64_t Pid;
     uint64_t LoadBase;
     uint64_t ImageBase;
     uint64_t Size; //Used only for lookup
-    std::string Name;
+    ModuleId Id;
 
     ModuleInstance(
             const std::string &name, uint64_t pid, uint64_t loadBase, uint64_t size, uint64_t imageBase);
@@ -66,6 +94,10 @@ struct ModuleInstance
         return Pid < s.Pid;
     }
 
+    const std::string &getName() const {
+        return ModuleNames::getName(Id);
+    }
+
     void print(std::ostream &os) const;
 };
 
@@ -98,19 +130,52 @@ public:
 class ModuleCacheState: public ItemProcessorState
 {
 private:
-    ModuleInstanceSet m_Instances;
+    //[Start, End) range of a loaded module
+    struct ModuleInterval {
+        uint64_t Start, End;
+        const ModuleInstance *Instance;
+
+        bool operator<(const ModuleInterval &s) const {
+            return Start < s.Start;
+        }
+    };
+
+    //Modules of one address space. Intervals mirrors Instances sorted
+    //by load base, LastHit makes consecutive lookups in the same module cheap.
+    struct ModuleTable {
+        ModuleInstanceSet Instances;
+        std::vector<ModuleInterval> Intervals;
+        mutable const ModuleInterval *LastHit;
+
+        ModuleTable() : LastHit(NULL) {}
+    };
+
+    typedef std::map<uint64_t, ModuleTable> ModuleTables;
+
+    //Kernel modules are shared by all processes and stored with pid 0
+    ModuleTables m_Tables;
+    mutable uint64_t m_LastPid;
+    mutable const ModuleTable *m_LastTable;
+
+    void addInstance(ModuleInstance *mi);
+    void removeInstance(ModuleTable &table, ModuleInstanceSet::iterator it);
 
 public:
     static ItemProcessorState *factory();
     ModuleCacheState();
     virtual ~ModuleCacheState();
     virtual ItemProcessorState *clone() const;
+    virtual bool serialize(std::ostream &os) const;
+    virtual bool deserialize(std::istream &is);
+    virtual uint64_t getMemoryUsage() const;
 
     bool loadModule(const std::string &name, uint64_t pid, uint64_t loadBase,
                     uint64_t imageBase, uint64_t size);
     bool unloadModule(uint64_t pid, uint64_t loadBase);
+    bool unloadProcess(uint64_t pid);
 
     const ModuleInstance *getInstance(uint64_t pid, uint64_t pc) const;
+    void print(std::ostream &os) const;
 
     friend class ModuleCache;
 };
@@ -67,7 +67,7 @@ void PageFault::onItem(unsigned traceIndex,
         if (m_trackModule) {
             ModuleCacheState *mcs = static_cast<ModuleCacheState*>(m_events->getState(m_mc, &ModuleCacheState::factory));
             const ModuleInstance *mi = mcs->getInstance(hdr.pid, pageFault->pc);
-            if (!mi || mi->Name != m_module) {
+            if (!mi || mi->Id != m_module) {
                 return;
             }
             state->m_totalPageFaults++;
@@ -83,7 +83,7 @@ void PageFault::onItem(unsigned traceIndex,
         if (m_trackModule) {
             ModuleCacheState *mcs = static_cast<ModuleCacheState*>(m_events->getState(m_mc, &ModuleCacheState::factory));
             const ModuleInstance *mi = mcs->getInstance(hdr.pid, tlbMiss->pc);
-            if (!mi || mi->Name != m_module) {
+            if (!mi || mi->Id != m_module) {
                 return;
             }
             state->m_totalTlbMisses++;
@@ -114,5 +114,17 @@ ItemProcessorState *PageFaultState::clone() const
     return new PageFaultState(*this);
 }
 
+bool PageFaultState::serialize(std::ostream &os) const
+{
+    writeValue(os, m_totalPageFaults);
+    writeValue(os, m_totalTlbMisses);
+    return os.good();
+}
+
+bool PageFaultState::deserialize(std::istream &is)
+{
+    return readValue(is, m_totalPageFaults) && readValue(is, m_totalTlbMisses);
+}
+
 
 }
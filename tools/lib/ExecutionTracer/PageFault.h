@@ -55,14 +55,14 @@ private:
     LogEvents *m_events;
 
     bool m_trackModule;
-    std::string m_module;
+    ModuleId m_module;
 
 public:
     PageFault(LogEvents *events, ModuleCache *mc);
     ~PageFault();
 
     void setModule(const std::string &s) {
-        m_module = s;
+        m_module = ModuleNames::intern(s);
         m_trackModule = true;
     }
 
@@ -81,6 +81,11 @@ public:
     PageFaultState();
     virtual ~PageFaultState();
     virtual ItemProcessorState *clone() const;
+    virtual bool serialize(std::ostream &os) const;
+    virtual bool deserialize(std::istream &is);
+    virtual uint64_t getMemoryUsage() const {
+        return sizeof(*this);
+    }
     friend class PageFault;
 
     uint64_t getPageFaults() const {
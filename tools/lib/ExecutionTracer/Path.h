@@ -39,8 +39,13 @@
 
 #include <vector>
 #include <map>
+#include <deque>
+#include <ostream>
+#include <sstream>
+#include <fstream>
 
 #include "LogParser.h"
+#include "SuccinctTree.h"
 
 namespace s2etools
 {
@@ -70,6 +75,17 @@ class PathSegment;
 typedef std::vector<PathSegment *>PathSegmentList;
 typedef std::map<void *, ItemProcessorState*> PathSegmentStateMap;
 
+/**
+ *  Brings back into memory the states of a segment
+ *  that were spilled to disk.
+ */
+class PathStateLoader
+{
+public:
+    virtual ~PathStateLoader() {}
+    virtual void reloadState(PathSegment *seg) = 0;
+};
+
 /**
  *  A path segment is a sequence of fragments terminated by a fork point
  */
@@ -87,14 +103,27 @@ private:
 
     /** Holds the per-trace processor state */
     PathSegmentStateMap m_SegmentState;
+
+    /** Set while the state is spilled to disk */
+    PathStateLoader *m_Loader;
 public:
     PathSegment(PathSegment *parent, uint32_t stateId, uint64_t forkPc);
     uint32_t getStateId() const {
         return m_StateId;
     }
 
+    void setStateId(uint32_t stateId) {
+        m_StateId = stateId;
+    }
+
+    uint64_t getForkPc() const {
+        return m_ForkPc;
+    }
+
     ~PathSegment();
 
+    void merge(PathSegment *seg);
+
     void deleteState();
 
     void appendFragment(const PathFragment &f) {
@@ -118,10 +147,30 @@ public:
         return m_Children;
     }
 
+    //Spilled states are reloaded on access
     PathSegmentStateMap& getStateMap() {
+        if (m_Loader) {
+            m_Loader->reloadState(this);
+        }
+        return m_SegmentState;
+    }
+
+    const PathSegmentStateMap& getStateMap() const {
+        if (m_Loader) {
+            m_Loader->reloadState(const_cast<PathSegment*>(this));
+        }
         return m_SegmentState;
     }
 
+    bool isSpilled() const {
+        return m_Loader != NULL;
+    }
+
+    //The state map must be empty
+    void setSpilled(PathStateLoader *loader) {
+        m_Loader = loader;
+    }
+
     unsigned getIndexInParent() const;
 
     PathSegment *getParent() const {
@@ -134,39 +183,243 @@ public:
 
 typedef std::map<uint32_t, PathSegmentList> StateToSegments;
 
+/**
+ *  Tree of the segments recorded in the trace of one S2E worker.
+ *  State ids are local to the worker. The states that were forked
+ *  in another worker are the roots of the tree.
+ */
+class WorkerTree
+{
+private:
+    typedef std::map<PathSegment*, uint64_t> SegmentTimeStamps;
+    typedef std::map<uint32_t, uint64_t> StateTimeStamps;
+
+    LogParser *m_Parser;
+    unsigned m_FirstItem;
+    unsigned m_ItemCount;
+
+    StateToSegments m_Segments;
+    PathSegmentList m_Roots;
+
+    //When the segment was forked, or when the root state was first seen
+    SegmentTimeStamps m_StartTimes;
+
+    //Time stamp of the last item of each state
+    StateTimeStamps m_LastTimes;
+
+public:
+    WorkerTree(LogParser *parser, unsigned firstItem, unsigned itemCount);
+
+    //Does not modify the parser, several trees can be built concurrently
+    void build();
+
+    const StateToSegments &getSegments() const {
+        return m_Segments;
+    }
+
+    const PathSegmentList &getRoots() const {
+        return m_Roots;
+    }
+
+    uint64_t getStartTime(PathSegment *seg) const;
+    uint64_t getLastTime(uint32_t stateId) const;
+};
+
 //Sequence of indexes in the children set
 typedef std::vector<uint32_t> ExecutionPath;
 typedef std::vector<ExecutionPath> ExecutionPaths;
 
+/**
+ *  Receives the output that trace processors write to PathBuilder::getOutput()
+ *  while processing a set of paths with PathBuilder::processPaths().
+ *  The output of shared prefixes is replicated to each path.
+ */
+class PathOutputSink
+{
+public:
+    virtual ~PathOutputSink() {}
+
+    //Returns the stream where to write the output of the path.
+    //Called once all the items of the path have been processed.
+    virtual std::ostream *openPath(uint32_t pathId) = 0;
 
+    //Called after the output of the path has been written to os.
+    //The path's processor states are still available at that point.
+    virtual void closePath(uint32_t pathId, std::ostream *os) = 0;
+};
+
+struct SnapshotProcessor {
+    std::string name;
+    ItemProcessorStateFactory factory;
+};
+typedef std::map<void*, SnapshotProcessor> SnapshotProcessors;
 
+/**
+ *  Memory used by the states of one trace processor.
+ *  Sizes come from ItemProcessorState::getMemoryUsage(),
+ *  or are those of the serialized states.
+ */
+struct ProcessorMemory {
+    uint64_t residentStates, residentBytes, peakBytes;
+    uint64_t spilledStates, spilledBytes, reloads;
 
-class PathBuilder: public LogEvents
+    //States that neither know their size nor can be serialized
+    uint64_t unsizedStates;
+
+    ProcessorMemory() {
+        residentStates = residentBytes = peakBytes = 0;
+        spilledStates = spilledBytes = reloads = 0;
+        unsizedStates = 0;
+    }
+};
+
+class PathBuilder: public LogEvents, private PathStateLoader
 {
 private:
+    typedef std::map<PathSegment*, unsigned> SegmentRefCounts;
+    typedef std::map<PathSegment*, std::stringbuf*> SegmentOutputs;
+    typedef std::map<uint32_t, uint32_t> StateIdMap;
+
+    //(processor name, serialized state)
+    typedef std::pair<std::string, std::string> SavedState;
+    typedef std::vector<SavedState> SavedStates;
+    typedef std::map<uint32_t, SavedStates> SavedSegmentStates;
+
+    struct SegmentMemory {
+        std::vector<std::pair<void*, uint64_t> > states;
+        bool spillable;
+    };
+    typedef std::map<PathSegment*, SegmentMemory> SegmentMemoryMap;
+    typedef std::map<PathSegment*, std::pair<uint64_t, uint32_t> > SpillLocations;
+    typedef std::map<void*, ProcessorMemory> ProcessorMemoryMap;
+
     PathSegment *m_Root;
     PathSegment *m_CurrentSegment;
     StateToSegments m_Leaves;
     LogParser *m_Parser;
     sigc::connection m_connection;
 
+    //Processors write their output here
+    std::ostream m_Output;
+
+    //Set when the tree is built by stitchTraces()
+    bool m_MultiTrace;
+
+    //Local to global state ids, for each trace
+    std::vector<unsigned> m_TraceFirstItems;
+    std::vector<StateIdMap> m_StateIdMaps;
+
+    //Processors whose states go into snapshots
+    SnapshotProcessors m_SnapshotProcessors;
+    std::string m_SnapshotFile;
+    unsigned m_SnapshotInterval;
+    unsigned m_ItemsSinceSnapshot;
+
+    //Next item processed by stepItems()
+    uint32_t m_SeekIndex;
+
+    //Memory accounting of the states kept by processTree()
+    bool m_Accounting;
+    uint64_t m_MemoryBudget;
+    uint64_t m_ResidentBytes, m_PeakBytes;
+    SegmentMemoryMap m_SegmentMemory;
+    ProcessorMemoryMap m_ProcessorMemory;
+
+    //Resident segments, oldest first
+    std::deque<PathSegment*> m_ResidentSegments;
+
+    //Scratch file where states go when the budget is exceeded.
+    //(offset, size) of the spilled states of each segment.
+    std::string m_SpillFileName;
+    std::fstream m_SpillFile;
+    uint64_t m_SpillEnd;
+    SpillLocations m_SpillLocations;
+    bool m_ReloadFailed;
+
     void onItem(unsigned traceIndex,
                 const s2e::plugins::ExecutionTraceItemHeader &hdr,
                 void *item);
 
-    void processSegment(PathSegment *seg);
+    void cloneParentState(PathSegment *seg);
+    unsigned processSegment(PathSegment *seg, uint32_t end = (uint32_t)-1);
+    bool processPending(PathSegmentList &pending);
+
+    void numberSegments(PathSegmentList &order) const;
+    bool saveSnapshot(const PathSegmentList &pending);
+    bool readSnapshot(const std::string &file, const PathSegmentList &order,
+                      PathSegmentList &pending, SavedSegmentStates &states);
+    bool restoreState(PathSegment *seg, const SavedStates &saved);
+    bool saveState(PathSegment *seg, SavedStates &saved);
+
+    void resetMemoryAccounting();
+    void accountState(PathSegment *seg);
+    void enforceMemoryBudget(const PathSegmentList &pending);
+    bool spillState(PathSegment *seg);
+    virtual void reloadState(PathSegment *seg);
+    void writePathOutput(PathSegment *leaf, uint32_t pathId,
+                         SegmentOutputs &buffers, PathOutputSink *sink);
 public:
-    PathBuilder(LogParser *log);
+    //If multiTrace is set, the tree is not built while parsing.
+    //Call stitchTraces() once all the traces are parsed.
+    PathBuilder(LogParser *log, bool multiTrace = false);
     ~PathBuilder();
 
+    bool stitchTraces(unsigned jobs = 0);
+    virtual uint32_t getGlobalStateId(unsigned traceIndex, uint32_t stateId) const;
+
     //The paths are inverted!
     void enumeratePaths(ExecutionPaths &paths);
 
+    //Compact form of the paths, in depth-first order.
+    //Use SuccinctTree for navigation on very large trees.
+    void enumeratePaths(EncodedPaths &paths);
+
+    const PathSegment *getRoot() const {
+        return m_Root;
+    }
+
     static void printPath(const ExecutionPath &p, std::ostream &os);
     static void printPaths(const ExecutionPaths &p, std::ostream &os);
 
     bool processPath(uint32_t);
-    void processTree();
+    bool processPaths(const PathSet &paths, PathOutputSink *sink = NULL);
+
+    //Returns false if the states spilled under the memory budget could not be read back
+    bool processTree();
+
+    //Snapshots store the states of the registered processors under the given name,
+    //which must be the same in every tool that reads the snapshot (e.g., the class name).
+    void registerProcessor(const std::string &name, void *processor, ItemProcessorStateFactory f);
+
+    //processTree() saves a snapshot every interval items.
+    //All the processors that have a state must be registered.
+    void enableSnapshots(const std::string &file, unsigned interval);
+
+    //Continues an interrupted processTree() from the given snapshot
+    bool resumeTree(const std::string &file);
+
+    //Restores the processor states right before the given item.
+    //Starts from the deepest state of the snapshot on the way to the item, if any.
+    bool seekItem(uint32_t itemIndex, const std::string &snapshotFile = "");
+
+    //Processes the items that follow the last seekItem() in the same segment.
+    //Returns the number of processed items.
+    unsigned stepItems(unsigned count);
+
+    //Accounts the memory of the states kept by processTree().
+    //Above budget bytes (0 for no limit), the states of the segments that are
+    //not being processed are moved to spillFile, and reloaded when accessed.
+    //Only the states of registered processors can be spilled.
+    void setMemoryBudget(uint64_t budget, const std::string &spillFile);
+
+    //Per-processor memory usage, largest peak first
+    void printMemoryReport(std::ostream &os) const;
+
+    //Stream where trace processors should write their output.
+    //processPaths() redirects it to the paths being processed.
+    std::ostream &getOutput() {
+        return m_Output;
+    }
 
     void resetTree();
     virtual ItemProcessorState* getState(void *processor, ItemProcessorStateFactory f);
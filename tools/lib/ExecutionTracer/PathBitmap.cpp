@@ -0,0 +1,498 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#include <algorithm>
+#include <iterator>
+#include <cassert>
+#include "PathBitmap.h"
+
+namespace s2etools
+{
+
+//Sparse containers become dense above this cardinality
+#define PATHBITMAP_MAX_SPARSE 4096
+
+#define PATHBITMAP_WORDS (65536 / 64)
+
+bool PathBitmap::Container::contains(uint16_t v) const
+{
+    if (isDense()) {
+        return (bits[v / 64] >> (v % 64)) & 1;
+    }
+    return std::binary_search(values.begin(), values.end(), v);
+}
+
+void PathBitmap::Container::toDense()
+{
+    if (isDense()) {
+        return;
+    }
+
+    bits.assign(PATHBITMAP_WORDS, 0);
+    std::vector<uint16_t>::const_iterator it;
+    for (it = values.begin(); it != values.end(); ++it) {
+        bits[*it / 64] |= (uint64_t)1 << (*it % 64);
+    }
+
+    std::vector<uint16_t>().swap(values);
+}
+
+//Recomputes the cardinality of a dense container
+//and makes it sparse if it is small enough.
+void PathBitmap::Container::shrink()
+{
+    if (!isDense()) {
+        cardinality = values.size();
+        return;
+    }
+
+    cardinality = 0;
+    for (unsigned i = 0; i < PATHBITMAP_WORDS; ++i) {
+        cardinality += __builtin_popcountll(bits[i]);
+    }
+
+    if (cardinality > PATHBITMAP_MAX_SPARSE) {
+        return;
+    }
+
+    values.clear();
+    values.reserve(cardinality);
+    for (unsigned i = 0; i < PATHBITMAP_WORDS; ++i) {
+        uint64_t w = bits[i];
+        while (w) {
+            unsigned b = __builtin_ctzll(w);
+            values.push_back(i * 64 + b);
+            w &= w - 1;
+        }
+    }
+
+    std::vector<uint64_t>().swap(bits);
+}
+
+struct ContainerKeyCmp {
+    template <typename C>
+    bool operator()(const C &c, uint16_t key) const {
+        return c.key < key;
+    }
+};
+
+PathBitmap::Containers::iterator PathBitmap::findContainer(uint16_t key)
+{
+    Containers::iterator it = std::lower_bound(m_Containers.begin(), m_Containers.end(),
+                                               key, ContainerKeyCmp());
+    if (it != m_Containers.end() && (*it).key == key) {
+        return it;
+    }
+
+    Container c;
+    c.key = key;
+    c.cardinality = 0;
+    return m_Containers.insert(it, c);
+}
+
+void PathBitmap::add(uint32_t id)
+{
+    Container &c = *findContainer(id >> 16);
+    uint16_t v = id & 0xffff;
+
+    if (c.isDense()) {
+        uint64_t mask = (uint64_t)1 << (v % 64);
+        if (!(c.bits[v / 64] & mask)) {
+            c.bits[v / 64] |= mask;
+            ++c.cardinality;
+        }
+        return;
+    }
+
+    std::vector<uint16_t>::iterator it = std::lower_bound(c.values.begin(), c.values.end(), v);
+    if (it != c.values.end() && *it == v) {
+        return;
+    }
+
+    c.values.insert(it, v);
+    ++c.cardinality;
+    if (c.cardinality > PATHBITMAP_MAX_SPARSE) {
+        c.toDense();
+    }
+}
+
+bool PathBitmap::contains(uint32_t id) const
+{
+    Containers::const_iterator it = std::lower_bound(m_Containers.begin(), m_Containers.end(),
+                                                     (uint16_t)(id >> 16), ContainerKeyCmp());
+    if (it == m_Containers.end() || (*it).key != (id >> 16)) {
+        return false;
+    }
+    return (*it).contains(id & 0xffff);
+}
+
+uint64_t PathBitmap::cardinality() const
+{
+    uint64_t ret = 0;
+    Containers::const_iterator it;
+    for (it = m_Containers.begin(); it != m_Containers.end(); ++it) {
+        ret += (*it).cardinality;
+    }
+    return ret;
+}
+
+void PathBitmap::unite(const PathBitmap &b)
+{
+    Containers result;
+    Containers::iterator it1 = m_Containers.begin();
+    Containers::const_iterator it2 = b.m_Containers.begin();
+
+    while (it1 != m_Containers.end() || it2 != b.m_Containers.end()) {
+        if (it2 == b.m_Containers.end() || (it1 != m_Containers.end() && (*it1).key < (*it2).key)) {
+            result.push_back(*it1++);
+            continue;
+        }
+
+        if (it1 == m_Containers.end() || (*it2).key < (*it1).key) {
+            result.push_back(*it2++);
+            continue;
+        }
+
+        Container &c1 = *it1;
+        const Container &c2 = *it2;
+
+        if (!c1.isDense() && !c2.isDense()) {
+            std::vector<uint16_t> values;
+            std::set_union(c1.values.begin(), c1.values.end(),
+                           c2.values.begin(), c2.values.end(),
+                           std::back_inserter(values));
+            c1.values.swap(values);
+            c1.cardinality = c1.values.size();
+            if (c1.cardinality > PATHBITMAP_MAX_SPARSE) {
+                c1.toDense();
+            }
+        } else {
+            c1.toDense();
+            if (c2.isDense()) {
+                for (unsigned i = 0; i < PATHBITMAP_WORDS; ++i) {
+                    c1.bits[i] |= c2.bits[i];
+                }
+            } else {
+                std::vector<uint16_t>::const_iterator vit;
+                for (vit = c2.values.begin(); vit != c2.values.end(); ++vit) {
+                    c1.bits[*vit / 64] |= (uint64_t)1 << (*vit % 64);
+                }
+            }
+            c1.shrink();
+        }
+
+        result.push_back(Container());
+        result.back().key = c1.key;
+        result.back().cardinality = c1.cardinality;
+        result.back().values.swap(c1.values);
+        result.back().bits.swap(c1.bits);
+        ++it1;
+        ++it2;
+    }
+
+    m_Containers.swap(result);
+}
+
+void PathBitmap::intersect(const PathBitmap &b)
+{
+    Containers result;
+    Containers::iterator it1 = m_Containers.begin();
+    Containers::const_iterator it2 = b.m_Containers.begin();
+
+    while (it1 != m_Containers.end() && it2 != b.m_Containers.end()) {
+        if ((*it1).key < (*it2).key) {
+            ++it1;
+            continue;
+        }
+
+        if ((*it2).key < (*it1).key) {
+            ++it2;
+            continue;
+        }
+
+        const Container &c1 = *it1;
+        const Container &c2 = *it2;
+        Container c;
+        c.key = c1.key;
+
+        if (c1.isDense() && c2.isDense()) {
+            c.bits.resize(PATHBITMAP_WORDS);
+            for (unsigned i = 0; i < PATHBITMAP_WORDS; ++i) {
+                c.bits[i] = c1.bits[i] & c2.bits[i];
+            }
+        } else if (!c1.isDense() && !c2.isDense()) {
+            std::set_intersection(c1.values.begin(), c1.values.end(),
+                                  c2.values.begin(), c2.values.end(),
+                                  std::back_inserter(c.values));
+        } else {
+            //Filter the values of the sparse container
+            const Container &sparse = c1.isDense() ? c2 : c1;
+            const Container &dense = c1.isDense() ? c1 : c2;
+            std::vector<uint16_t>::const_iterator vit;
+            for (vit = sparse.values.begin(); vit != sparse.values.end(); ++vit) {
+                if (dense.contains(*vit)) {
+                    c.values.push_back(*vit);
+                }
+            }
+        }
+
+        c.shrink();
+        if (c.cardinality > 0) {
+            result.push_back(Container());
+            result.back().key = c.key;
+            result.back().cardinality = c.cardinality;
+            result.back().values.swap(c.values);
+            result.back().bits.swap(c.bits);
+        }
+
+        ++it1;
+        ++it2;
+    }
+
+    m_Containers.swap(result);
+}
+
+void PathBitmap::subtract(const PathBitmap &b)
+{
+    Containers result;
+    Containers::iterator it1 = m_Containers.begin();
+    Containers::const_iterator it2 = b.m_Containers.begin();
+
+    for (; it1 != m_Containers.end(); ++it1) {
+        Container &c1 = *it1;
+
+        while (it2 != b.m_Containers.end() && (*it2).key < c1.key) {
+            ++it2;
+        }
+
+        if (it2 == b.m_Containers.end() || (*it2).key != c1.key) {
+            result.push_back(Container());
+            result.back().key = c1.key;
+            result.back().cardinality = c1.cardinality;
+            result.back().values.swap(c1.values);
+            result.back().bits.swap(c1.bits);
+            continue;
+        }
+
+        const Container &c2 = *it2;
+        if (!c1.isDense()) {
+            std::vector<uint16_t> values;
+            std::vector<uint16_t>::const_iterator vit;
+            for (vit = c1.values.begin(); vit != c1.values.end(); ++vit) {
+                if (!c2.contains(*vit)) {
+                    values.push_back(*vit);
+                }
+            }
+            c1.values.swap(values);
+        } else if (c2.isDense()) {
+            for (unsigned i = 0; i < PATHBITMAP_WORDS; ++i) {
+                c1.bits[i] &= ~c2.bits[i];
+            }
+        } else {
+            std::vector<uint16_t>::const_iterator vit;
+            for (vit = c2.values.begin(); vit != c2.values.end(); ++vit) {
+                c1.bits[*vit / 64] &= ~((uint64_t)1 << (*vit % 64));
+            }
+        }
+
+        c1.shrink();
+        if (c1.cardinality > 0) {
+            result.push_back(Container());
+            result.back().key = c1.key;
+            result.back().cardinality = c1.cardinality;
+            result.back().values.swap(c1.values);
+            result.back().bits.swap(c1.bits);
+        }
+    }
+
+    m_Containers.swap(result);
+}
+
+void PathBitmap::getIds(std::vector<uint32_t> &ids) const
+{
+    Containers::const_iterator it;
+    for (it = m_Containers.begin(); it != m_Containers.end(); ++it) {
+        const Container &c = *it;
+        uint32_t high = (uint32_t)c.key << 16;
+
+        if (!c.isDense()) {
+            std::vector<uint16_t>::const_iterator vit;
+            for (vit = c.values.begin(); vit != c.values.end(); ++vit) {
+                ids.push_back(high | *vit);
+            }
+            continue;
+        }
+
+        for (unsigned i = 0; i < PATHBITMAP_WORDS; ++i) {
+            uint64_t w = c.bits[i];
+            while (w) {
+                ids.push_back(high | (i * 64 + __builtin_ctzll(w)));
+                w &= w - 1;
+            }
+        }
+    }
+}
+
+uint64_t PathBitmap::getMemoryUsage() const
+{
+    uint64_t ret = m_Containers.capacity() * sizeof(Container);
+    Containers::const_iterator it;
+    for (it = m_Containers.begin(); it != m_Containers.end(); ++it) {
+        ret += (*it).values.capacity() * sizeof(uint16_t);
+        ret += (*it).bits.capacity() * sizeof(uint64_t);
+    }
+    return ret;
+}
+
+void PathBitmap::serialize(std::ostream &os) const
+{
+    uint32_t count = m_Containers.size();
+    os.write((const char*)&count, sizeof(count));
+
+    Containers::const_iterator it;
+    for (it = m_Containers.begin(); it != m_Containers.end(); ++it) {
+        const Container &c = *it;
+        uint8_t dense = c.isDense();
+        os.write((const char*)&c.key, sizeof(c.key));
+        os.write((const char*)&dense, sizeof(dense));
+        os.write((const char*)&c.cardinality, sizeof(c.cardinality));
+        if (dense) {
+            os.write((const char*)&c.bits[0], PATHBITMAP_WORDS * sizeof(uint64_t));
+        } else if (c.cardinality > 0) {
+            os.write((const char*)&c.values[0], c.cardinality * sizeof(uint16_t));
+        }
+    }
+}
+
+//Bytes left in the stream, false if it cannot tell
+static bool getRemainingBytes(std::istream &is, uint64_t &remaining)
+{
+    std::streampos cur = is.tellg();
+    if (cur == std::streampos(-1)) {
+        return false;
+    }
+
+    is.seekg(0, std::ios::end);
+    std::streampos end = is.tellg();
+    is.seekg(cur);
+    if (end == std::streampos(-1) || !is) {
+        is.clear();
+        is.seekg(cur);
+        return false;
+    }
+
+    remaining = end - cur;
+    return true;
+}
+
+//Validates the counts before allocating anything, a corrupted
+//stream leaves the bitmap empty
+bool PathBitmap::deserialize(std::istream &is)
+{
+    //Key, dense flag and cardinality
+    static const unsigned headerSize = sizeof(uint16_t) + sizeof(uint8_t) + sizeof(uint32_t);
+
+    uint32_t count;
+    m_Containers.clear();
+
+    if (!is.read((char*)&count, sizeof(count)) || count > 65536) {
+        return false;
+    }
+
+    uint64_t remaining = 0;
+    bool sized = getRemainingBytes(is, remaining);
+    if (sized && (uint64_t)count * headerSize > remaining) {
+        return false;
+    }
+
+    Containers containers;
+    containers.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        Container c;
+        uint8_t dense;
+
+        if (!is.read((char*)&c.key, sizeof(c.key)) ||
+            !is.read((char*)&dense, sizeof(dense)) ||
+            !is.read((char*)&c.cardinality, sizeof(c.cardinality))) {
+            return false;
+        }
+
+        if (dense > 1 || c.cardinality > 65536 ||
+            (i > 0 && c.key <= containers.back().key)) {
+            return false;
+        }
+
+        uint64_t size = dense ? PATHBITMAP_WORDS * sizeof(uint64_t) : c.cardinality * sizeof(uint16_t);
+        if (sized) {
+            if (headerSize + size > remaining) {
+                return false;
+            }
+            remaining -= headerSize + size;
+        }
+
+        if (dense) {
+            c.bits.resize(PATHBITMAP_WORDS);
+            if (!is.read((char*)&c.bits[0], size)) {
+                return false;
+            }
+
+            uint32_t bits = 0;
+            for (unsigned j = 0; j < PATHBITMAP_WORDS; ++j) {
+                bits += __builtin_popcountll(c.bits[j]);
+            }
+            if (bits != c.cardinality) {
+                return false;
+            }
+        } else if (c.cardinality > 0) {
+            c.values.resize(c.cardinality);
+            if (!is.read((char*)&c.values[0], size)) {
+                return false;
+            }
+
+            for (unsigned j = 1; j < c.values.size(); ++j) {
+                if (c.values[j - 1] >= c.values[j]) {
+                    return false;
+                }
+            }
+        }
+
+        containers.push_back(c);
+    }
+
+    m_Containers.swap(containers);
+    return true;
+}
+
+}
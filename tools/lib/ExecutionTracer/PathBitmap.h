@@ -0,0 +1,111 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#ifndef S2ETOOLS_EXECTRACER_PATHBITMAP_H
+#define S2ETOOLS_EXECTRACER_PATHBITMAP_H
+
+#include <vector>
+#include <istream>
+#include <ostream>
+#include <inttypes.h>
+
+namespace s2etools
+{
+
+/**
+ *  Compressed set of path ids, in the spirit of Roaring bitmaps.
+ *  Ids are split in chunks of 2^16 values. Each chunk is stored
+ *  either as a sorted array of 16-bit values or, when it has more than
+ *  4096 elements, as a 2^16-bit bitmap.
+ */
+class PathBitmap
+{
+private:
+    struct Container {
+        uint16_t key;
+        uint32_t cardinality;
+
+        //Sorted values of a sparse container
+        std::vector<uint16_t> values;
+
+        //Bits of a dense container, empty if the container is sparse
+        std::vector<uint64_t> bits;
+
+        bool isDense() const {
+            return !bits.empty();
+        }
+
+        bool contains(uint16_t v) const;
+        void toDense();
+        void shrink();
+    };
+
+    typedef std::vector<Container> Containers;
+
+    //Sorted by key
+    Containers m_Containers;
+
+    Containers::iterator findContainer(uint16_t key);
+
+public:
+    void add(uint32_t id);
+    bool contains(uint32_t id) const;
+
+    uint64_t cardinality() const;
+    bool empty() const {
+        return m_Containers.empty();
+    }
+
+    void clear() {
+        m_Containers.clear();
+    }
+
+    //In-place set operations
+    void unite(const PathBitmap &b);
+    void intersect(const PathBitmap &b);
+    void subtract(const PathBitmap &b);
+
+    void getIds(std::vector<uint32_t> &ids) const;
+
+    uint64_t getMemoryUsage() const;
+
+    //The format uses the byte order of the host
+    void serialize(std::ostream &os) const;
+    bool deserialize(std::istream &is);
+};
+
+}
+
+#endif
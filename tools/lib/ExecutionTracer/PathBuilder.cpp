@@ -38,8 +38,19 @@
 #include <stack>
 #include <ostream>
 #include <iostream>
+#include <algorithm>
+#include <set>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
 #include "Path.h"
 
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
 //#define DEBUG_PB
 
 namespace s2etools
@@ -50,6 +61,7 @@ PathSegment::PathSegment(PathSegment *parent, uint32_t stateId, uint64_t forkPc)
     m_StateId = stateId;
     m_ForkPc = forkPc;
     m_Parent = NULL;
+    m_Loader = NULL;
 
     if (parent) {
         m_Parent = parent;
@@ -75,6 +87,24 @@ void PathSegment::deleteState()
         delete (*it).second;
     }
     m_SegmentState.clear();
+    m_Loader = NULL;
+}
+
+//Appends the fragments and the children of seg to this segment.
+//seg is left empty.
+void PathSegment::merge(PathSegment *seg)
+{
+    m_FragmentList.insert(m_FragmentList.end(),
+                          seg->m_FragmentList.begin(), seg->m_FragmentList.end());
+
+    PathSegmentList::iterator it;
+    for (it = seg->m_Children.begin(); it != seg->m_Children.end(); ++it) {
+        (*it)->m_Parent = this;
+        m_Children.push_back(*it);
+    }
+
+    seg->m_FragmentList.clear();
+    seg->m_Children.clear();
 }
 
 unsigned PathSegment::getIndexInParent() const
@@ -112,13 +142,24 @@ void PathSegment::print(std::ostream &os) const
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 
-PathBuilder::PathBuilder(LogParser *log)
+PathBuilder::PathBuilder(LogParser *log, bool multiTrace):m_Output(std::cout.rdbuf())
 {
     m_Parser = log;
-
-    m_connection = log->onEachItem.connect(
-            sigc::mem_fun(*this, &PathBuilder::onItem)
-    );
+    m_MultiTrace = multiTrace;
+    m_SnapshotInterval = 0;
+    m_ItemsSinceSnapshot = 0;
+    m_SeekIndex = 0;
+    m_Accounting = false;
+    m_MemoryBudget = 0;
+    m_ResidentBytes = m_PeakBytes = 0;
+    m_SpillEnd = 0;
+    m_ReloadFailed = false;
+
+    if (!multiTrace) {
+        m_connection = log->onEachItem.connect(
+                sigc::mem_fun(*this, &PathBuilder::onItem)
+        );
+    }
 
     m_Root = new PathSegment(NULL, 0, 0);
     m_CurrentSegment = m_Root;
@@ -139,6 +180,11 @@ PathBuilder::~PathBuilder()
             delete ps;
         }
     }
+
+    if (m_SpillFile.is_open()) {
+        m_SpillFile.close();
+        remove(m_SpillFileName.c_str());
+    }
 }
 
 void PathBuilder::onItem(unsigned traceIndex,
@@ -222,46 +268,593 @@ void PathBuilder::onItem(unsigned traceIndex,
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+WorkerTree::WorkerTree(LogParser *parser, unsigned firstItem, unsigned itemCount)
+{
+    m_Parser = parser;
+    m_FirstItem = firstItem;
+    m_ItemCount = itemCount;
+}
+
+//Same as PathBuilder::onItem(), except that states that were not
+//forked in this trace start a new root instead of being an error.
+void WorkerTree::build()
+{
+    PathSegment *current = NULL;
+
+    for (unsigned i = m_FirstItem; i < m_FirstItem + m_ItemCount; ++i) {
+        s2e::plugins::ExecutionTraceItemHeader hdr;
+        void *item;
+
+        if (!m_Parser->getItem(i, hdr, &item)) {
+            break;
+        }
+
+        m_LastTimes[hdr.stateId] = hdr.timeStamp;
+
+        if (!current || hdr.stateId != current->getStateId()) {
+            StateToSegments::iterator it = m_Segments.find(hdr.stateId);
+            if (it == m_Segments.end()) {
+                //The state was forked by another worker
+                current = new PathSegment(NULL, hdr.stateId, 0);
+                m_Segments[hdr.stateId].push_back(current);
+                m_Roots.push_back(current);
+                m_StartTimes[current] = hdr.timeStamp;
+            } else {
+                current = (*it).second.back();
+            }
+            current->appendFragment(PathFragment(i, i));
+        } else if (!current->hasFragments()) {
+            current->appendFragment(PathFragment(i, i));
+        } else {
+            current->expandLastFragment(i);
+        }
+
+        if (hdr.type == s2e::plugins::TRACE_FORK) {
+            s2e::plugins::ExecutionTraceFork *f = (s2e::plugins::ExecutionTraceFork*)item;
+            PathSegment *parent = current;
+            for(unsigned j = 0; j<f->stateCount; ++j) {
+                PathSegment *newSeg = new PathSegment(parent, f->children[j], f->pc);
+                m_Segments[f->children[j]].push_back(newSeg);
+                m_StartTimes[newSeg] = hdr.timeStamp;
+                if (f->children[j] == parent->getStateId()) {
+                    current = newSeg;
+                }
+            }
+        }
+    }
+}
+
+uint64_t WorkerTree::getStartTime(PathSegment *seg) const
+{
+    SegmentTimeStamps::const_iterator it = m_StartTimes.find(seg);
+    assert(it != m_StartTimes.end());
+    return (*it).second;
+}
+
+uint64_t WorkerTree::getLastTime(uint32_t stateId) const
+{
+    StateTimeStamps::const_iterator it = m_LastTimes.find(stateId);
+    if (it == m_LastTimes.end()) {
+        return 0;
+    }
+    return (*it).second;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+typedef std::vector<WorkerTree*> WorkerTrees;
+
+struct WorkerTreeJob {
+    WorkerTrees *trees;
+    unsigned first;
+    unsigned step;
+};
+
+void *buildWorkerTrees(void *opaque)
+{
+    WorkerTreeJob *job = static_cast<WorkerTreeJob*>(opaque);
+    for (unsigned i = job->first; i < job->trees->size(); i += job->step) {
+        (*job->trees)[i]->build();
+    }
+    return NULL;
+}
+
+//A segment to which the root of a worker tree can be attached
+struct StitchCandidate {
+    unsigned tree;
+    PathSegment *seg;
+    uint64_t startTime;
+};
+
+typedef std::map<uint32_t, std::vector<StitchCandidate> > StitchCandidates;
+
+//Latest segment of trace parent (or of any other trace if parent is -1) that has
+//the id of the root of trace self and started before it. States that stopped
+//running in their trace before the root started, i.e., were handed over, win.
+//A segment can be handed over only once. On ties, the last created segment wins,
+//as a fork creates the segment that continues the forking state.
+const StitchCandidate *findStitchCandidate(const WorkerTrees &trees,
+                                           StitchCandidates &candidates,
+                                           const std::set<PathSegment*> &used,
+                                           unsigned self, int parent,
+                                           PathSegment *root, bool &handedOver)
+{
+    uint32_t id = root->getStateId();
+    uint64_t time = trees[self]->getStartTime(root);
+    const StitchCandidate *best = NULL;
+
+    handedOver = false;
+
+    const std::vector<StitchCandidate> &cl = candidates[id];
+    std::vector<StitchCandidate>::const_iterator it;
+    for (it = cl.begin(); it != cl.end(); ++it) {
+        const StitchCandidate &c = *it;
+        if (c.tree == self || (parent >= 0 && c.tree != (unsigned)parent) ||
+            c.startTime > time || used.count(c.seg)) {
+            continue;
+        }
+
+        bool h = trees[c.tree]->getLastTime(id) <= time;
+        if (!best || (h && !handedOver) ||
+            (h == handedOver && c.startTime >= best->startTime)) {
+            best = &c;
+            handedOver = h;
+        }
+    }
+
+    return best;
+}
+
+void collectSubtree(PathSegment *seg, std::set<PathSegment*> &segments)
+{
+    std::stack<PathSegment*> s;
+    s.push(seg);
+    while (!s.empty()) {
+        PathSegment *cur = s.top();
+        s.pop();
+        segments.insert(cur);
+
+        const PathSegmentList &children = cur->getChildren();
+        PathSegmentList::const_iterator it;
+        for (it = children.begin(); it != children.end(); ++it) {
+            s.push(*it);
+        }
+    }
+}
+
+}
+
+/**
+ *  Builds one execution tree out of the traces of parallel S2E workers.
+ *  Each trace is first turned into a WorkerTree, using up to jobs threads
+ *  (0 means one per processor).
+ *
+ *  The root states of a worker were forked by another worker before it
+ *  handed them over. Each root is attached to the latest segment of the
+ *  same state id that started before the root's first item in another trace,
+ *  preferring states that stopped running there, i.e., that were handed over.
+ *  Time stamps are the only ordering between traces, so this is a heuristic
+ *  when several workers reuse the same ids at about the same time.
+ *  The earliest root that has no such segment is the initial state.
+ *
+ *  State ids of different workers collide. Ids of the initial state's trace
+ *  are kept, roots take the id of the segment they continue, and states forked
+ *  by a worker get a fresh id if theirs is already taken. Use getGlobalStateId()
+ *  to map ids found in trace items.
+ */
+bool PathBuilder::stitchTraces(unsigned jobs)
+{
+    assert(m_MultiTrace && "Construct the PathBuilder with multiTrace set");
+
+    WorkerTrees trees;
+    for (unsigned i = 0; i < m_Parser->getTraceCount(); ++i) {
+        unsigned first, count;
+        m_Parser->getTraceItems(i, first, count);
+        trees.push_back(new WorkerTree(m_Parser, first, count));
+        m_TraceFirstItems.push_back(first);
+    }
+
+    if (trees.empty()) {
+        return false;
+    }
+
+#ifdef _WIN32
+    jobs = 1;
+#else
+    if (jobs == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = cpus > 0 ? cpus : 1;
+    }
+#endif
+
+    if (jobs > trees.size()) {
+        jobs = trees.size();
+    }
+
+    std::vector<WorkerTreeJob> workerJobs(jobs);
+    for (unsigned i = 0; i < jobs; ++i) {
+        workerJobs[i].trees = &trees;
+        workerJobs[i].first = i;
+        workerJobs[i].step = jobs;
+    }
+
+#ifdef _WIN32
+    buildWorkerTrees(&workerJobs[0]);
+#else
+    std::vector<pthread_t> threads(jobs);
+    for (unsigned i = 1; i < jobs; ++i) {
+        pthread_create(&threads[i], NULL, buildWorkerTrees, &workerJobs[i]);
+    }
+    buildWorkerTrees(&workerJobs[0]);
+    for (unsigned i = 1; i < jobs; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+#endif
+
+    //Every segment can continue in another trace
+    StitchCandidates candidates;
+    for (unsigned t = 0; t < trees.size(); ++t) {
+        const StateToSegments &segments = trees[t]->getSegments();
+        StateToSegments::const_iterator it;
+        for (it = segments.begin(); it != segments.end(); ++it) {
+            PathSegmentList::const_iterator sit;
+            for (sit = (*it).second.begin(); sit != (*it).second.end(); ++sit) {
+                StitchCandidate c;
+                c.tree = t;
+                c.seg = *sit;
+                c.startTime = trees[t]->getStartTime(*sit);
+                candidates[(*it).first].push_back(c);
+            }
+        }
+    }
+
+    //Find where to attach each root. All the roots of a worker normally come
+    //from the same parent worker: pick the trace that explains most of them,
+    //as state ids may collide with those of other workers. Workers are
+    //considered in the order in which they started.
+    std::vector<std::pair<uint64_t, unsigned> > startOrder;
+    for (unsigned t = 0; t < trees.size(); ++t) {
+        const PathSegmentList &roots = trees[t]->getRoots();
+        if (!roots.empty()) {
+            startOrder.push_back(std::make_pair(trees[t]->getStartTime(roots[0]), t));
+        }
+    }
+    std::sort(startOrder.begin(), startOrder.end());
+
+    std::map<PathSegment*, StitchCandidate> targets;
+    std::set<PathSegment*> used;
+    PathSegment *initialRoot = NULL;
+    unsigned initialTree = 0;
+
+    for (unsigned i = 0; i < startOrder.size(); ++i) {
+        unsigned t = startOrder[i].second;
+        const PathSegmentList &roots = trees[t]->getRoots();
+        PathSegmentList::const_iterator rit;
+        int parent = -1;
+        unsigned parentHandedOver = 0, parentFound = 0;
+        uint64_t parentLatest = 0;
+
+        for (unsigned u = 0; u < trees.size(); ++u) {
+            unsigned handedOverCount = 0, foundCount = 0;
+            uint64_t latest = 0;
+            for (rit = roots.begin(); rit != roots.end(); ++rit) {
+                bool handedOver;
+                const StitchCandidate *c;
+                c = findStitchCandidate(trees, candidates, used, t, u, *rit, handedOver);
+                if (c) {
+                    ++foundCount;
+                    handedOverCount += handedOver;
+                    latest = std::max(latest, c->startTime);
+                }
+            }
+
+            if (handedOverCount > parentHandedOver ||
+                (handedOverCount == parentHandedOver && foundCount > parentFound) ||
+                (handedOverCount == parentHandedOver && foundCount == parentFound &&
+                 foundCount > 0 && latest > parentLatest)) {
+                parent = u;
+                parentHandedOver = handedOverCount;
+                parentFound = foundCount;
+                parentLatest = latest;
+            }
+        }
+
+        for (rit = roots.begin(); rit != roots.end(); ++rit) {
+            PathSegment *root = *rit;
+            const StitchCandidate *best = NULL;
+            bool handedOver;
+
+            if (parent >= 0) {
+                best = findStitchCandidate(trees, candidates, used, t, parent, root, handedOver);
+            }
+            if (!best) {
+                best = findStitchCandidate(trees, candidates, used, t, -1, root, handedOver);
+            }
+
+            if (best) {
+                targets[root] = *best;
+                used.insert(best->seg);
+            } else if (!initialRoot ||
+                       trees[t]->getStartTime(root) < trees[initialTree]->getStartTime(initialRoot)) {
+                initialRoot = root;
+                initialTree = t;
+            }
+        }
+    }
+
+    if (!initialRoot) {
+        std::cerr << "Could not find the initial state in the traces" << std::endl;
+        for (unsigned t = 0; t < trees.size(); ++t) {
+            const StateToSegments &segments = trees[t]->getSegments();
+            StateToSegments::const_iterator it;
+            for (it = segments.begin(); it != segments.end(); ++it) {
+                PathSegmentList::const_iterator sit;
+                for (sit = (*it).second.begin(); sit != (*it).second.end(); ++sit) {
+                    delete *sit;
+                }
+            }
+            delete trees[t];
+        }
+        m_TraceFirstItems.clear();
+        return false;
+    }
+
+    //Process the traces after the ones they were forked from
+    std::vector<unsigned> order;
+    std::vector<bool> ordered(trees.size(), false);
+    order.push_back(initialTree);
+    ordered[initialTree] = true;
+
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        for (unsigned t = 0; t < trees.size(); ++t) {
+            if (ordered[t]) {
+                continue;
+            }
+
+            bool ready = true;
+            const PathSegmentList &roots = trees[t]->getRoots();
+            PathSegmentList::const_iterator rit;
+            for (rit = roots.begin(); rit != roots.end(); ++rit) {
+                std::map<PathSegment*, StitchCandidate>::iterator tit = targets.find(*rit);
+                if (tit != targets.end() && !ordered[(*tit).second.tree]) {
+                    ready = false;
+                    break;
+                }
+            }
+
+            if (ready) {
+                order.push_back(t);
+                ordered[t] = true;
+                progress = true;
+            }
+        }
+    }
+
+    //Roots that cannot be attached and the traces that depend on them are dropped
+    std::set<PathSegment*> dropped;
+    for (unsigned t = 0; t < trees.size(); ++t) {
+        const PathSegmentList &roots = trees[t]->getRoots();
+        PathSegmentList::const_iterator rit;
+        for (rit = roots.begin(); rit != roots.end(); ++rit) {
+            if (*rit == initialRoot || (ordered[t] && targets.count(*rit))) {
+                continue;
+            }
+            std::cerr << "Could not find where state " << (*rit)->getStateId() <<
+                    " of trace " << t << " was forked, dropping it" << std::endl;
+            collectSubtree(*rit, dropped);
+        }
+    }
+
+    //Attach the roots and assign global state ids
+    std::map<PathSegment*, PathSegment*> merged;
+    std::set<uint32_t> usedIds;
+    uint32_t maxId = 0;
+
+    m_Leaves.clear();
+    m_StateIdMaps.clear();
+    m_StateIdMaps.resize(trees.size());
+
+    std::vector<unsigned>::const_iterator oit;
+    for (oit = order.begin(); oit != order.end(); ++oit) {
+        unsigned t = *oit;
+        StateIdMap &ids = m_StateIdMaps[t];
+
+        const PathSegmentList &roots = trees[t]->getRoots();
+        PathSegmentList::const_iterator rit;
+        for (rit = roots.begin(); rit != roots.end(); ++rit) {
+            PathSegment *root = *rit;
+            if (dropped.count(root)) {
+                continue;
+            }
+
+            PathSegment *target;
+            if (root == initialRoot) {
+                target = m_Root;
+                m_Root->setStateId(root->getStateId());
+                m_Leaves[root->getStateId()].push_back(m_Root);
+            } else {
+                target = targets[root].seg;
+                while (merged.count(target)) {
+                    target = merged[target];
+                }
+
+                if (dropped.count(target)) {
+                    collectSubtree(root, dropped);
+                    continue;
+                }
+            }
+
+            target->merge(root);
+            merged[root] = target;
+            ids[root->getStateId()] = target->getStateId();
+            usedIds.insert(target->getStateId());
+            maxId = std::max(maxId, target->getStateId());
+        }
+
+        const StateToSegments &segments = trees[t]->getSegments();
+        StateToSegments::const_iterator it;
+        for (it = segments.begin(); it != segments.end(); ++it) {
+            uint32_t localId = (*it).first;
+            if (ids.find(localId) == ids.end()) {
+                uint32_t globalId = usedIds.count(localId) ? maxId + 1 : localId;
+                ids[localId] = globalId;
+                usedIds.insert(globalId);
+                maxId = std::max(maxId, globalId);
+            }
+
+            PathSegmentList::const_iterator sit;
+            for (sit = (*it).second.begin(); sit != (*it).second.end(); ++sit) {
+                PathSegment *seg = *sit;
+                if (merged.count(seg) || dropped.count(seg)) {
+                    continue;
+                }
+                seg->setStateId(ids[localId]);
+                m_Leaves[ids[localId]].push_back(seg);
+            }
+        }
+    }
+
+    //The segments of the traces that could not be ordered are dropped too
+    for (unsigned t = 0; t < trees.size(); ++t) {
+        if (!ordered[t]) {
+            const StateToSegments &segments = trees[t]->getSegments();
+            StateToSegments::const_iterator it;
+            for (it = segments.begin(); it != segments.end(); ++it) {
+                dropped.insert((*it).second.begin(), (*it).second.end());
+            }
+        }
+        delete trees[t];
+    }
+
+    std::set<PathSegment*>::iterator dit;
+    for (dit = dropped.begin(); dit != dropped.end(); ++dit) {
+        delete *dit;
+    }
+
+    std::map<PathSegment*, PathSegment*>::iterator mit;
+    for (mit = merged.begin(); mit != merged.end(); ++mit) {
+        delete (*mit).first;
+    }
+
+    m_CurrentSegment = m_Root;
+    return true;
+}
+
+uint32_t PathBuilder::getGlobalStateId(unsigned traceIndex, uint32_t stateId) const
+{
+    if (m_TraceFirstItems.empty()) {
+        return stateId;
+    }
+
+    std::vector<unsigned>::const_iterator it;
+    it = std::upper_bound(m_TraceFirstItems.begin(), m_TraceFirstItems.end(), traceIndex);
+    assert(it != m_TraceFirstItems.begin());
+
+    const StateIdMap &ids = m_StateIdMaps[it - m_TraceFirstItems.begin() - 1];
+    StateIdMap::const_iterator iit = ids.find(stateId);
+    if (iit == ids.end()) {
+        return stateId;
+    }
+    return (*iit).second;
+}
+
+//Each entry carries the depth of the segment and its index in the parent,
+//so that paths can be built without searching the parents.
+struct PathStackEntry {
+    PathSegment *seg;
+    unsigned depth;
+    unsigned index;
+};
+
+struct EncodedPathStackEntry {
+    const PathSegment *seg;
+    uint32_t prefixLength;
+    unsigned index;
+    unsigned width;
+};
+
 void PathBuilder::enumeratePaths(ExecutionPaths &paths)
 {
     ExecutionPath currentPath;
-    std::stack<PathSegment*> s;
+    std::stack<PathStackEntry> s;
 
-    s.push(m_Root);
+    PathStackEntry root = {m_Root, 0, 0};
+    s.push(root);
 
     while(s.size()>0) {
-        PathSegment *curSeg = s.top();
+        PathStackEntry cur = s.top();
+        PathSegment *curSeg = cur.seg;
         s.pop();
 
 #ifdef DEBUG_PB
         std::cout << "Poping " << curSeg->getStateId() << std::endl;
 #endif
 
+        //currentPath holds the child indexes from the root to curSeg
+        if (cur.depth > 0) {
+            currentPath.resize(cur.depth);
+            currentPath[cur.depth - 1] = cur.index;
+        }
+
         const PathSegmentList &children = curSeg->getChildren();
-        PathSegmentList::const_iterator it;
 
         assert(children.size() == 0 || children.size() == 2);
 
         if (children.size() > 0) {
-            for (it = children.begin(); it != children.end(); ++it) {
+            for (unsigned i = 0; i < children.size(); ++i) {
 #ifdef DEBUG_PB
-                std::cout << "Pushing children " << (*it)->getStateId() << std::endl;
+                std::cout << "Pushing children " << children[i]->getStateId() << std::endl;
 #endif
-                s.push(*it);
+                PathStackEntry e = {children[i], cur.depth + 1, i};
+                s.push(e);
             }
         }else {
 #ifdef DEBUG_PB
                 std::cout << ">Building path" << std::endl;
 #endif
             //We have finished traversing one path, build it.
-            paths.push_back(ExecutionPath());
-            ExecutionPath &curPath = paths.back();
+            paths.push_back(ExecutionPath(currentPath.rbegin(),
+                                          currentPath.rbegin() + cur.depth));
+        }
+    }
+}
 
-            //curSeg = curSeg->getParent();
-            while(curSeg->getParent() != 0) {
-                curPath.push_back(curSeg->getIndexInParent());
-                curSeg = curSeg->getParent();
-            }
+void PathBuilder::enumeratePaths(EncodedPaths &paths)
+{
+    EncodedPath currentPath;
+    std::stack<EncodedPathStackEntry> s;
+
+    EncodedPathStackEntry root = {m_Root, 0, 0, 0};
+    s.push(root);
+
+    while (!s.empty()) {
+        EncodedPathStackEntry cur = s.top();
+        s.pop();
+
+        currentPath.truncate(cur.prefixLength);
+        currentPath.append(cur.index, cur.width);
+
+        const PathSegmentList &children = cur.seg->getChildren();
+        if (children.empty()) {
+            paths.push_back(currentPath);
+            continue;
+        }
+
+        //Push in reverse order to output the paths in depth-first order
+        unsigned width = EncodedPath::getWidth(children.size());
+        for (unsigned i = children.size(); i > 0; --i) {
+            EncodedPathStackEntry e = {children[i - 1], currentPath.length(), i - 1, width};
+            s.push(e);
         }
     }
 }
@@ -283,12 +876,15 @@ void PathBuilder::printPaths(const ExecutionPaths &p, std::ostream &os)
     }
 }
 
-void PathBuilder::processSegment(PathSegment *seg)
+//Processes the items of the segment whose index is below end.
+//Returns the number of processed items.
+unsigned PathBuilder::processSegment(PathSegment *seg, uint32_t end)
 {
     const PathFragmentList &fra = seg->getFragmentList();
     PathFragmentList::const_iterator it;
     s2e::plugins::ExecutionTraceItemHeader hdr;
     uint8_t *data;
+    unsigned count = 0;
 
     #ifdef DEBUG_PB
     std::cout << std::dec << "Processing segment of state " << seg->getStateId() << " ";
@@ -306,17 +902,38 @@ void PathBuilder::processSegment(PathSegment *seg)
         #ifdef DEBUG_PB
         std::cout << std::dec << "sid=" << seg->getStateId() <<  " frag(" << f.startIndex << "," << f.endIndex << ")"<< std::endl;
         #endif
-        for (uint32_t s = f.startIndex; s <= f.endIndex; ++s) {
+        for (uint32_t s = f.startIndex; s <= f.endIndex && s < end; ++s) {
             if (!m_Parser->getItem(s, hdr, (void**)&data)) {
                 assert(false && "Trace is broken");
             }
             #ifdef DEBUG_PB
             //std::cout << "T: " << (unsigned)hdr.type << std::endl;
             #endif
-            assert(hdr.stateId == seg->getStateId());
+            assert(getGlobalStateId(s, hdr.stateId) == seg->getStateId());
             processItem(s, hdr, data);
+            ++count;
         }
     }
+
+    return count;
+}
+
+//Copy the trace analyzer's state from the parent
+//to the specified segment.
+void PathBuilder::cloneParentState(PathSegment *seg)
+{
+    if (!seg->getParent()) {
+        return;
+    }
+
+    assert(seg->getStateMap().empty());
+    PathSegmentStateMap &pm = seg->getParent()->getStateMap();
+    PathSegmentStateMap &m = seg->getStateMap();
+
+    PathSegmentStateMap::iterator it;
+    for (it = pm.begin(); it != pm.end(); ++it) {
+        m[(*it).first] = (*it).second->clone();
+    }
 }
 
 bool PathBuilder::processPath(uint32_t pathId)
@@ -338,46 +955,83 @@ bool PathBuilder::processPath(uint32_t pathId)
 
     for (int i=segments.size()-1; i>=0; --i) {
         m_CurrentSegment = segments[i];
-
-        if (m_CurrentSegment->getParent()) {
-            //Copy the trace analyzer's state from the parent
-            //to the current segment.
-            assert(m_CurrentSegment->getStateMap().empty());
-            PathSegmentStateMap &pm = m_CurrentSegment->getParent()->getStateMap();
-            PathSegmentStateMap &m = m_CurrentSegment->getStateMap();
-
-            PathSegmentStateMap::iterator it;
-            for (it = pm.begin(); it != pm.end(); ++it) {
-                m[(*it).first] = (*it).second->clone();
-            }
-        }
-
+        cloneParentState(m_CurrentSegment);
         processSegment(segments[i]);
     }
 
     return true;
 }
 
-//Discards all segment-local information kept by trace processors.
-void PathBuilder::resetTree()
+//Concatenates the buffered output of all the segments from the root
+//to the leaf and hands it to the sink.
+void PathBuilder::writePathOutput(PathSegment *leaf, uint32_t pathId,
+                                  SegmentOutputs &buffers, PathOutputSink *sink)
 {
-    StateToSegments::iterator it;
+    std::vector<PathSegment*> segments;
+    for (PathSegment *seg = leaf; seg; seg = seg->getParent()) {
+        segments.push_back(seg);
+    }
 
-    for (it = m_Leaves.begin(); it != m_Leaves.end(); ++it) {
-        PathSegmentList &psl = (*it).second;
-        PathSegmentList::iterator pslit;
-        for(pslit = psl.begin(); pslit != psl.end(); ++pslit) {
-            PathSegment *ps = *pslit;
-            ps->deleteState();
+    std::ostream *os = sink->openPath(pathId);
+    if (os) {
+        for (int i=segments.size()-1; i>=0; --i) {
+            SegmentOutputs::iterator it = buffers.find(segments[i]);
+            assert(it != buffers.end());
+            const std::string &str = (*it).second->str();
+            os->write(str.data(), str.size());
         }
     }
+    sink->closePath(pathId, os);
 }
 
-void PathBuilder::processTree()
+/**
+ *  Processes the union of the specified paths in depth-first order.
+ *  Each segment is processed only once, no matter how many paths share it,
+ *  and its state is discarded as soon as all the selected paths below it
+ *  are done. Only the states of the leaves are kept.
+ *  If a sink is specified, the output of each path is handed to it once
+ *  the path is complete.
+ */
+bool PathBuilder::processPaths(const PathSet &paths, PathOutputSink *sink)
 {
-    ExecutionPath currentPath;
-    std::stack<PathSegment*> s;
+    resetTree();
 
+    //Count for each segment how many of its children lie on the selected paths
+    SegmentRefCounts refCounts;
+    std::map<PathSegment*, uint32_t> leaves;
+    bool foundAll = true;
+
+    PathSet::const_iterator pit;
+    for (pit = paths.begin(); pit != paths.end(); ++pit) {
+        StateToSegments::iterator it = m_Leaves.find(*pit);
+        if (it == m_Leaves.end()) {
+            foundAll = false;
+            continue;
+        }
+
+        PathSegment *seg = (*it).second.back();
+        leaves[seg] = *pit;
+        refCounts[seg] = 0;
+
+        while (seg->getParent()) {
+            PathSegment *parent = seg->getParent();
+            bool known = refCounts.find(parent) != refCounts.end();
+            ++refCounts[parent];
+            if (known) {
+                break;
+            }
+            seg = parent;
+        }
+    }
+
+    if (refCounts.empty()) {
+        return foundAll;
+    }
+
+    SegmentOutputs buffers;
+    std::streambuf *prevOutput = m_Output.rdbuf();
+
+    std::stack<PathSegment*> s;
     s.push(m_Root);
 
     while(s.size()>0) {
@@ -385,18 +1039,12 @@ void PathBuilder::processTree()
         m_CurrentSegment = curSeg;
         s.pop();
 
-        if (curSeg->getParent()) {
-            //Copy the trace analyzer's state from the parent
-            //to the current segment. This assumes that we process segments in
-            //depth-first order.
-            assert(curSeg->getStateMap().empty());
-            PathSegmentStateMap &pm = curSeg->getParent()->getStateMap();
-            PathSegmentStateMap &m = curSeg->getStateMap();
+        cloneParentState(curSeg);
 
-            PathSegmentStateMap::iterator it;
-            for (it = pm.begin(); it != pm.end(); ++it) {
-                m[(*it).first] = (*it).second->clone();
-            }
+        if (sink) {
+            std::stringbuf *buf = new std::stringbuf();
+            buffers[curSeg] = buf;
+            m_Output.rdbuf(buf);
         }
 
         processSegment(curSeg);
@@ -404,13 +1052,723 @@ void PathBuilder::processTree()
         const PathSegmentList &children = curSeg->getChildren();
         PathSegmentList::const_iterator it;
 
-        //assert(children.size() == 0 || children.size() == 2);
-
-        if (children.size() > 0) {
-            for (it = children.begin(); it != children.end(); ++it) {
+        for (it = children.begin(); it != children.end(); ++it) {
+            if (refCounts.find(*it) != refCounts.end()) {
                 s.push(*it);
             }
         }
+
+        std::map<PathSegment*, uint32_t>::iterator lit = leaves.find(curSeg);
+        if (lit == leaves.end()) {
+            continue;
+        }
+
+        if (sink) {
+            writePathOutput(curSeg, (*lit).second, buffers, sink);
+        }
+
+        //Release the prefixes that are not needed anymore
+        PathSegment *seg = curSeg;
+        while (seg) {
+            if (refCounts[seg] > 0) {
+                break;
+            }
+
+            if (seg != curSeg) {
+                seg->deleteState();
+            }
+
+            SegmentOutputs::iterator bit = buffers.find(seg);
+            if (bit != buffers.end()) {
+                delete (*bit).second;
+                buffers.erase(bit);
+            }
+
+            seg = seg->getParent();
+            if (seg) {
+                --refCounts[seg];
+            }
+        }
+    }
+
+    assert(buffers.empty());
+    m_Output.rdbuf(prevOutput);
+
+    return foundAll;
+}
+
+//Discards all segment-local information kept by trace processors.
+void PathBuilder::resetTree()
+{
+    StateToSegments::iterator it;
+
+    for (it = m_Leaves.begin(); it != m_Leaves.end(); ++it) {
+        PathSegmentList &psl = (*it).second;
+        PathSegmentList::iterator pslit;
+        for(pslit = psl.begin(); pslit != psl.end(); ++pslit) {
+            PathSegment *ps = *pslit;
+            ps->deleteState();
+        }
+    }
+
+    resetMemoryAccounting();
+}
+
+bool PathBuilder::processTree()
+{
+    PathSegmentList pending;
+    pending.push_back(m_Root);
+    resetMemoryAccounting();
+    return processPending(pending);
+}
+
+//Depth-first traversal of the segments. The last element
+//of pending is processed first. Stops when spilled states are lost.
+bool PathBuilder::processPending(PathSegmentList &pending)
+{
+    m_ItemsSinceSnapshot = 0;
+
+    while(pending.size()>0 && !m_ReloadFailed) {
+        PathSegment *curSeg = pending.back();
+        m_CurrentSegment = curSeg;
+        pending.pop_back();
+
+        //This assumes that we process segments in depth-first order.
+        cloneParentState(curSeg);
+
+        m_ItemsSinceSnapshot += processSegment(curSeg);
+
+        const PathSegmentList &children = curSeg->getChildren();
+
+        //assert(children.size() == 0 || children.size() == 2);
+
+        pending.insert(pending.end(), children.begin(), children.end());
+
+        if (m_Accounting) {
+            accountState(curSeg);
+            enforceMemoryBudget(pending);
+        }
+
+        if (m_SnapshotInterval && m_ItemsSinceSnapshot >= m_SnapshotInterval) {
+            if (!saveSnapshot(pending)) {
+                std::cerr << "Snapshots disabled" << std::endl;
+                m_SnapshotInterval = 0;
+            }
+            m_ItemsSinceSnapshot = 0;
+        }
+    }
+
+    return !m_ReloadFailed;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static const char SNAPSHOT_MAGIC[8] = {'S', '2', 'E', 'S', 'N', 'A', 'P', '1'};
+
+void PathBuilder::registerProcessor(const std::string &name, void *processor,
+                                    ItemProcessorStateFactory f)
+{
+    SnapshotProcessor &sp = m_SnapshotProcessors[processor];
+    sp.name = name;
+    sp.factory = f;
+}
+
+void PathBuilder::enableSnapshots(const std::string &file, unsigned interval)
+{
+    m_SnapshotFile = file;
+    m_SnapshotInterval = interval;
+}
+
+//Snapshots refer to segments by their rank in depth-first order
+void PathBuilder::numberSegments(PathSegmentList &order) const
+{
+    PathSegmentList s;
+    s.push_back(m_Root);
+
+    order.clear();
+    while (!s.empty()) {
+        PathSegment *seg = s.back();
+        s.pop_back();
+        order.push_back(seg);
+
+        const PathSegmentList &children = seg->getChildren();
+        s.insert(s.end(), children.rbegin(), children.rend());
+    }
+}
+
+//Saves the traversal stack, the states of the processed leaves,
+//and the states of the segments from which the pending ones are cloned.
+//The snapshot is written to a temporary file first, so that an interruption
+//does not destroy the previous snapshot.
+bool PathBuilder::saveSnapshot(const PathSegmentList &pending)
+{
+    PathSegmentList order;
+    numberSegments(order);
+
+    std::map<PathSegment*, uint32_t> ids;
+    for (unsigned i = 0; i < order.size(); ++i) {
+        ids[order[i]] = i;
+    }
+
+    std::set<PathSegment*> parents;
+    PathSegmentList::const_iterator pit;
+    for (pit = pending.begin(); pit != pending.end(); ++pit) {
+        parents.insert((*pit)->getParent());
+    }
+
+    std::string tmpFile = m_SnapshotFile + ".tmp";
+    std::ofstream os(tmpFile.c_str(), std::ios::binary);
+    if (!os) {
+        std::cerr << "Could not open " << tmpFile << std::endl;
+        return false;
+    }
+
+    os.write(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    writeValue(os, (uint32_t)m_Parser->getItemCount());
+    writeValue(os, (uint32_t)order.size());
+
+    writeValue(os, (uint32_t)pending.size());
+    for (pit = pending.begin(); pit != pending.end(); ++pit) {
+        writeValue(os, ids[*pit]);
+    }
+
+    PathSegmentList saved;
+    for (unsigned i = 0; i < order.size(); ++i) {
+        PathSegment *seg = order[i];
+        if (!seg->isSpilled() && seg->getStateMap().empty()) {
+            continue;
+        }
+        if (seg->getChildren().empty() || parents.count(seg)) {
+            saved.push_back(seg);
+        }
+    }
+
+    writeValue(os, (uint32_t)saved.size());
+    for (pit = saved.begin(); pit != saved.end(); ++pit) {
+        SavedStates states;
+        if (!saveState(*pit, states)) {
+            std::cerr << "Snapshot: the state of a trace processor is not registered or cannot be saved"
+                      << std::endl;
+            return false;
+        }
+
+        writeValue(os, ids[*pit]);
+        writeValue(os, (uint32_t)states.size());
+
+        SavedStates::const_iterator it;
+        for (it = states.begin(); it != states.end(); ++it) {
+            writeString(os, (*it).first);
+            writeString(os, (*it).second);
+        }
+    }
+
+    os.close();
+    if (!os) {
+        std::cerr << "Could not write " << tmpFile << std::endl;
+        return false;
+    }
+
+    if (rename(tmpFile.c_str(), m_SnapshotFile.c_str()) < 0) {
+        std::cerr << "Could not rename " << tmpFile << " to " << m_SnapshotFile << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool PathBuilder::readSnapshot(const std::string &file, const PathSegmentList &order,
+                               PathSegmentList &pending, SavedSegmentStates &states)
+{
+    std::ifstream is(file.c_str(), std::ios::binary);
+    if (!is) {
+        std::cerr << "Could not open " << file << std::endl;
+        return false;
+    }
+
+    char magic[sizeof(SNAPSHOT_MAGIC)];
+    if (!is.read(magic, sizeof(magic)) || memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic))) {
+        std::cerr << file << " is not a snapshot" << std::endl;
+        return false;
+    }
+
+    uint32_t itemCount, segmentCount;
+    if (!readValue(is, itemCount) || !readValue(is, segmentCount)) {
+        return false;
+    }
+
+    if (itemCount != m_Parser->getItemCount() || segmentCount != order.size()) {
+        std::cerr << file << " was taken on a different trace" << std::endl;
+        return false;
+    }
+
+    uint32_t count, id;
+    if (!readValue(is, count)) {
+        return false;
+    }
+
+    pending.clear();
+    for (uint32_t i = 0; i < count; ++i) {
+        if (!readValue(is, id) || id >= order.size()) {
+            return false;
+        }
+        pending.push_back(order[id]);
+    }
+
+    if (!readValue(is, count)) {
+        return false;
+    }
+
+    states.clear();
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t stateCount;
+        if (!readValue(is, id) || id >= order.size() || !readValue(is, stateCount)) {
+            return false;
+        }
+
+        SavedStates &saved = states[id];
+        for (uint32_t j = 0; j < stateCount; ++j) {
+            SavedState s;
+            if (!readString(is, s.first) || !readString(is, s.second)) {
+                return false;
+            }
+            saved.push_back(s);
+        }
+    }
+
+    return true;
+}
+
+//States of processors that are not registered in this run are ignored
+bool PathBuilder::restoreState(PathSegment *seg, const SavedStates &saved)
+{
+    seg->deleteState();
+    PathSegmentStateMap &m = seg->getStateMap();
+
+    SavedStates::const_iterator it;
+    for (it = saved.begin(); it != saved.end(); ++it) {
+        SnapshotProcessors::const_iterator spit;
+        for (spit = m_SnapshotProcessors.begin(); spit != m_SnapshotProcessors.end(); ++spit) {
+            if ((*spit).second.name == (*it).first) {
+                break;
+            }
+        }
+
+        if (spit == m_SnapshotProcessors.end()) {
+            continue;
+        }
+
+        ItemProcessorState *state = (*spit).second.factory();
+        std::istringstream ss((*it).second);
+        if (!state->deserialize(ss)) {
+            std::cerr << "Snapshot: could not restore the state of " << (*it).first << std::endl;
+            delete state;
+            return false;
+        }
+        m[(*spit).first] = state;
+    }
+
+    return true;
+}
+
+//Serialized states of the segment, which must all belong to registered processors.
+//Spilled states are read from the scratch file without being reloaded.
+bool PathBuilder::saveState(PathSegment *seg, SavedStates &saved)
+{
+    saved.clear();
+
+    if (seg->isSpilled()) {
+        SpillLocations::const_iterator it = m_SpillLocations.find(seg);
+        assert(it != m_SpillLocations.end());
+
+        std::string data((*it).second.second, 0);
+        m_SpillFile.seekg((*it).second.first);
+        if (!m_SpillFile.read(&data[0], data.size())) {
+            return false;
+        }
+
+        std::istringstream is(data);
+        uint32_t count;
+        if (!readValue(is, count)) {
+            return false;
+        }
+
+        for (uint32_t i = 0; i < count; ++i) {
+            SavedState s;
+            if (!readString(is, s.first) || !readString(is, s.second)) {
+                return false;
+            }
+            saved.push_back(s);
+        }
+        return true;
+    }
+
+    const PathSegmentStateMap &m = seg->getStateMap();
+    PathSegmentStateMap::const_iterator it;
+    for (it = m.begin(); it != m.end(); ++it) {
+        SnapshotProcessors::const_iterator spit = m_SnapshotProcessors.find((*it).first);
+        if (spit == m_SnapshotProcessors.end()) {
+            return false;
+        }
+
+        std::ostringstream ss;
+        if (!(*it).second->serialize(ss)) {
+            return false;
+        }
+
+        saved.push_back(SavedState((*spit).second.name, ss.str()));
+    }
+
+    return true;
+}
+
+bool PathBuilder::resumeTree(const std::string &file)
+{
+    PathSegmentList order, pending;
+    SavedSegmentStates states;
+
+    resetTree();
+    numberSegments(order);
+
+    if (!readSnapshot(file, order, pending, states)) {
+        return false;
+    }
+
+    SavedSegmentStates::const_iterator it;
+    for (it = states.begin(); it != states.end(); ++it) {
+        if (!restoreState(order[(*it).first], (*it).second)) {
+            return false;
+        }
+        if (m_Accounting) {
+            accountState(order[(*it).first]);
+        }
+    }
+
+    return processPending(pending);
+}
+
+bool PathBuilder::seekItem(uint32_t itemIndex, const std::string &snapshotFile)
+{
+    PathSegmentList order;
+    PathSegment *target = NULL;
+
+    resetTree();
+    numberSegments(order);
+
+    for (unsigned i = 0; i < order.size() && !target; ++i) {
+        const PathFragmentList &fra = order[i]->getFragmentList();
+        PathFragmentList::const_iterator it;
+        for (it = fra.begin(); it != fra.end(); ++it) {
+            if ((*it).startIndex <= itemIndex && itemIndex <= (*it).endIndex) {
+                target = order[i];
+                break;
+            }
+        }
+    }
+
+    if (!target) {
+        return false;
+    }
+
+    std::vector<PathSegment*> segments;
+    for (PathSegment *seg = target; seg; seg = seg->getParent()) {
+        segments.push_back(seg);
+    }
+
+    //Index of the first segment to replay
+    int first = segments.size() - 1;
+
+    if (!snapshotFile.empty()) {
+        PathSegmentList pending;
+        SavedSegmentStates states;
+        if (!readSnapshot(snapshotFile, order, pending, states)) {
+            return false;
+        }
+
+        std::map<PathSegment*, uint32_t> ids;
+        for (unsigned i = 0; i < order.size(); ++i) {
+            ids[order[i]] = i;
+        }
+
+        //The saved state of a segment is the one at its end,
+        //only the ancestors of the target can be used
+        for (unsigned i = 1; i < segments.size(); ++i) {
+            SavedSegmentStates::const_iterator it = states.find(ids[segments[i]]);
+            if (it != states.end()) {
+                if (!restoreState(segments[i], (*it).second)) {
+                    return false;
+                }
+                first = i - 1;
+                break;
+            }
+        }
+    }
+
+    for (int i = first; i > 0; --i) {
+        m_CurrentSegment = segments[i];
+        cloneParentState(m_CurrentSegment);
+        processSegment(m_CurrentSegment);
+    }
+
+    m_CurrentSegment = target;
+    cloneParentState(target);
+    processSegment(target, itemIndex);
+
+    m_SeekIndex = itemIndex;
+    return true;
+}
+
+unsigned PathBuilder::stepItems(unsigned count)
+{
+    const PathFragmentList &fra = m_CurrentSegment->getFragmentList();
+    PathFragmentList::const_iterator it;
+    s2e::plugins::ExecutionTraceItemHeader hdr;
+    uint8_t *data;
+    unsigned processed = 0;
+
+    for (it = fra.begin(); it != fra.end() && processed < count; ++it) {
+        const PathFragment &f = (*it);
+        uint32_t s = std::max(f.startIndex, m_SeekIndex);
+        for (; s <= f.endIndex && processed < count; ++s) {
+            if (!m_Parser->getItem(s, hdr, (void**)&data)) {
+                assert(false && "Trace is broken");
+            }
+            processItem(s, hdr, data);
+            ++processed;
+            m_SeekIndex = s + 1;
+        }
+    }
+
+    return processed;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void PathBuilder::setMemoryBudget(uint64_t budget, const std::string &spillFile)
+{
+    m_Accounting = true;
+    m_MemoryBudget = budget;
+    m_SpillFileName = spillFile;
+}
+
+void PathBuilder::resetMemoryAccounting()
+{
+    m_ResidentBytes = 0;
+    m_SegmentMemory.clear();
+    m_ResidentSegments.clear();
+    m_SpillLocations.clear();
+    m_SpillEnd = 0;
+    m_ReloadFailed = false;
+
+    ProcessorMemoryMap::iterator it;
+    for (it = m_ProcessorMemory.begin(); it != m_ProcessorMemory.end(); ++it) {
+        ProcessorMemory &pm = (*it).second;
+        pm.residentStates = pm.residentBytes = 0;
+        pm.spilledStates = pm.spilledBytes = 0;
+    }
+}
+
+//Adds the resident states of the segment to the accounting.
+//States that do not know their size are measured by serializing them.
+void PathBuilder::accountState(PathSegment *seg)
+{
+    const PathSegmentStateMap &m = seg->getStateMap();
+    if (m.empty() || m_SegmentMemory.count(seg)) {
+        return;
+    }
+
+    SegmentMemory &sm = m_SegmentMemory[seg];
+    sm.spillable = true;
+
+    PathSegmentStateMap::const_iterator it;
+    for (it = m.begin(); it != m.end(); ++it) {
+        ProcessorMemory &pm = m_ProcessorMemory[(*it).first];
+        uint64_t bytes = (*it).second->getMemoryUsage();
+
+        if (!bytes) {
+            std::ostringstream ss;
+            if ((*it).second->serialize(ss)) {
+                bytes = ss.str().size();
+            } else {
+                ++pm.unsizedStates;
+                sm.spillable = false;
+            }
+        }
+
+        if (!m_SnapshotProcessors.count((*it).first)) {
+            sm.spillable = false;
+        }
+
+        ++pm.residentStates;
+        pm.residentBytes += bytes;
+        if (pm.residentBytes > pm.peakBytes) {
+            pm.peakBytes = pm.residentBytes;
+        }
+
+        m_ResidentBytes += bytes;
+        sm.states.push_back(std::make_pair((*it).first, bytes));
+    }
+
+    if (m_ResidentBytes > m_PeakBytes) {
+        m_PeakBytes = m_ResidentBytes;
+    }
+
+    if (sm.spillable) {
+        m_ResidentSegments.push_back(seg);
+    }
+}
+
+//Spills the oldest resident states until the budget is met.
+//The current segment and the one the next pending segment clones from stay resident.
+void PathBuilder::enforceMemoryBudget(const PathSegmentList &pending)
+{
+    if (!m_MemoryBudget) {
+        return;
+    }
+
+    PathSegment *next = pending.empty() ? NULL : pending.back()->getParent();
+    size_t count = m_ResidentSegments.size();
+
+    while (m_ResidentBytes > m_MemoryBudget && count > 0) {
+        PathSegment *seg = m_ResidentSegments.front();
+        m_ResidentSegments.pop_front();
+        --count;
+
+        if (!m_SegmentMemory.count(seg)) {
+            continue;
+        }
+
+        if (seg == m_CurrentSegment || seg == next) {
+            m_ResidentSegments.push_back(seg);
+            continue;
+        }
+
+        if (!spillState(seg)) {
+            std::cerr << "Could not spill processor states to " << m_SpillFileName << std::endl;
+            m_MemoryBudget = 0;
+            return;
+        }
+    }
+}
+
+//Returns false on I/O errors. States sized by getMemoryUsage() may turn out
+//not to be serializable, their segment then stays resident.
+bool PathBuilder::spillState(PathSegment *seg)
+{
+    SavedStates saved;
+    if (!saveState(seg, saved)) {
+        return true;
+    }
+
+    if (!m_SpillFile.is_open()) {
+        m_SpillFile.open(m_SpillFileName.c_str(),
+                         std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+        if (!m_SpillFile.is_open()) {
+            return false;
+        }
+        m_SpillEnd = 0;
+    }
+
+    std::ostringstream os;
+    writeValue(os, (uint32_t)saved.size());
+    SavedStates::const_iterator it;
+    for (it = saved.begin(); it != saved.end(); ++it) {
+        writeString(os, (*it).first);
+        writeString(os, (*it).second);
+    }
+
+    //The space of reloaded states is not reused
+    std::string data = os.str();
+    m_SpillFile.seekp(m_SpillEnd);
+    if (!m_SpillFile.write(data.data(), data.size())) {
+        return false;
+    }
+
+    m_SpillLocations[seg] = std::make_pair(m_SpillEnd, (uint32_t)data.size());
+    m_SpillEnd += data.size();
+
+    SegmentMemoryMap::iterator smit = m_SegmentMemory.find(seg);
+    const SegmentMemory &sm = (*smit).second;
+    for (unsigned i = 0; i < sm.states.size(); ++i) {
+        ProcessorMemory &pm = m_ProcessorMemory[sm.states[i].first];
+        --pm.residentStates;
+        pm.residentBytes -= sm.states[i].second;
+        ++pm.spilledStates;
+        pm.spilledBytes += sm.states[i].second;
+        m_ResidentBytes -= sm.states[i].second;
+    }
+    m_SegmentMemory.erase(smit);
+
+    seg->deleteState();
+    seg->setSpilled(this);
+    return true;
+}
+
+//The states are accessed from the processors, which cannot handle a failure.
+//They get empty states instead and processPending() stops after the segment.
+void PathBuilder::reloadState(PathSegment *seg)
+{
+    SavedStates saved;
+
+    //restoreState() clears the spilled flag
+    if (!saveState(seg, saved) || !restoreState(seg, saved)) {
+        std::cerr << "Could not reload the processor states of segment " << seg->getStateId()
+                  << " from " << m_SpillFileName << std::endl;
+        m_ReloadFailed = true;
+        m_SpillLocations.erase(seg);
+        seg->deleteState();
+        return;
+    }
+
+    m_SpillLocations.erase(seg);
+    accountState(seg);
+
+    SegmentMemoryMap::const_iterator it = m_SegmentMemory.find(seg);
+    if (it == m_SegmentMemory.end()) {
+        return;
+    }
+
+    const SegmentMemory &sm = (*it).second;
+    for (unsigned i = 0; i < sm.states.size(); ++i) {
+        ProcessorMemory &pm = m_ProcessorMemory[sm.states[i].first];
+        --pm.spilledStates;
+        pm.spilledBytes -= sm.states[i].second;
+        ++pm.reloads;
+    }
+}
+
+namespace {
+struct ProcessorMemoryByPeak {
+    bool operator()(const std::pair<std::string, ProcessorMemory> &p1,
+                    const std::pair<std::string, ProcessorMemory> &p2) const {
+        return p1.second.peakBytes > p2.second.peakBytes;
+    }
+};
+}
+
+void PathBuilder::printMemoryReport(std::ostream &os) const
+{
+    std::vector<std::pair<std::string, ProcessorMemory> > usage;
+
+    ProcessorMemoryMap::const_iterator it;
+    for (it = m_ProcessorMemory.begin(); it != m_ProcessorMemory.end(); ++it) {
+        SnapshotProcessors::const_iterator spit = m_SnapshotProcessors.find((*it).first);
+        std::string name = spit == m_SnapshotProcessors.end() ? "<unregistered>" : (*spit).second.name;
+        usage.push_back(std::make_pair(name, (*it).second));
+    }
+
+    std::sort(usage.begin(), usage.end(), ProcessorMemoryByPeak());
+
+    os << std::dec;
+    os << "#Memory used by the processor states (estimated or serialized sizes)" << std::endl;
+    os << "#Budget: " << m_MemoryBudget << " Resident: " << m_ResidentBytes
+       << " Peak: " << m_PeakBytes << " Spill file: " << m_SpillEnd << std::endl;
+    os << "#Processor ResidentStates ResidentBytes PeakBytes SpilledStates SpilledBytes Reloads UnsizedStates" << std::endl;
+
+    for (unsigned i = 0; i < usage.size(); ++i) {
+        const ProcessorMemory &pm = usage[i].second;
+        os << usage[i].first << " " << pm.residentStates << " " << pm.residentBytes << " "
+           << pm.peakBytes << " " << pm.spilledStates << " " << pm.spilledBytes << " "
+           << pm.reloads << " " << pm.unsizedStates << std::endl;
     }
 }
 
@@ -0,0 +1,394 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <stack>
+#include <cassert>
+#include <cstring>
+
+#include <lib/BinaryReaders/Library.h>
+
+#include "PathIndex.h"
+#include "Path.h"
+
+using namespace s2e::plugins;
+
+namespace s2etools
+{
+
+static const char PATHINDEX_MAGIC[8] = {'S', '2', 'E', 'P', 'I', 'D', 'X', '2'};
+
+PathIndex::PathIndex()
+{
+    m_events = NULL;
+    m_cache = NULL;
+}
+
+PathIndex::PathIndex(LogEvents *events, ModuleCache *cache)
+{
+    m_events = events;
+    m_cache = cache;
+    m_connection = events->onEachItem.connect(
+            sigc::mem_fun(*this, &PathIndex::onItem));
+}
+
+PathIndex::~PathIndex()
+{
+    m_connection.disconnect();
+}
+
+//Range of module ids to look up, an empty name matches all of them
+bool PathIndex::findModules(const std::string &name, ModuleId &first, ModuleId &last) const
+{
+    if (m_Modules.empty()) {
+        return false;
+    }
+
+    if (name.empty()) {
+        first = *m_Modules.begin();
+        last = *m_Modules.rbegin() + 1;
+        return true;
+    }
+
+    if (!ModuleNames::find(name, first) || !m_Modules.count(first)) {
+        return false;
+    }
+    last = first + 1;
+    return true;
+}
+
+void PathIndex::onItem(unsigned traceIndex,
+            const s2e::plugins::ExecutionTraceItemHeader &hdr,
+            void *item)
+{
+    if (hdr.type != s2e::plugins::TRACE_TB_START) {
+        return;
+    }
+
+    const ExecutionTraceTb *te = static_cast<const ExecutionTraceTb*>(item);
+
+    ModuleCacheState *mcs = static_cast<ModuleCacheState*>(m_events->getState(m_cache, &ModuleCacheState::factory));
+    PathIndexState *state = static_cast<PathIndexState*>(m_events->getState(this, &PathIndexState::factory));
+
+    const ModuleInstance *mi = mcs->getInstance(hdr.pid, te->pc);
+
+    //Blocks outside of known modules are indexed by absolute pc
+    if (mi) {
+        uint64_t relPc = te->pc - mi->LoadBase + mi->ImageBase;
+        state->m_Pcs.insert(PcKey(mi->Id, relPc));
+    } else {
+        state->m_Pcs.insert(PcKey(ModuleNames::NoModule, te->pc));
+    }
+}
+
+/**
+ *  The paths that executed a block are the leaves below the segments
+ *  that executed it. The tree is traversed in post-order, so that
+ *  the leaves of a segment are computed from those of its children.
+ */
+void PathIndex::build(PathBuilder *pb, Library *library)
+{
+    std::map<const PathSegment*, PathBitmap> leaves;
+    std::stack<std::pair<const PathSegment*, bool> > s;
+
+    s.push(std::make_pair(pb->getRoot(), false));
+
+    while (!s.empty()) {
+        const PathSegment *seg = s.top().first;
+        const PathSegmentList &children = seg->getChildren();
+
+        if (!s.top().second) {
+            s.top().second = true;
+            PathSegmentList::const_iterator it;
+            for (it = children.begin(); it != children.end(); ++it) {
+                s.push(std::make_pair(*it, false));
+            }
+            continue;
+        }
+
+        s.pop();
+
+        PathBitmap &paths = leaves[seg];
+        if (children.empty()) {
+            paths.add(seg->getStateId());
+            m_AllPaths.add(seg->getStateId());
+        } else {
+            PathSegmentList::const_iterator it;
+            for (it = children.begin(); it != children.end(); ++it) {
+                std::map<const PathSegment*, PathBitmap>::iterator lit = leaves.find(*it);
+                paths.unite((*lit).second);
+                leaves.erase(lit);
+            }
+        }
+
+        const PathSegmentStateMap &states = seg->getStateMap();
+        PathSegmentStateMap::const_iterator sit = states.find(this);
+        if (sit == states.end()) {
+            continue;
+        }
+
+        const PathIndexState *state = static_cast<const PathIndexState*>((*sit).second);
+        std::set<PcKey>::const_iterator pit;
+        for (pit = state->m_Pcs.begin(); pit != state->m_Pcs.end(); ++pit) {
+            m_PcPaths[*pit].unite(paths);
+        }
+    }
+
+    PcPaths::const_iterator it;
+    for (it = m_PcPaths.begin(); it != m_PcPaths.end(); ++it) {
+        m_Modules.insert((*it).first.first);
+    }
+
+    if (!library) {
+        return;
+    }
+
+    //Symbolize each block once, with one lookup pass per module
+    Library::SymbolQueries queries;
+    queries.reserve(m_PcPaths.size());
+    for (it = m_PcPaths.begin(); it != m_PcPaths.end(); ++it) {
+        queries.push_back(Library::SymbolQuery((*it).first.first, (*it).first.second));
+    }
+
+    library->getInfoBatch(queries);
+
+    unsigned i = 0;
+    for (it = m_PcPaths.begin(); it != m_PcPaths.end(); ++it, ++i) {
+        const Library::SymbolQuery &q = queries[i];
+        if (!q.Found || q.Function.empty()) {
+            continue;
+        }
+
+        m_FunctionPaths[FunctionKey(q.Module, q.Function)].unite((*it).second);
+    }
+}
+
+bool PathIndex::save(const std::string &fileName) const
+{
+    std::ofstream os(fileName.c_str(), std::ios::binary);
+    if (!os) {
+        std::cerr << "Could not open " << fileName << std::endl;
+        return false;
+    }
+
+    os.write(PATHINDEX_MAGIC, sizeof(PATHINDEX_MAGIC));
+
+    //Module ids are only valid in this process, the names map them back on load
+    uint32_t count = m_Modules.size();
+    os.write((const char*)&count, sizeof(count));
+    std::set<ModuleId>::const_iterator mit;
+    for (mit = m_Modules.begin(); mit != m_Modules.end(); ++mit) {
+        os.write((const char*)&*mit, sizeof(ModuleId));
+        writeString(os, ModuleNames::getName(*mit));
+    }
+
+    m_AllPaths.serialize(os);
+
+    count = m_PcPaths.size();
+    os.write((const char*)&count, sizeof(count));
+    PcPaths::const_iterator pit;
+    for (pit = m_PcPaths.begin(); pit != m_PcPaths.end(); ++pit) {
+        os.write((const char*)&(*pit).first.first, sizeof(uint32_t));
+        os.write((const char*)&(*pit).first.second, sizeof(uint64_t));
+        (*pit).second.serialize(os);
+    }
+
+    count = m_FunctionPaths.size();
+    os.write((const char*)&count, sizeof(count));
+    FunctionPaths::const_iterator fit;
+    for (fit = m_FunctionPaths.begin(); fit != m_FunctionPaths.end(); ++fit) {
+        os.write((const char*)&(*fit).first.first, sizeof(uint32_t));
+        writeString(os, (*fit).first.second);
+        (*fit).second.serialize(os);
+    }
+
+    return os.good();
+}
+
+bool PathIndex::load(const std::string &fileName)
+{
+    std::ifstream is(fileName.c_str(), std::ios::binary);
+    if (!is) {
+        std::cerr << "Could not open " << fileName << std::endl;
+        return false;
+    }
+
+    char magic[sizeof(PATHINDEX_MAGIC)];
+    if (!is.read(magic, sizeof(magic)) || memcmp(magic, PATHINDEX_MAGIC, sizeof(magic))) {
+        std::cerr << fileName << " is not a path index" << std::endl;
+        return false;
+    }
+
+    m_Modules.clear();
+    m_PcPaths.clear();
+    m_FunctionPaths.clear();
+
+    uint32_t count;
+    if (!is.read((char*)&count, sizeof(count))) {
+        return false;
+    }
+
+    //Ids of the file to ids of this process
+    std::map<ModuleId, ModuleId> ids;
+    for (uint32_t i = 0; i < count; ++i) {
+        ModuleId fileId;
+        std::string name;
+        if (!is.read((char*)&fileId, sizeof(fileId)) || !readString(is, name)) {
+            std::cerr << fileName << " is corrupted" << std::endl;
+            return false;
+        }
+        ModuleId id = ModuleNames::intern(name);
+        ids[fileId] = id;
+        m_Modules.insert(id);
+    }
+
+    if (!m_AllPaths.deserialize(is)) {
+        return false;
+    }
+
+    if (!is.read((char*)&count, sizeof(count))) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        PcKey key;
+        is.read((char*)&key.first, sizeof(key.first));
+        is.read((char*)&key.second, sizeof(key.second));
+        std::map<ModuleId, ModuleId>::const_iterator iit = ids.find(key.first);
+        if (!is || iit == ids.end()) {
+            std::cerr << fileName << " is corrupted" << std::endl;
+            return false;
+        }
+        key.first = (*iit).second;
+        if (!m_PcPaths[key].deserialize(is)) {
+            std::cerr << fileName << " is corrupted" << std::endl;
+            return false;
+        }
+    }
+
+    if (!is.read((char*)&count, sizeof(count))) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        FunctionKey key;
+        is.read((char*)&key.first, sizeof(key.first));
+        std::map<ModuleId, ModuleId>::const_iterator iit = ids.find(key.first);
+        if (!is || iit == ids.end() || !readString(is, key.second)) {
+            std::cerr << fileName << " is corrupted" << std::endl;
+            return false;
+        }
+        key.first = (*iit).second;
+        if (!m_FunctionPaths[key].deserialize(is)) {
+            std::cerr << fileName << " is corrupted" << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool PathIndex::getPcPaths(const std::string &module, uint64_t relPc, PathBitmap &paths) const
+{
+    bool found = false;
+    ModuleId first, last;
+    paths.clear();
+
+    if (!findModules(module, first, last)) {
+        return false;
+    }
+
+    std::set<ModuleId>::const_iterator mit;
+    for (mit = m_Modules.lower_bound(first); mit != m_Modules.end() && *mit < last; ++mit) {
+        PcPaths::const_iterator it = m_PcPaths.find(PcKey(*mit, relPc));
+        if (it != m_PcPaths.end()) {
+            paths.unite((*it).second);
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+bool PathIndex::getFunctionPaths(const std::string &module, const std::string &function,
+                                 PathBitmap &paths) const
+{
+    bool found = false;
+    ModuleId first, last;
+    paths.clear();
+
+    if (!findModules(module, first, last)) {
+        return false;
+    }
+
+    std::set<ModuleId>::const_iterator mit;
+    for (mit = m_Modules.lower_bound(first); mit != m_Modules.end() && *mit < last; ++mit) {
+        FunctionPaths::const_iterator it = m_FunctionPaths.find(FunctionKey(*mit, function));
+        if (it != m_FunctionPaths.end()) {
+            paths.unite((*it).second);
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+ItemProcessorState *PathIndexState::factory()
+{
+    return new PathIndexState();
+}
+
+PathIndexState::PathIndexState()
+{
+
+}
+
+PathIndexState::~PathIndexState()
+{
+
+}
+
+//Each segment only records its own blocks
+ItemProcessorState *PathIndexState::clone() const
+{
+    return new PathIndexState();
+}
+
+}
@@ -0,0 +1,146 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#ifndef S2ETOOLS_EXECTRACER_PATHINDEX_H
+#define S2ETOOLS_EXECTRACER_PATHINDEX_H
+
+#include <s2e/Plugins/ExecutionTracers/TraceEntries.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+#include "LogParser.h"
+#include "ModuleParser.h"
+#include "PathBitmap.h"
+
+namespace s2etools
+{
+
+class PathBuilder;
+class Library;
+
+/**
+ *  Inverted index from program locations to the paths that executed them.
+ *  Records the translation blocks executed by each segment while the
+ *  PathBuilder processes the tree, then propagates the leaves of each
+ *  segment to the blocks it executed. Locations are module-relative pcs
+ *  and, if a library is available, function names.
+ */
+class PathIndex
+{
+public:
+    //Module id and module-relative pc
+    typedef std::pair<ModuleId, uint64_t> PcKey;
+
+    //Module id and function name
+    typedef std::pair<ModuleId, std::string> FunctionKey;
+
+    typedef std::map<PcKey, PathBitmap> PcPaths;
+    typedef std::map<FunctionKey, PathBitmap> FunctionPaths;
+
+private:
+    LogEvents *m_events;
+    ModuleCache *m_cache;
+    sigc::connection m_connection;
+
+    //Modules of the indexed blocks, NoModule for blocks outside of them
+    std::set<ModuleId> m_Modules;
+
+    PcPaths m_PcPaths;
+    FunctionPaths m_FunctionPaths;
+    PathBitmap m_AllPaths;
+
+    void onItem(unsigned traceIndex,
+                const s2e::plugins::ExecutionTraceItemHeader &hdr,
+                void *item);
+
+    bool findModules(const std::string &name, ModuleId &first, ModuleId &last) const;
+
+public:
+    //Use this to load an existing index
+    PathIndex();
+    PathIndex(LogEvents *events, ModuleCache *cache);
+    ~PathIndex();
+
+    //Must be called once pb processed the whole tree
+    void build(PathBuilder *pb, Library *library);
+
+    bool save(const std::string &fileName) const;
+    bool load(const std::string &fileName);
+
+    //An empty module name matches any module
+    bool getPcPaths(const std::string &module, uint64_t relPc, PathBitmap &paths) const;
+    bool getFunctionPaths(const std::string &module, const std::string &function,
+                          PathBitmap &paths) const;
+
+    const PathBitmap &getAllPaths() const {
+        return m_AllPaths;
+    }
+
+    const PcPaths &getPcPaths() const {
+        return m_PcPaths;
+    }
+
+    const FunctionPaths &getFunctionPaths() const {
+        return m_FunctionPaths;
+    }
+
+    const std::string &getModuleName(ModuleId id) const {
+        return ModuleNames::getName(id);
+    }
+};
+
+/**
+ *  Translation blocks executed by one segment.
+ *  Unlike other states, it is not inherited from the parent segment.
+ */
+class PathIndexState: public ItemProcessorState
+{
+private:
+    std::set<PathIndex::PcKey> m_Pcs;
+
+public:
+    static ItemProcessorState *factory();
+    PathIndexState();
+    virtual ~PathIndexState();
+    virtual ItemProcessorState *clone() const;
+
+    friend class PathIndex;
+};
+
+}
+
+#endif
@@ -0,0 +1,385 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+
+#include "PathSampler.h"
+#include "Path.h"
+
+namespace s2etools
+{
+
+namespace {
+
+//Finalizer of splitmix64
+uint64_t mix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+struct SamplerFrame {
+    const PathSegment *seg;
+    unsigned child;
+    unsigned firstLeaf;
+};
+
+}
+
+PathSampler::PathSampler(const PathBuilder *pb)
+{
+    m_Builder = pb;
+    m_PathCount = 0;
+
+    std::vector<SamplerFrame> stack;
+    SamplerFrame root = {pb->getRoot(), 0, 0};
+    stack.push_back(root);
+
+    while (!stack.empty()) {
+        SamplerFrame &f = stack.back();
+        const PathSegmentList &children = f.seg->getChildren();
+
+        if (f.child == 0) {
+            const PathFragmentList &fra = f.seg->getFragmentList();
+            PathFragmentList::const_iterator it;
+            for (it = fra.begin(); it != fra.end(); ++it) {
+                m_Fragments[(*it).startIndex] = std::make_pair((*it).endIndex, f.seg);
+            }
+
+            if (children.empty()) {
+                m_Paths[f.seg->getStateId()] = std::make_pair((unsigned)stack.size(), m_PathCount++);
+            }
+        }
+
+        if (f.child < children.size()) {
+            SamplerFrame c = {children[f.child], 0, m_PathCount};
+            ++f.child;
+            stack.push_back(c);
+            continue;
+        }
+
+        m_LeafRanges[f.seg] = std::make_pair(f.firstLeaf, m_PathCount);
+        stack.pop_back();
+    }
+}
+
+//Groups consecutive depths until each stratum has about 1/count of the paths
+void PathSampler::buildStrata(unsigned count)
+{
+    std::map<unsigned, PathIds> depths;
+    std::map<uint32_t, std::pair<unsigned, unsigned> >::const_iterator pit;
+    for (pit = m_Paths.begin(); pit != m_Paths.end(); ++pit) {
+        depths[count > 1 ? (*pit).second.first : 0].push_back((*pit).first);
+    }
+
+    unsigned target = (m_PathCount + count - 1) / std::max(count, 1u);
+
+    m_Strata.clear();
+    std::map<unsigned, PathIds>::const_iterator it;
+    for (it = depths.begin(); it != depths.end(); ++it) {
+        if (m_Strata.empty() || m_Strata.back().paths.size() >= target) {
+            m_Strata.push_back(Stratum());
+        }
+
+        PathIds &paths = m_Strata.back().paths;
+        paths.insert(paths.end(), (*it).second.begin(), (*it).second.end());
+    }
+
+    for (unsigned h = 0; h < m_Strata.size(); ++h) {
+        Stratum &s = m_Strata[h];
+        s.sampled = 0;
+        for (unsigned i = 0; i < s.paths.size(); ++i) {
+            s.ranks.push_back(m_Paths[s.paths[i]].second);
+        }
+        std::sort(s.ranks.begin(), s.ranks.end());
+    }
+}
+
+//Each stratum gets at least two paths, so that its variance can be estimated
+void PathSampler::sample(unsigned count, bool stratify, uint64_t seed, unsigned maxStrata)
+{
+    m_Sample.clear();
+    m_SampleStrata.clear();
+    buildStrata(stratify ? maxStrata : 1);
+
+    if (count > m_PathCount) {
+        count = m_PathCount;
+    }
+
+    unsigned allocated = 0;
+    for (unsigned h = 0; h < m_Strata.size(); ++h) {
+        Stratum &s = m_Strata[h];
+        unsigned size = s.paths.size();
+        s.sampled = (uint64_t)count * size / m_PathCount;
+        s.sampled = std::min(std::max(s.sampled, 2u), size);
+        allocated += s.sampled;
+    }
+
+    //Hand out what the rounding left
+    while (allocated < count) {
+        for (unsigned h = 0; h < m_Strata.size() && allocated < count; ++h) {
+            if (m_Strata[h].sampled < m_Strata[h].paths.size()) {
+                ++m_Strata[h].sampled;
+                ++allocated;
+            }
+        }
+    }
+
+    //Partial Fisher-Yates shuffle of each stratum
+    uint64_t counter = seed;
+    for (unsigned h = 0; h < m_Strata.size(); ++h) {
+        PathIds paths = m_Strata[h].paths;
+        for (unsigned i = 0; i < m_Strata[h].sampled; ++i) {
+            unsigned j = i + mix(++counter) % (paths.size() - i);
+            std::swap(paths[i], paths[j]);
+            m_Sample.insert(paths[i]);
+            m_SampleStrata[paths[i]] = h;
+        }
+    }
+}
+
+//One minus the probability that no sampled path goes through the segment.
+//In each stratum, that is the hypergeometric probability
+//C(N - L, n) / C(N, n) for L leaves under the segment.
+double PathSampler::getInclusion(const PathSegment *seg) const
+{
+    LeafRanges::const_iterator it = m_LeafRanges.find(seg);
+    if (it == m_LeafRanges.end()) {
+        return 0;
+    }
+
+    unsigned first = (*it).second.first, end = (*it).second.second;
+    double logNone = 0;
+
+    for (unsigned h = 0; h < m_Strata.size(); ++h) {
+        const Stratum &s = m_Strata[h];
+        double L = std::lower_bound(s.ranks.begin(), s.ranks.end(), end) -
+                   std::lower_bound(s.ranks.begin(), s.ranks.end(), first);
+        double N = s.paths.size(), n = s.sampled;
+
+        if (L == 0 || n == 0) {
+            continue;
+        }
+
+        if (N - L < n) {
+            return 1.0;
+        }
+
+        logNone += lgamma(N - L + 1) - lgamma(N - L - n + 1) -
+                   lgamma(N + 1) + lgamma(N - n + 1);
+    }
+
+    return 1.0 - exp(logNone);
+}
+
+double PathSampler::getItemInclusion(uint32_t itemIndex) const
+{
+    Fragments::const_iterator it = m_Fragments.upper_bound(itemIndex);
+    if (it == m_Fragments.begin()) {
+        return 0;
+    }
+
+    --it;
+    if (itemIndex > (*it).second.first) {
+        return 0;
+    }
+
+    return getInclusion((*it).second.second);
+}
+
+//Stratified estimator of the total:
+//sum of N_h * mean_h, with variance sum of N_h^2 * (1 - n_h/N_h) * s_h^2 / n_h
+SampleEstimate PathSampler::estimateTotal(const PathValues &values, double z) const
+{
+    SampleEstimate e;
+    std::vector<double> sums(m_Strata.size()), squares(m_Strata.size());
+    std::vector<unsigned> counts(m_Strata.size());
+
+    std::map<uint32_t, unsigned>::const_iterator it;
+    for (it = m_SampleStrata.begin(); it != m_SampleStrata.end(); ++it) {
+        PathValues::const_iterator vit = values.find((*it).first);
+        double y = vit == values.end() ? 0 : (*vit).second;
+        sums[(*it).second] += y;
+        squares[(*it).second] += y * y;
+        ++counts[(*it).second];
+    }
+
+    double variance = 0;
+    for (unsigned h = 0; h < m_Strata.size(); ++h) {
+        double n = counts[h], N = m_Strata[h].paths.size();
+        if (n == 0) {
+            continue;
+        }
+
+        double mean = sums[h] / n;
+        e.total += N * mean;
+
+        if (n > 1) {
+            double s2 = (squares[h] - n * mean * mean) / (n - 1);
+            variance += N * N * (1 - n / N) * std::max(s2, 0.0) / n;
+        }
+    }
+
+    e.stdErr = sqrt(variance);
+    e.low = e.total - z * e.stdErr;
+    e.high = e.total + z * e.stdErr;
+
+    if (m_PathCount) {
+        e.mean = e.total / m_PathCount;
+        e.meanLow = e.low / m_PathCount;
+        e.meanHigh = e.high / m_PathCount;
+    }
+
+    return e;
+}
+
+//Bias-corrected Chao2 estimator, with the log-normal interval of Chao (1987).
+//Only the total and its interval are meaningful.
+SampleEstimate PathSampler::estimateRichness(const std::vector<unsigned> &incidence, double z) const
+{
+    SampleEstimate e;
+    double m = m_Sample.size();
+    double observed = incidence.size();
+    double q1 = 0, q2 = 0;
+
+    for (unsigned i = 0; i < incidence.size(); ++i) {
+        if (incidence[i] == 1) {
+            ++q1;
+        } else if (incidence[i] == 2) {
+            ++q2;
+        }
+    }
+
+    double a = m > 0 ? (m - 1) / m : 0;
+    double unseen, variance;
+
+    if (q2 > 0) {
+        double r = q1 / q2;
+        unseen = a * q1 * q1 / (2 * q2);
+        variance = q2 * (a / 2 * r * r + a * a * r * r * r + a * a / 4 * r * r * r * r);
+    } else {
+        unseen = a * q1 * (q1 - 1) / 2;
+        double total = observed + unseen;
+        variance = a * q1 * (q1 - 1) / 2 + a * a * q1 * (2 * q1 - 1) * (2 * q1 - 1) / 4;
+        if (total > 0) {
+            variance -= a * a * q1 * q1 * q1 * q1 / (4 * total);
+        }
+    }
+
+    variance = std::max(variance, 0.0);
+    e.total = observed + unseen;
+    e.stdErr = sqrt(variance);
+    e.low = e.high = e.total;
+
+    if (unseen > 0) {
+        double k = exp(z * sqrt(log(1 + variance / (unseen * unseen))));
+        e.low = observed + unseen / k;
+        e.high = observed + unseen * k;
+    }
+
+    return e;
+}
+
+//Rational approximation of Abramowitz and Stegun (26.2.23), error below 5e-4
+double PathSampler::getZ(double confidence)
+{
+    double p = (1 - confidence) / 2;
+    if (p <= 0 || p >= 0.5) {
+        return 0;
+    }
+
+    double t = sqrt(-2 * log(p));
+    return t - (2.515517 + 0.802853 * t + 0.010328 * t * t) /
+               (1 + 1.432788 * t + 0.189269 * t * t + 0.001308 * t * t * t);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+ItemSampler::ItemSampler(LogEvents *events, double tbRate, uint64_t seed)
+{
+    m_events = events;
+    m_rate = tbRate;
+    m_seed = seed;
+    m_threshold = tbRate >= 1.0 ? (uint64_t)-1 : (uint64_t)(tbRate * 18446744073709551616.0);
+
+    m_connection = events->onEachItem.connect(
+            sigc::mem_fun(*this, &ItemSampler::onItem)
+            );
+}
+
+ItemSampler::~ItemSampler()
+{
+    m_connection.disconnect();
+}
+
+void ItemSampler::onItem(unsigned traceIndex,
+                         const s2e::plugins::ExecutionTraceItemHeader &hdr,
+                         void *item)
+{
+    if (hdr.type == s2e::plugins::TRACE_TB_START && m_rate < 1.0 &&
+        mix(traceIndex ^ m_seed) >= m_threshold) {
+        return;
+    }
+
+    processItem(traceIndex, hdr, item);
+}
+
+ItemProcessorState* ItemSampler::getState(void *processor, ItemProcessorStateFactory f)
+{
+    return m_events->getState(processor, f);
+}
+
+ItemProcessorState* ItemSampler::getState(void *processor, uint32_t pathId)
+{
+    return m_events->getState(processor, pathId);
+}
+
+void ItemSampler::getPaths(PathSet &s)
+{
+    m_events->getPaths(s);
+}
+
+uint32_t ItemSampler::getGlobalStateId(unsigned traceIndex, uint32_t stateId) const
+{
+    return m_events->getGlobalStateId(traceIndex, stateId);
+}
+
+}
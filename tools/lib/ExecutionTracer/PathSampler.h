@@ -0,0 +1,183 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#ifndef S2ETOOLS_EXECTRACER_PATHSAMPLER_H
+#define S2ETOOLS_EXECTRACER_PATHSAMPLER_H
+
+#include <inttypes.h>
+#include <ostream>
+#include <vector>
+#include <map>
+
+#include "LogParser.h"
+
+namespace s2etools
+{
+
+class PathBuilder;
+class PathSegment;
+
+/**
+ *  Estimate of a quantity summed over all the paths,
+ *  with its confidence interval.
+ */
+struct SampleEstimate
+{
+    double total;
+    double stdErr;
+    double low, high;
+
+    //Per-path average, i.e., the above divided by the number of paths
+    double mean, meanLow, meanHigh;
+
+    SampleEstimate() {
+        total = stdErr = low = high = 0;
+        mean = meanLow = meanHigh = 0;
+    }
+};
+
+typedef std::map<uint32_t, double> PathValues;
+
+/**
+ *  Picks a random subset of the paths of the tree, to be processed
+ *  with PathBuilder::processPaths(), and extrapolates the results.
+ *
+ *  Paths are drawn without replacement, either uniformly or stratified
+ *  by depth (number of segments from the root). Strata are groups of
+ *  consecutive depths, the sample is allocated in proportion to their size.
+ *  Only the tree is walked, no trace item is read.
+ */
+class PathSampler
+{
+private:
+    typedef std::vector<uint32_t> PathIds;
+
+    struct Stratum {
+        PathIds paths;
+        //Rank of the leaves in depth-first order, sorted
+        std::vector<unsigned> ranks;
+        unsigned sampled;
+    };
+
+    typedef std::vector<Stratum> Strata;
+    typedef std::map<const PathSegment*, std::pair<unsigned, unsigned> > LeafRanges;
+    typedef std::map<uint32_t, std::pair<uint32_t, const PathSegment*> > Fragments;
+
+    const PathBuilder *m_Builder;
+    unsigned m_PathCount;
+
+    //(depth, rank of the leaf in depth-first order) of each path
+    std::map<uint32_t, std::pair<unsigned, unsigned> > m_Paths;
+
+    //Leaves of the subtree of each segment, as a range of ranks
+    LeafRanges m_LeafRanges;
+
+    //Item ranges of the segments, by first item
+    Fragments m_Fragments;
+
+    Strata m_Strata;
+    std::map<uint32_t, unsigned> m_SampleStrata;
+    PathSet m_Sample;
+
+    void buildStrata(unsigned count);
+
+public:
+    PathSampler(const PathBuilder *pb);
+
+    unsigned getPathCount() const {
+        return m_PathCount;
+    }
+
+    const PathSet &getSample() const {
+        return m_Sample;
+    }
+
+    //Draws count paths. With stratify set, uses at most maxStrata strata.
+    void sample(unsigned count, bool stratify, uint64_t seed,
+                unsigned maxStrata = 8);
+
+    //Probability that the segment is on at least one sampled path
+    double getInclusion(const PathSegment *seg) const;
+
+    //Same as above, for the segment that holds the item
+    double getItemInclusion(uint32_t itemIndex) const;
+
+    //Values are given for the sampled paths, missing ones count as zero.
+    SampleEstimate estimateTotal(const PathValues &values, double z) const;
+
+    //Estimates the number of distinct elements (e.g., blocks) over all the paths
+    //from the number of sampled paths in which each observed element occurs (Chao2).
+    SampleEstimate estimateRichness(const std::vector<unsigned> &incidence, double z) const;
+
+    //Two-sided normal quantile for the given confidence level (e.g., 0.95 gives 1.96)
+    static double getZ(double confidence);
+};
+
+/**
+ *  Forwards the trace items to the processors connected to it,
+ *  except for a fraction of the translation blocks.
+ *  The choice depends only on the item index, so that paths
+ *  that share a prefix see the same blocks.
+ */
+class ItemSampler: public LogEvents
+{
+private:
+    LogEvents *m_events;
+    sigc::connection m_connection;
+    uint64_t m_threshold;
+    uint64_t m_seed;
+    double m_rate;
+
+    void onItem(unsigned traceIndex,
+                const s2e::plugins::ExecutionTraceItemHeader &hdr,
+                void *item);
+
+public:
+    ItemSampler(LogEvents *events, double tbRate, uint64_t seed);
+    virtual ~ItemSampler();
+
+    double getRate() const {
+        return m_rate;
+    }
+
+    virtual ItemProcessorState* getState(void *processor, ItemProcessorStateFactory f);
+    virtual ItemProcessorState* getState(void *processor, uint32_t pathId);
+    virtual void getPaths(PathSet &s);
+    virtual uint32_t getGlobalStateId(unsigned traceIndex, uint32_t stateId) const;
+};
+
+}
+
+#endif
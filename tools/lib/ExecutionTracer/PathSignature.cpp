@@ -0,0 +1,269 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#include <cassert>
+
+#include "PathSignature.h"
+
+using namespace s2e::plugins;
+
+namespace s2etools
+{
+
+namespace {
+
+//Finalizer of splitmix64
+uint64_t mix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+uint64_t hashString(const std::string &s)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (unsigned i = 0; i < s.size(); ++i) {
+        h ^= (uint8_t) s[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+}
+
+PathSignature::PathSignature(LogEvents *events, ModuleCache *cache,
+                             unsigned hashCount, unsigned ngram)
+{
+    assert(hashCount > 0 && ngram > 0);
+
+    m_events = events;
+    m_cache = cache;
+    m_NGram = ngram;
+
+    for (unsigned i = 0; i < hashCount; ++i) {
+        m_Seeds.push_back(mix(i + 1));
+    }
+
+    m_connection = events->onEachItem.connect(
+            sigc::mem_fun(*this, &PathSignature::onItem));
+}
+
+PathSignature::~PathSignature()
+{
+    m_connection.disconnect();
+}
+
+void PathSignature::onItem(unsigned traceIndex,
+            const s2e::plugins::ExecutionTraceItemHeader &hdr,
+            void *item)
+{
+    if (hdr.type != s2e::plugins::TRACE_TB_START) {
+        return;
+    }
+
+    const ExecutionTraceTb *te = static_cast<const ExecutionTraceTb*>(item);
+
+    ModuleCacheState *mcs = static_cast<ModuleCacheState*>(m_events->getState(m_cache, &ModuleCacheState::factory));
+    PathSignatureState *state = static_cast<PathSignatureState*>(m_events->getState(this, &PathSignatureState::factory));
+
+    //Module-relative, so that the signature does not depend on load addresses
+    const ModuleInstance *mi = mcs->getInstance(hdr.pid, te->pc);
+    uint64_t feature;
+    if (mi) {
+        if (mi->Id >= m_ModuleHashes.size()) {
+            for (ModuleId id = m_ModuleHashes.size(); id <= mi->Id; ++id) {
+                m_ModuleHashes.push_back(hashString(ModuleNames::getName(id)));
+            }
+        }
+        feature = mix(m_ModuleHashes[mi->Id] ^ (te->pc - mi->LoadBase + mi->ImageBase));
+    } else {
+        feature = mix(te->pc);
+    }
+
+    if (m_NGram > 1) {
+        std::vector<uint64_t> &w = state->m_Window;
+        w.push_back(feature);
+        if (w.size() > m_NGram) {
+            w.erase(w.begin());
+        }
+
+        //Shorter sequences at the start of the path are features too
+        feature = 0;
+        for (unsigned i = 0; i < w.size(); ++i) {
+            feature = mix(feature ^ w[i]);
+        }
+    }
+
+    std::vector<uint32_t> &minHashes = state->m_MinHashes;
+    if (minHashes.empty()) {
+        minHashes.assign(m_Seeds.size(), (uint32_t) -1);
+    }
+
+    for (unsigned i = 0; i < m_Seeds.size(); ++i) {
+        uint32_t h = (uint32_t) mix(feature ^ m_Seeds[i]);
+        if (h < minHashes[i]) {
+            minHashes[i] = h;
+        }
+    }
+}
+
+double PathSignature::getSimilarity(const PathSignatureState *s1, const PathSignatureState *s2)
+{
+    const std::vector<uint32_t> &h1 = s1->m_MinHashes;
+    const std::vector<uint32_t> &h2 = s2->m_MinHashes;
+
+    //Paths without blocks
+    if (h1.empty() || h2.empty()) {
+        return h1.empty() && h2.empty() ? 1.0 : 0.0;
+    }
+
+    assert(h1.size() == h2.size());
+    unsigned equal = 0;
+    for (unsigned i = 0; i < h1.size(); ++i) {
+        equal += h1[i] == h2[i] ? 1 : 0;
+    }
+    return (double) equal / h1.size();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+ItemProcessorState *PathSignatureState::factory()
+{
+    return new PathSignatureState();
+}
+
+PathSignatureState::PathSignatureState()
+{
+
+}
+
+PathSignatureState::~PathSignatureState()
+{
+
+}
+
+ItemProcessorState *PathSignatureState::clone() const
+{
+    return new PathSignatureState(*this);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+PathClusters::PathClusters(unsigned bands, double threshold)
+{
+    assert(bands > 0);
+    m_Bands = bands;
+    m_Threshold = threshold;
+}
+
+unsigned PathClusters::find(unsigned i)
+{
+    while (m_Parents[i] != i) {
+        m_Parents[i] = m_Parents[m_Parents[i]];
+        i = m_Parents[i];
+    }
+    return i;
+}
+
+void PathClusters::addPath(uint32_t pathId, const PathSignatureState *signature, bool preferred)
+{
+    unsigned index = m_PathIds.size();
+    m_PathIds.push_back(pathId);
+    m_Signatures.push_back(signature);
+    m_Preferred.push_back(preferred);
+    m_Parents.push_back(index);
+
+    const std::vector<uint32_t> &minHashes = signature->getMinHashes();
+    unsigned rows = minHashes.size() / m_Bands;
+
+    for (unsigned b = 0; b < m_Bands; ++b) {
+        //Paths without blocks only have one bucket
+        if (rows == 0 && b > 0) {
+            break;
+        }
+
+        uint64_t key = b + 1;
+        for (unsigned r = b * rows; r < (b + 1) * rows; ++r) {
+            key = mix(key ^ minHashes[r]);
+        }
+
+        Buckets::iterator it = m_Buckets.find(key);
+        if (it == m_Buckets.end()) {
+            m_Buckets[key] = index;
+            continue;
+        }
+
+        unsigned other = (*it).second;
+        if (find(other) == find(index)) {
+            continue;
+        }
+
+        if (PathSignature::getSimilarity(signature, m_Signatures[other]) >= m_Threshold) {
+            m_Parents[find(index)] = find(other);
+        }
+    }
+}
+
+void PathClusters::getClusters(Clusters &clusters)
+{
+    //Representative of each root: first preferred path, or smallest path id
+    std::map<unsigned, unsigned> representatives;
+    for (unsigned i = 0; i < m_PathIds.size(); ++i) {
+        unsigned root = find(i);
+        std::map<unsigned, unsigned>::iterator it = representatives.find(root);
+        if (it == representatives.end()) {
+            representatives[root] = i;
+            continue;
+        }
+
+        unsigned rep = (*it).second;
+        if ((m_Preferred[i] && !m_Preferred[rep]) ||
+            (m_Preferred[i] == m_Preferred[rep] && m_PathIds[i] < m_PathIds[rep])) {
+            (*it).second = i;
+        }
+    }
+
+    clusters.clear();
+    for (unsigned i = 0; i < m_PathIds.size(); ++i) {
+        unsigned rep = representatives[find(i)];
+        clusters[m_PathIds[rep]].push_back(m_PathIds[i]);
+    }
+}
+
+}
@@ -0,0 +1,151 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#ifndef S2ETOOLS_EXECTRACER_PATHSIGNATURE_H
+#define S2ETOOLS_EXECTRACER_PATHSIGNATURE_H
+
+#include <s2e/Plugins/ExecutionTracers/TraceEntries.h>
+#include <vector>
+#include <map>
+
+#include "LogParser.h"
+#include "ModuleParser.h"
+
+namespace s2etools
+{
+
+class PathSignatureState;
+
+/**
+ *  Computes a MinHash signature of each path while the tree is processed.
+ *  The features of a path are its (module, relative pc) translation blocks,
+ *  or the n-grams of its sequence of blocks. Since the features of a path
+ *  include those of its prefix, signatures are updated incrementally and
+ *  inherited by the forked states.
+ */
+class PathSignature
+{
+private:
+    LogEvents *m_events;
+    ModuleCache *m_cache;
+    sigc::connection m_connection;
+
+    unsigned m_NGram;
+    std::vector<uint64_t> m_Seeds;
+
+    //Name hashes indexed by module id, names are stable across traces
+    std::vector<uint64_t> m_ModuleHashes;
+
+    void onItem(unsigned traceIndex,
+                const s2e::plugins::ExecutionTraceItemHeader &hdr,
+                void *item);
+
+public:
+    PathSignature(LogEvents *events, ModuleCache *cache,
+                  unsigned hashCount = 64, unsigned ngram = 1);
+    ~PathSignature();
+
+    unsigned getHashCount() const {
+        return m_Seeds.size();
+    }
+
+    //Estimated Jaccard similarity of the feature sets of two paths
+    static double getSimilarity(const PathSignatureState *s1, const PathSignatureState *s2);
+};
+
+class PathSignatureState: public ItemProcessorState
+{
+private:
+    std::vector<uint32_t> m_MinHashes;
+
+    //Features of the last blocks, for n-grams
+    std::vector<uint64_t> m_Window;
+
+public:
+    static ItemProcessorState *factory();
+    PathSignatureState();
+    virtual ~PathSignatureState();
+    virtual ItemProcessorState *clone() const;
+
+    const std::vector<uint32_t> &getMinHashes() const {
+        return m_MinHashes;
+    }
+
+    friend class PathSignature;
+};
+
+/**
+ *  Groups paths with similar signatures using locality-sensitive hashing.
+ *  The signature is cut into bands, paths that agree on all the rows of
+ *  a band land in the same bucket. Candidates are merged if their
+ *  estimated similarity reaches the threshold.
+ */
+class PathClusters
+{
+public:
+    //Representative to members
+    typedef std::map<uint32_t, std::vector<uint32_t> > Clusters;
+
+private:
+    typedef std::map<uint64_t, unsigned> Buckets;
+
+    unsigned m_Bands;
+    double m_Threshold;
+    Buckets m_Buckets;
+
+    std::vector<uint32_t> m_PathIds;
+    std::vector<const PathSignatureState *> m_Signatures;
+    std::vector<bool> m_Preferred;
+    std::vector<unsigned> m_Parents;
+
+    unsigned find(unsigned i);
+
+public:
+    PathClusters(unsigned bands, double threshold);
+
+    //Preferred paths (e.g., with a test case) become representatives first.
+    //The signature must remain valid until the clusters are computed.
+    void addPath(uint32_t pathId, const PathSignatureState *signature, bool preferred);
+
+    void getClusters(Clusters &clusters);
+
+    unsigned getPathCount() const {
+        return m_PathIds.size();
+    }
+};
+
+}
+
+#endif
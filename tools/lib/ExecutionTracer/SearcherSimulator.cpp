@@ -0,0 +1,298 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#include <algorithm>
+#include <stack>
+#include <cassert>
+
+#include "SearcherSimulator.h"
+#include "Path.h"
+
+using namespace s2e::plugins;
+
+namespace s2etools
+{
+
+void DfsPolicy::reset(const SimulatedTree &tree)
+{
+    m_States.clear();
+}
+
+void DfsPolicy::addState(uint32_t segment)
+{
+    m_States.push_back(segment);
+}
+
+uint32_t DfsPolicy::selectState()
+{
+    uint32_t s = m_States.back();
+    m_States.pop_back();
+    return s;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void BfsPolicy::reset(const SimulatedTree &tree)
+{
+    m_States.clear();
+}
+
+void BfsPolicy::addState(uint32_t segment)
+{
+    m_States.push_back(segment);
+}
+
+uint32_t BfsPolicy::selectState()
+{
+    uint32_t s = m_States.front();
+    m_States.pop_front();
+    return s;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void RandomPathPolicy::reset(const SimulatedTree &tree)
+{
+    m_Tree = &tree;
+    m_PendingBelow.assign(tree.size(), 0);
+    m_Pending.assign(tree.size(), false);
+}
+
+void RandomPathPolicy::addState(uint32_t segment)
+{
+    m_Pending[segment] = true;
+    for (uint32_t s = segment; ; s = (*m_Tree)[s].parent) {
+        ++m_PendingBelow[s];
+        if (s == 0) {
+            break;
+        }
+    }
+}
+
+uint32_t RandomPathPolicy::selectState()
+{
+    uint32_t s = 0;
+
+    //Pending states have not run yet, none of their children is known
+    while (!m_Pending[s]) {
+        const std::vector<uint32_t> &children = (*m_Tree)[s].children;
+        unsigned candidates = 0;
+        for (unsigned i = 0; i < children.size(); ++i) {
+            candidates += m_PendingBelow[children[i]] ? 1 : 0;
+        }
+        assert(candidates > 0);
+
+        m_Seed = m_Seed * 1103515245 + 12345;
+        unsigned pick = ((m_Seed >> 16) & 0x7fff) % candidates;
+        for (unsigned i = 0; i < children.size(); ++i) {
+            if (m_PendingBelow[children[i]] && pick-- == 0) {
+                s = children[i];
+                break;
+            }
+        }
+    }
+
+    m_Pending[s] = false;
+    for (uint32_t p = s; ; p = (*m_Tree)[p].parent) {
+        --m_PendingBelow[p];
+        if (p == 0) {
+            break;
+        }
+    }
+    return s;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void CoverageOptimizedPolicy::reset(const SimulatedTree &tree)
+{
+    m_Tree = &tree;
+    m_LastCoverage.assign(tree.size(), 0);
+    m_States = std::priority_queue<Priority>();
+}
+
+void CoverageOptimizedPolicy::addState(uint32_t segment)
+{
+    const SimulatedSegment &seg = (*m_Tree)[segment];
+    if (segment != 0) {
+        m_LastCoverage[segment] = m_LastCoverage[seg.parent];
+    }
+    m_States.push(Priority(std::make_pair(m_LastCoverage[segment], seg.depth), segment));
+}
+
+uint32_t CoverageOptimizedPolicy::selectState()
+{
+    uint32_t s = m_States.top().second;
+    m_States.pop();
+    return s;
+}
+
+void CoverageOptimizedPolicy::onExecuted(uint32_t segment, uint64_t newBlocks, uint64_t time)
+{
+    if (newBlocks) {
+        m_LastCoverage[segment] = time;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+SearcherSimulator::SearcherSimulator(LogParser *parser, PathBuilder *pb)
+{
+    m_Parser = parser;
+    m_Builder = pb;
+    m_BlockCount = 0;
+}
+
+void SearcherSimulator::build(bool timeCost)
+{
+    typedef std::pair<uint64_t, uint64_t> BlockKey;
+    std::map<BlockKey, uint32_t> blockIds;
+
+    m_Tree.clear();
+
+    //(segment, index of its parent)
+    std::stack<std::pair<const PathSegment*, uint32_t> > s;
+    s.push(std::make_pair(m_Builder->getRoot(), 0));
+
+    while (!s.empty()) {
+        const PathSegment *seg = s.top().first;
+        uint32_t parent = s.top().second;
+        s.pop();
+
+        uint32_t index = m_Tree.size();
+        m_Tree.push_back(SimulatedSegment());
+        SimulatedSegment &sim = m_Tree.back();
+        sim.parent = parent;
+        sim.depth = 0;
+        sim.cost = 0;
+
+        if (index != 0) {
+            sim.depth = m_Tree[parent].depth + 1;
+            m_Tree[parent].children.push_back(index);
+        }
+
+        const PathFragmentList &fra = seg->getFragmentList();
+        PathFragmentList::const_iterator it;
+        ExecutionTraceItemHeader hdr;
+        void *data;
+
+        for (it = fra.begin(); it != fra.end(); ++it) {
+            uint64_t firstTime = 0;
+            for (uint32_t i = (*it).startIndex; i <= (*it).endIndex; ++i) {
+                if (!m_Parser->getItem(i, hdr, &data)) {
+                    assert(false && "Trace is broken");
+                }
+
+                if (i == (*it).startIndex) {
+                    firstTime = hdr.timeStamp;
+                }
+
+                if (hdr.type != TRACE_TB_START) {
+                    continue;
+                }
+
+                const ExecutionTraceTb *te = static_cast<ExecutionTraceTb*>(data);
+                BlockKey key(hdr.pid, te->pc);
+                std::map<BlockKey, uint32_t>::iterator bit = blockIds.find(key);
+                if (bit == blockIds.end()) {
+                    bit = blockIds.insert(std::make_pair(key, (uint32_t)blockIds.size())).first;
+                }
+                sim.blocks.push_back((*bit).second);
+
+                if (!timeCost) {
+                    ++sim.cost;
+                }
+            }
+
+            if (timeCost) {
+                sim.cost += hdr.timeStamp - firstTime;
+            }
+        }
+
+        std::sort(sim.blocks.begin(), sim.blocks.end());
+        sim.blocks.erase(std::unique(sim.blocks.begin(), sim.blocks.end()), sim.blocks.end());
+
+        const PathSegmentList &children = seg->getChildren();
+        for (unsigned i = children.size(); i > 0; --i) {
+            s.push(std::make_pair(children[i - 1], index));
+        }
+    }
+
+    m_BlockCount = blockIds.size();
+}
+
+void SearcherSimulator::simulate(SearchPolicy *policy, CoverageCurve &curve) const
+{
+    std::vector<bool> covered(m_BlockCount, false);
+    uint64_t time = 0, coveredCount = 0;
+
+    curve.clear();
+    curve.push_back(std::make_pair(0, 0));
+
+    if (m_Tree.empty()) {
+        return;
+    }
+
+    policy->reset(m_Tree);
+    policy->addState(0);
+
+    while (!policy->empty()) {
+        uint32_t s = policy->selectState();
+        const SimulatedSegment &seg = m_Tree[s];
+
+        time += seg.cost;
+
+        uint64_t newBlocks = 0;
+        for (unsigned i = 0; i < seg.blocks.size(); ++i) {
+            if (!covered[seg.blocks[i]]) {
+                covered[seg.blocks[i]] = true;
+                ++newBlocks;
+            }
+        }
+
+        if (newBlocks) {
+            coveredCount += newBlocks;
+            curve.push_back(std::make_pair(time, coveredCount));
+        }
+
+        policy->onExecuted(s, newBlocks, time);
+
+        for (unsigned i = 0; i < seg.children.size(); ++i) {
+            policy->addState(seg.children[i]);
+        }
+    }
+}
+
+}
@@ -0,0 +1,207 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#ifndef S2ETOOLS_EXECTRACER_SEARCHERSIMULATOR_H
+#define S2ETOOLS_EXECTRACER_SEARCHERSIMULATOR_H
+
+#include <inttypes.h>
+#include <vector>
+#include <deque>
+#include <queue>
+#include <map>
+
+#include "LogParser.h"
+
+namespace s2etools
+{
+
+class PathBuilder;
+class PathSegment;
+
+/**
+ *  Segment of the recorded tree, as seen by the simulator.
+ *  Segments are numbered in depth-first order, the root is 0.
+ */
+struct SimulatedSegment
+{
+    uint32_t parent;
+    unsigned depth;
+    uint64_t cost;
+    std::vector<uint32_t> children;
+
+    //Basic blocks executed by the segment
+    std::vector<uint32_t> blocks;
+};
+
+typedef std::vector<SimulatedSegment> SimulatedTree;
+
+/**
+ *  Scheduling policy of the simulated searcher.
+ *  A state becomes available when the segment that forked it completes.
+ */
+class SearchPolicy
+{
+public:
+    virtual ~SearchPolicy() {}
+    virtual const char *getName() const = 0;
+
+    virtual void reset(const SimulatedTree &tree) = 0;
+    virtual void addState(uint32_t segment) = 0;
+
+    //Removes the selected state from the pending states
+    virtual uint32_t selectState() = 0;
+    virtual bool empty() const = 0;
+
+    //Called when the segment completes, before its children are added
+    virtual void onExecuted(uint32_t segment, uint64_t newBlocks, uint64_t time) {}
+};
+
+class DfsPolicy: public SearchPolicy
+{
+private:
+    std::vector<uint32_t> m_States;
+
+public:
+    virtual const char *getName() const { return "dfs"; }
+    virtual void reset(const SimulatedTree &tree);
+    virtual void addState(uint32_t segment);
+    virtual uint32_t selectState();
+    virtual bool empty() const { return m_States.empty(); }
+};
+
+class BfsPolicy: public SearchPolicy
+{
+private:
+    std::deque<uint32_t> m_States;
+
+public:
+    virtual const char *getName() const { return "bfs"; }
+    virtual void reset(const SimulatedTree &tree);
+    virtual void addState(uint32_t segment);
+    virtual uint32_t selectState();
+    virtual bool empty() const { return m_States.empty(); }
+};
+
+/**
+ *  Walks down from the root, picking a random child at each fork,
+ *  which favors states that are close to the root.
+ */
+class RandomPathPolicy: public SearchPolicy
+{
+private:
+    const SimulatedTree *m_Tree;
+    std::vector<uint32_t> m_PendingBelow;
+    std::vector<bool> m_Pending;
+    unsigned m_Seed;
+
+public:
+    RandomPathPolicy(unsigned seed) {
+        m_Tree = NULL;
+        m_Seed = seed;
+    }
+
+    virtual const char *getName() const { return "random-path"; }
+    virtual void reset(const SimulatedTree &tree);
+    virtual void addState(uint32_t segment);
+    virtual uint32_t selectState();
+    virtual bool empty() const { return m_PendingBelow.empty() || m_PendingBelow[0] == 0; }
+};
+
+/**
+ *  Prefers the states whose ancestors covered new code most recently,
+ *  deeper states first on ties.
+ */
+class CoverageOptimizedPolicy: public SearchPolicy
+{
+private:
+    //(time of the last new block, depth, segment)
+    typedef std::pair<std::pair<uint64_t, unsigned>, uint32_t> Priority;
+
+    const SimulatedTree *m_Tree;
+    std::vector<uint64_t> m_LastCoverage;
+    std::priority_queue<Priority> m_States;
+
+public:
+    CoverageOptimizedPolicy() {
+        m_Tree = NULL;
+    }
+
+    virtual const char *getName() const { return "coverage"; }
+    virtual void reset(const SimulatedTree &tree);
+    virtual void addState(uint32_t segment);
+    virtual uint32_t selectState();
+    virtual bool empty() const { return m_States.empty(); }
+    virtual void onExecuted(uint32_t segment, uint64_t newBlocks, uint64_t time);
+};
+
+/**
+ *  Replays the exploration of a recorded execution tree under different
+ *  scheduling policies, without going back to the trace. Each segment runs
+ *  to completion for its recorded cost and covers its blocks when it ends.
+ */
+class SearcherSimulator
+{
+public:
+    //Simulated time and number of covered blocks, at each coverage increase
+    typedef std::vector<std::pair<uint64_t, uint64_t> > CoverageCurve;
+
+private:
+    LogParser *m_Parser;
+    PathBuilder *m_Builder;
+
+    SimulatedTree m_Tree;
+    unsigned m_BlockCount;
+
+public:
+    SearcherSimulator(LogParser *parser, PathBuilder *pb);
+
+    //The cost of a segment is either its duration in the trace
+    //or its number of translation blocks
+    void build(bool timeCost);
+
+    void simulate(SearchPolicy *policy, CoverageCurve &curve) const;
+
+    unsigned getBlockCount() const {
+        return m_BlockCount;
+    }
+
+    const SimulatedTree &getTree() const {
+        return m_Tree;
+    }
+};
+
+}
+
+#endif
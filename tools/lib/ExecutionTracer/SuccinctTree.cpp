@@ -0,0 +1,598 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#include <cassert>
+#include <algorithm>
+#include <stack>
+#include "SuccinctTree.h"
+#include "Path.h"
+
+namespace s2etools
+{
+
+static inline unsigned popCount(uint64_t w)
+{
+    return __builtin_popcountll(w);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+//Number of 64-bit words per rank superblock
+#define RANK_SUPERBLOCK_WORDS 8
+
+//Larger than any excess value
+static const int64_t EXCESS_INFINITY = (int64_t) (~(uint64_t)0 >> 1);
+
+RankBitVector::RankBitVector()
+{
+    m_size = 0;
+    m_ones = 0;
+}
+
+void RankBitVector::push_back(bool b)
+{
+    if (m_size % 64 == 0) {
+        m_words.push_back(0);
+    }
+
+    if (b) {
+        m_words.back() |= (uint64_t)1 << (m_size % 64);
+    }
+    ++m_size;
+}
+
+void RankBitVector::finalize()
+{
+    m_superBlocks.clear();
+    m_ones = 0;
+
+    for (unsigned i = 0; i < m_words.size(); ++i) {
+        if (i % RANK_SUPERBLOCK_WORDS == 0) {
+            m_superBlocks.push_back(m_ones);
+        }
+        m_ones += popCount(m_words[i]);
+    }
+    m_superBlocks.push_back(m_ones);
+}
+
+uint64_t RankBitVector::rank1(uint64_t i) const
+{
+    assert(i <= m_size);
+    uint64_t word = i / 64;
+    uint64_t sb = word / RANK_SUPERBLOCK_WORDS;
+    uint64_t ret = m_superBlocks[sb];
+
+    for (uint64_t w = sb * RANK_SUPERBLOCK_WORDS; w < word; ++w) {
+        ret += popCount(m_words[w]);
+    }
+
+    if (i % 64) {
+        ret += popCount(m_words[word] & (((uint64_t)1 << (i % 64)) - 1));
+    }
+    return ret;
+}
+
+uint64_t RankBitVector::select1(uint64_t k) const
+{
+    assert(k < m_ones);
+
+    //Find the last superblock that starts with at most k ones
+    uint64_t lo = 0, hi = m_superBlocks.size() - 1;
+    while (hi - lo > 1) {
+        uint64_t mid = (lo + hi) / 2;
+        if (m_superBlocks[mid] <= k) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    uint64_t rank = m_superBlocks[lo];
+    uint64_t w = lo * RANK_SUPERBLOCK_WORDS;
+    for (; w < m_words.size(); ++w) {
+        unsigned count = popCount(m_words[w]);
+        if (rank + count > k) {
+            break;
+        }
+        rank += count;
+    }
+
+    assert(w < m_words.size());
+    uint64_t word = m_words[w];
+    for (unsigned b = 0; b < 64; ++b) {
+        if ((word >> b) & 1) {
+            if (rank == k) {
+                return w * 64 + b;
+            }
+            ++rank;
+        }
+    }
+
+    assert(false);
+    return 0;
+}
+
+uint64_t RankBitVector::getMemoryUsage() const
+{
+    return (m_words.size() + m_superBlocks.size()) * sizeof(uint64_t);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+EncodedPath::EncodedPath()
+{
+    m_length = 0;
+}
+
+//Number of bits needed to encode the index of a child
+unsigned EncodedPath::getWidth(unsigned childCount)
+{
+    unsigned width = 0;
+    while (((uint64_t)1 << width) < childCount) {
+        ++width;
+    }
+    return width;
+}
+
+void EncodedPath::append(uint32_t value, unsigned width)
+{
+    for (int i = width - 1; i >= 0; --i) {
+        if (m_length % 32 == 0) {
+            m_words.push_back(0);
+        }
+
+        if ((value >> i) & 1) {
+            m_words.back() |= 1u << (31 - m_length % 32);
+        }
+        ++m_length;
+    }
+}
+
+void EncodedPath::truncate(uint32_t length)
+{
+    assert(length <= m_length);
+    m_length = length;
+    m_words.resize((length + 31) / 32);
+
+    //Keep unused bits cleared, comparisons rely on it
+    if (length % 32) {
+        m_words.back() &= ~0u << (32 - length % 32);
+    }
+}
+
+uint32_t EncodedPath::read(uint32_t pos, unsigned width) const
+{
+    assert(pos + width <= m_length);
+    uint32_t ret = 0;
+    for (unsigned i = 0; i < width; ++i) {
+        ret = (ret << 1) | getBit(pos + i);
+    }
+    return ret;
+}
+
+bool EncodedPath::isPrefixOf(const EncodedPath &p) const
+{
+    if (m_length > p.m_length) {
+        return false;
+    }
+
+    unsigned fullWords = m_length / 32;
+    for (unsigned i = 0; i < fullWords; ++i) {
+        if (m_words[i] != p.m_words[i]) {
+            return false;
+        }
+    }
+
+    if (m_length % 32) {
+        uint32_t mask = ~0u << (32 - m_length % 32);
+        return (m_words[fullWords] & mask) == (p.m_words[fullWords] & mask);
+    }
+
+    return true;
+}
+
+bool EncodedPath::operator<(const EncodedPath &p) const
+{
+    uint32_t common = m_length < p.m_length ? m_length : p.m_length;
+    unsigned words = (common + 31) / 32;
+
+    for (unsigned i = 0; i < words; ++i) {
+        uint32_t mask = ~0u;
+        if (i == words - 1 && common % 32) {
+            mask = ~0u << (32 - common % 32);
+        }
+
+        uint32_t w1 = m_words[i] & mask, w2 = p.m_words[i] & mask;
+        if (w1 != w2) {
+            return w1 < w2;
+        }
+    }
+
+    return m_length < p.m_length;
+}
+
+bool EncodedPath::operator==(const EncodedPath &p) const
+{
+    return m_length == p.m_length && m_words == p.m_words;
+}
+
+void EncodedPath::print(std::ostream &os) const
+{
+    for (uint32_t i = 0; i < m_length; ++i) {
+        os << (getBit(i) ? '1' : '0');
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+SuccinctTree::SuccinctTree(const PathSegment *root)
+{
+    //Depth-first traversal, children in their natural order
+    std::stack<std::pair<const PathSegment*, unsigned> > s;
+
+    s.push(std::make_pair(root, 0));
+    m_bp.push_back(true);
+    m_leaves.push_back(root->getChildren().empty());
+    if (root->getChildren().empty()) {
+        m_leafStates.push_back(root->getStateId());
+    }
+
+    while (!s.empty()) {
+        const PathSegment *seg = s.top().first;
+        unsigned next = s.top().second;
+        const PathSegmentList &children = seg->getChildren();
+
+        if (next == children.size()) {
+            m_bp.push_back(false);
+            m_leaves.push_back(false);
+            s.pop();
+            continue;
+        }
+
+        ++s.top().second;
+
+        const PathSegment *child = children[next];
+        bool leaf = child->getChildren().empty();
+        m_bp.push_back(true);
+        m_leaves.push_back(leaf);
+        if (leaf) {
+            m_leafStates.push_back(child->getStateId());
+        }
+        s.push(std::make_pair(child, 0));
+    }
+
+    m_bp.finalize();
+    m_leaves.finalize();
+    buildMinTree();
+}
+
+void SuccinctTree::buildMinTree()
+{
+    const std::vector<uint64_t> &words = m_bp.words();
+    int64_t e = 0;
+
+    m_wordMin.resize(words.size());
+    for (uint64_t w = 0; w < words.size(); ++w) {
+        int64_t min = EXCESS_INFINITY;
+        for (uint64_t i = w * 64; i < (w + 1) * 64 && i < m_bp.size(); ++i) {
+            e += m_bp.get(i) ? 1 : -1;
+            if (e < min) {
+                min = e;
+            }
+        }
+        m_wordMin[w] = min;
+    }
+
+    m_treeLeaves = 1;
+    while (m_treeLeaves < words.size()) {
+        m_treeLeaves *= 2;
+    }
+
+    m_minTree.assign(2 * m_treeLeaves, EXCESS_INFINITY);
+    for (uint64_t w = 0; w < words.size(); ++w) {
+        m_minTree[m_treeLeaves + w] = m_wordMin[w];
+    }
+
+    for (uint64_t n = m_treeLeaves - 1; n > 0; --n) {
+        m_minTree[n] = std::min(m_minTree[2 * n], m_minTree[2 * n + 1]);
+    }
+}
+
+//Number of opening minus closing parentheses in [0, i]
+int64_t SuccinctTree::excess(int64_t i) const
+{
+    if (i < 0) {
+        return 0;
+    }
+    return 2 * (int64_t)m_bp.rank1(i + 1) - (i + 1);
+}
+
+//First word at or after the specified one whose minimum excess is <= target
+uint64_t SuccinctTree::findFirstWord(uint64_t first, int64_t target) const
+{
+    if (first >= m_wordMin.size()) {
+        return NONE;
+    }
+
+    uint64_t node = m_treeLeaves + first;
+    while (m_minTree[node] > target) {
+        //Move to the next subtree on the right
+        while (node & 1) {
+            if (node == 1) {
+                return NONE;
+            }
+            node >>= 1;
+        }
+        ++node;
+    }
+
+    while (node < m_treeLeaves) {
+        node = 2 * node;
+        if (m_minTree[node] > target) {
+            ++node;
+        }
+    }
+
+    return node - m_treeLeaves;
+}
+
+//Last word at or before the specified one whose minimum excess is <= target
+int64_t SuccinctTree::findLastWord(int64_t last, int64_t target) const
+{
+    if (last < 0) {
+        return -1;
+    }
+
+    uint64_t node = m_treeLeaves + last;
+    while (m_minTree[node] > target) {
+        //Move to the next subtree on the left
+        while (!(node & 1)) {
+            node >>= 1;
+        }
+        if (node == 1) {
+            return -1;
+        }
+        --node;
+    }
+
+    while (node < m_treeLeaves) {
+        node = 2 * node + 1;
+        if (m_minTree[node] > target) {
+            --node;
+        }
+    }
+
+    return node - m_treeLeaves;
+}
+
+uint64_t SuccinctTree::fwdSearch(uint64_t i, int64_t target) const
+{
+    int64_t e = excess(i);
+    uint64_t j = i + 1;
+
+    //Scan the remainder of the current word
+    for (; j < m_bp.size() && j % 64; ++j) {
+        e += m_bp.get(j) ? 1 : -1;
+        if (e <= target) {
+            return j;
+        }
+    }
+
+    if (j >= m_bp.size()) {
+        return NONE;
+    }
+
+    uint64_t w = findFirstWord(j / 64, target);
+    if (w == NONE) {
+        return NONE;
+    }
+
+    j = w * 64;
+    e = excess((int64_t)j - 1);
+    for (; j < m_bp.size(); ++j) {
+        e += m_bp.get(j) ? 1 : -1;
+        if (e <= target) {
+            return j;
+        }
+    }
+
+    assert(false && "Inconsistent min-excess tree");
+    return NONE;
+}
+
+int64_t SuccinctTree::bwdSearch(uint64_t i, int64_t target) const
+{
+    if (i == 0) {
+        return -1;
+    }
+
+    //Scan backwards to the start of the current word
+    int64_t j = i - 1;
+    int64_t e = excess(j);
+    for (;;) {
+        if (e <= target) {
+            return j;
+        }
+        if (j % 64 == 0) {
+            break;
+        }
+        e -= m_bp.get(j) ? 1 : -1;
+        --j;
+    }
+
+    int64_t w = findLastWord(j / 64 - 1, target);
+    if (w < 0) {
+        return -1;
+    }
+
+    j = w * 64 + 63;
+    e = excess(j);
+    for (; j >= w * 64; --j) {
+        if (e <= target) {
+            return j;
+        }
+        e -= m_bp.get(j) ? 1 : -1;
+    }
+
+    assert(false && "Inconsistent min-excess tree");
+    return -1;
+}
+
+uint64_t SuccinctTree::findClose(uint64_t v) const
+{
+    assert(m_bp.get(v));
+    return fwdSearch(v, excess(v) - 1);
+}
+
+uint64_t SuccinctTree::findOpen(uint64_t c) const
+{
+    assert(!m_bp.get(c));
+    return bwdSearch(c, excess(c)) + 1;
+}
+
+uint64_t SuccinctTree::parent(uint64_t v) const
+{
+    if (v == root()) {
+        return NONE;
+    }
+    return bwdSearch(v, excess(v) - 2) + 1;
+}
+
+uint64_t SuccinctTree::firstChild(uint64_t v) const
+{
+    if (isLeaf(v)) {
+        return NONE;
+    }
+    return v + 1;
+}
+
+uint64_t SuccinctTree::nextSibling(uint64_t v) const
+{
+    uint64_t c = findClose(v);
+    if (c + 1 < m_bp.size() && m_bp.get(c + 1)) {
+        return c + 1;
+    }
+    return NONE;
+}
+
+unsigned SuccinctTree::getChildCount(uint64_t v) const
+{
+    unsigned count = 0;
+    for (uint64_t c = firstChild(v); c != NONE; c = nextSibling(c)) {
+        ++count;
+    }
+    return count;
+}
+
+unsigned SuccinctTree::getIndexInParent(uint64_t v) const
+{
+    unsigned index = 0;
+
+    //Walk back over the preceding siblings
+    while (v > 0 && !m_bp.get(v - 1)) {
+        v = findOpen(v - 1);
+        ++index;
+    }
+    return index;
+}
+
+void SuccinctTree::encodePath(uint64_t v, EncodedPath &path) const
+{
+    std::vector<std::pair<unsigned, unsigned> > levels;
+
+    while (v != root()) {
+        uint64_t p = parent(v);
+        levels.push_back(std::make_pair(getIndexInParent(v),
+                                        EncodedPath::getWidth(getChildCount(p))));
+        v = p;
+    }
+
+    path.truncate(0);
+    for (int i = levels.size() - 1; i >= 0; --i) {
+        path.append(levels[i].first, levels[i].second);
+    }
+}
+
+//Returns the node designated by the path, following
+//segments that have only one child.
+uint64_t SuccinctTree::decodePath(const EncodedPath &path) const
+{
+    uint64_t v = root();
+    uint32_t pos = 0;
+
+    while (!isLeaf(v)) {
+        unsigned count = getChildCount(v);
+        unsigned width = EncodedPath::getWidth(count);
+
+        if (width > 0 && pos == path.length()) {
+            break;
+        }
+
+        if (pos + width > path.length()) {
+            return NONE;
+        }
+
+        unsigned index = path.read(pos, width);
+        pos += width;
+        if (index >= count) {
+            return NONE;
+        }
+
+        v = firstChild(v);
+        while (index-- > 0) {
+            v = nextSibling(v);
+        }
+    }
+
+    if (pos != path.length()) {
+        return NONE;
+    }
+    return v;
+}
+
+uint64_t SuccinctTree::getMemoryUsage() const
+{
+    return m_bp.getMemoryUsage() + m_leaves.getMemoryUsage() +
+           m_leafStates.size() * sizeof(uint32_t) +
+           (m_wordMin.size() + m_minTree.size()) * sizeof(int64_t);
+}
+
+}
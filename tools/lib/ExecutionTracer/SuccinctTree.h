@@ -0,0 +1,231 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#ifndef S2ETOOLS_EXECTRACER_SUCCINCTTREE_H
+#define S2ETOOLS_EXECTRACER_SUCCINCTTREE_H
+
+#include <vector>
+#include <ostream>
+#include <inttypes.h>
+
+namespace s2etools
+{
+
+class PathSegment;
+
+/**
+ *  Bit vector with constant-time rank and logarithmic-time select.
+ *  Call finalize() after the last push_back() and before any query.
+ */
+class RankBitVector
+{
+private:
+    std::vector<uint64_t> m_words;
+
+    //Number of ones before each 512-bit superblock
+    std::vector<uint64_t> m_superBlocks;
+    uint64_t m_size;
+    uint64_t m_ones;
+
+public:
+    RankBitVector();
+
+    void push_back(bool b);
+    void finalize();
+
+    bool get(uint64_t i) const {
+        return (m_words[i / 64] >> (i % 64)) & 1;
+    }
+
+    uint64_t size() const {
+        return m_size;
+    }
+
+    uint64_t ones() const {
+        return m_ones;
+    }
+
+    const std::vector<uint64_t> &words() const {
+        return m_words;
+    }
+
+    //Number of ones in [0, i)
+    uint64_t rank1(uint64_t i) const;
+
+    //Position of the k-th one (k starts at 0)
+    uint64_t select1(uint64_t k) const;
+
+    uint64_t getMemoryUsage() const;
+};
+
+/**
+ *  Execution path encoded as a bit string.
+ *  At each fork, the index of the taken child is stored on
+ *  ceil(log2(number of children)) bits, i.e., one bit for binary forks.
+ *  Paths compare in depth-first order, and a path is an ancestor of
+ *  another if it is a prefix of it.
+ */
+class EncodedPath
+{
+private:
+    std::vector<uint32_t> m_words;
+    uint32_t m_length;
+
+public:
+    EncodedPath();
+
+    static unsigned getWidth(unsigned childCount);
+
+    void append(uint32_t value, unsigned width);
+    void truncate(uint32_t length);
+
+    uint32_t length() const {
+        return m_length;
+    }
+
+    bool getBit(uint32_t i) const {
+        return (m_words[i / 32] >> (31 - i % 32)) & 1;
+    }
+
+    uint32_t read(uint32_t pos, unsigned width) const;
+
+    bool isPrefixOf(const EncodedPath &p) const;
+    bool operator<(const EncodedPath &p) const;
+    bool operator==(const EncodedPath &p) const;
+
+    void print(std::ostream &os) const;
+};
+
+typedef std::vector<EncodedPath> EncodedPaths;
+
+/**
+ *  Balanced parentheses representation of the tree of path segments.
+ *  Each segment takes two bits. A node is identified by the position of its
+ *  opening parenthesis. Navigation relies on a range min-excess tree
+ *  over the 64-bit words of the sequence.
+ */
+class SuccinctTree
+{
+public:
+    static const uint64_t NONE = (uint64_t) -1;
+
+private:
+    RankBitVector m_bp;
+
+    //Leaves are "()" patterns, marked at the position of the opening parenthesis
+    RankBitVector m_leaves;
+
+    //State id of each leaf, in depth-first order
+    std::vector<uint32_t> m_leafStates;
+
+    //Minimum absolute excess in each word, and the min tree over them
+    std::vector<int64_t> m_wordMin;
+    std::vector<int64_t> m_minTree;
+    uint64_t m_treeLeaves;
+
+    int64_t excess(int64_t i) const;
+    void buildMinTree();
+
+    //Smallest j > i such that excess(j) <= target, NONE if there is none
+    uint64_t fwdSearch(uint64_t i, int64_t target) const;
+
+    //Largest j < i such that excess(j) <= target, -1 if there is none
+    int64_t bwdSearch(uint64_t i, int64_t target) const;
+
+    uint64_t findFirstWord(uint64_t first, int64_t target) const;
+    int64_t findLastWord(int64_t last, int64_t target) const;
+
+public:
+    SuccinctTree(const PathSegment *root);
+
+    uint64_t getNodeCount() const {
+        return m_bp.size() / 2;
+    }
+
+    uint64_t getLeafCount() const {
+        return m_leafStates.size();
+    }
+
+    uint64_t root() const {
+        return 0;
+    }
+
+    bool isLeaf(uint64_t v) const {
+        return !m_bp.get(v + 1);
+    }
+
+    unsigned depth(uint64_t v) const {
+        return excess(v) - 1;
+    }
+
+    uint64_t findClose(uint64_t v) const;
+    uint64_t findOpen(uint64_t c) const;
+    uint64_t parent(uint64_t v) const;
+    uint64_t firstChild(uint64_t v) const;
+    uint64_t nextSibling(uint64_t v) const;
+    unsigned getChildCount(uint64_t v) const;
+    unsigned getIndexInParent(uint64_t v) const;
+
+    //Number of nodes in the subtree rooted at v, including v
+    uint64_t getSubtreeSize(uint64_t v) const {
+        return (findClose(v) - v + 1) / 2;
+    }
+
+    bool isAncestor(uint64_t u, uint64_t v) const {
+        return u <= v && v < findClose(u);
+    }
+
+    //Leaves are numbered in depth-first order
+    uint64_t getLeaf(uint64_t k) const {
+        return m_leaves.select1(k);
+    }
+
+    uint64_t getLeafIndex(uint64_t v) const {
+        return m_leaves.rank1(v);
+    }
+
+    uint32_t getLeafStateId(uint64_t k) const {
+        return m_leafStates[k];
+    }
+
+    void encodePath(uint64_t v, EncodedPath &path) const;
+    uint64_t decodePath(const EncodedPath &path) const;
+
+    uint64_t getMemoryUsage() const;
+};
+
+}
+
+#endif
@@ -139,4 +139,51 @@ ItemProcessorState *TestCaseState::clone() const
     return new TestCaseState(*this);
 }
 
+uint64_t TestCaseState::getMemoryUsage() const
+{
+    uint64_t bytes = sizeof(*this);
+    ExecutionTraceTestCase::ConcreteInputs::const_iterator it;
+    for (it = m_inputs.begin(); it != m_inputs.end(); ++it) {
+        bytes += sizeof(*it) + (*it).first.capacity() + (*it).second.capacity();
+    }
+    return bytes;
+}
+
+bool TestCaseState::serialize(std::ostream &os) const
+{
+    uint8_t found = m_foundInputs;
+    uint32_t count = m_inputs.size();
+    writeValue(os, found);
+    writeValue(os, count);
+
+    ExecutionTraceTestCase::ConcreteInputs::const_iterator it;
+    for (it = m_inputs.begin(); it != m_inputs.end(); ++it) {
+        const ExecutionTraceTestCase::VarValuePair &vp = *it;
+        writeString(os, vp.first);
+        writeString(os, std::string(vp.second.begin(), vp.second.end()));
+    }
+    return os.good();
+}
+
+bool TestCaseState::deserialize(std::istream &is)
+{
+    uint8_t found;
+    uint32_t count;
+    if (!readValue(is, found) || !readValue(is, count)) {
+        return false;
+    }
+
+    m_foundInputs = found;
+    m_inputs.clear();
+    for (uint32_t i = 0; i < count; ++i) {
+        std::string name, value;
+        if (!readString(is, name) || !readString(is, value)) {
+            return false;
+        }
+        m_inputs.push_back(ExecutionTraceTestCase::VarValuePair(
+                name, std::vector<unsigned char>(value.begin(), value.end())));
+    }
+    return true;
+}
+
 }
@@ -70,6 +70,9 @@ public:
 
     static ItemProcessorState *factory();
     virtual ItemProcessorState *clone() const;
+    virtual bool serialize(std::ostream &os) const;
+    virtual bool deserialize(std::istream &is);
+    virtual uint64_t getMemoryUsage() const;
 
     bool getInputs(const s2e::plugins::ExecutionTraceTestCase::ConcreteInputs &out) const;
     bool hasInputs() const {
@@ -0,0 +1,334 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#include <cassert>
+
+#include "TreeStatistics.h"
+#include "Path.h"
+
+using namespace s2e::plugins;
+
+namespace s2etools
+{
+
+LogHistogram::LogHistogram()
+{
+    m_Count = 0;
+    m_Sum = 0;
+    m_Min = (uint64_t)-1;
+    m_Max = 0;
+}
+
+void LogHistogram::add(uint64_t value)
+{
+    unsigned bucket = 0;
+    for (uint64_t v = value; v; v >>= 1) {
+        ++bucket;
+    }
+
+    if (m_Buckets.size() <= bucket) {
+        m_Buckets.resize(bucket + 1, 0);
+    }
+    ++m_Buckets[bucket];
+
+    ++m_Count;
+    m_Sum += value;
+    if (value < m_Min) {
+        m_Min = value;
+    }
+    if (value > m_Max) {
+        m_Max = value;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+//Segment on the path being explored, with the totals of its visited subtree
+struct TreeStatisticsFrame
+{
+    const PathSegment *seg;
+    unsigned nextChild;
+    unsigned depth;
+
+    //When the state of the segment was created
+    uint64_t created;
+
+    uint64_t pathItems;
+    uint64_t subtreeSegments;
+    uint64_t subtreeItems;
+};
+
+uint64_t getItemCount(const PathSegment *seg)
+{
+    const PathFragmentList &fra = seg->getFragmentList();
+    PathFragmentList::const_iterator it;
+    uint64_t count = 0;
+    for (it = fra.begin(); it != fra.end(); ++it) {
+        count += (*it).endIndex - (*it).startIndex + 1;
+    }
+    return count;
+}
+
+}
+
+TreeStatistics::TreeStatistics(LogParser *parser, PathBuilder *pb)
+{
+    m_Parser = parser;
+    m_Builder = pb;
+    m_Segments = 0;
+    m_Paths = 0;
+    m_Items = 0;
+    m_LongestPath = 0;
+    m_LongestPathItems = 0;
+    m_DeepestPath = 0;
+    m_DeepestPathDepth = 0;
+}
+
+bool TreeStatistics::getTimeStamps(const PathSegment *seg, uint64_t &first, uint64_t &last) const
+{
+    const PathFragmentList &fra = seg->getFragmentList();
+    if (fra.empty()) {
+        return false;
+    }
+
+    ExecutionTraceItemHeader hdr;
+    void *data;
+
+    if (!m_Parser->getItem(fra.front().startIndex, hdr, &data)) {
+        assert(false && "Trace is broken");
+    }
+    first = hdr.timeStamp;
+
+    if (!m_Parser->getItem(fra.back().endIndex, hdr, &data)) {
+        assert(false && "Trace is broken");
+    }
+    last = hdr.timeStamp;
+    return true;
+}
+
+void TreeStatistics::compute()
+{
+    std::vector<TreeStatisticsFrame> stack;
+    const PathSegment *seg = m_Builder->getRoot();
+
+    while (seg) {
+        //Entering a new segment
+        TreeStatisticsFrame f;
+        uint64_t items = getItemCount(seg);
+        uint64_t first = 0, last = 0;
+        bool hasTime = getTimeStamps(seg, first, last);
+
+        f.seg = seg;
+        f.nextChild = 0;
+        f.depth = stack.size();
+        f.pathItems = items;
+        f.subtreeSegments = 1;
+        f.subtreeItems = items;
+        f.created = first;
+
+        if (!stack.empty()) {
+            const TreeStatisticsFrame &parent = stack.back();
+            f.pathItems += parent.pathItems;
+            //Forks create a new segment for the forking state too
+            if (parent.seg->getStateId() == seg->getStateId() || !hasTime) {
+                f.created = parent.created;
+            }
+        }
+
+        ++m_Segments;
+        m_Items += items;
+        m_SegmentItems.add(items);
+        if (m_DepthSegments.size() <= f.depth) {
+            m_DepthSegments.resize(f.depth + 1, 0);
+        }
+        ++m_DepthSegments[f.depth];
+
+        stack.push_back(f);
+        seg = NULL;
+
+        while (!stack.empty()) {
+            TreeStatisticsFrame &top = stack.back();
+            const PathSegmentList &children = top.seg->getChildren();
+
+            if (top.nextChild < children.size()) {
+                seg = children[top.nextChild++];
+                break;
+            }
+
+            //Leaving the segment, its subtree is complete
+            ++m_FanOut[children.size()];
+            m_SubtreeSegments.add(top.subtreeSegments);
+            m_SubtreeItems.add(top.subtreeItems);
+
+            if (children.empty()) {
+                uint32_t pathId = top.seg->getStateId();
+                ++m_Paths;
+
+                if (m_LeafDepths.size() <= top.depth) {
+                    m_LeafDepths.resize(top.depth + 1, 0);
+                }
+                ++m_LeafDepths[top.depth];
+
+                if (top.pathItems > m_LongestPathItems) {
+                    m_LongestPathItems = top.pathItems;
+                    m_LongestPath = pathId;
+                }
+
+                if (top.depth > m_DeepestPathDepth || m_Paths == 1) {
+                    m_DeepestPathDepth = top.depth;
+                    m_DeepestPath = pathId;
+                }
+
+                uint64_t leafFirst, leafLast;
+                if (getTimeStamps(top.seg, leafFirst, leafLast)) {
+                    m_Lifetimes.add(leafLast - top.created);
+                } else {
+                    m_Lifetimes.add(0);
+                }
+            }
+
+            TreeStatisticsFrame done = top;
+            stack.pop_back();
+            if (!stack.empty()) {
+                stack.back().subtreeSegments += done.subtreeSegments;
+                stack.back().subtreeItems += done.subtreeItems;
+            }
+        }
+    }
+}
+
+void TreeStatistics::writeHistogramCsv(std::ostream &os, const char *name, const LogHistogram &h) const
+{
+    const std::vector<uint64_t> &b = h.getBuckets();
+    for (unsigned i = 0; i < b.size(); ++i) {
+        if (b[i]) {
+            os << name << "," << LogHistogram::getBucketStart(i) << "," << b[i] << std::endl;
+        }
+    }
+    os << name << "_min,," << h.getMin() << std::endl;
+    os << name << "_max,," << h.getMax() << std::endl;
+    os << name << "_sum,," << h.getSum() << std::endl;
+}
+
+void TreeStatistics::writeCsv(std::ostream &os) const
+{
+    os << std::dec;
+    os << "metric,value,count" << std::endl;
+    os << "segments,," << m_Segments << std::endl;
+    os << "paths,," << m_Paths << std::endl;
+    os << "items,," << m_Items << std::endl;
+    os << "longest_path," << m_LongestPath << "," << m_LongestPathItems << std::endl;
+    os << "deepest_path," << m_DeepestPath << "," << m_DeepestPathDepth << std::endl;
+
+    for (unsigned i = 0; i < m_LeafDepths.size(); ++i) {
+        if (m_LeafDepths[i]) {
+            os << "leaf_depth," << i << "," << m_LeafDepths[i] << std::endl;
+        }
+    }
+
+    for (unsigned i = 0; i < m_DepthSegments.size(); ++i) {
+        os << "depth_segments," << i << "," << m_DepthSegments[i] << std::endl;
+    }
+
+    Distribution::const_iterator it;
+    for (it = m_FanOut.begin(); it != m_FanOut.end(); ++it) {
+        os << "fanout," << (*it).first << "," << (*it).second << std::endl;
+    }
+
+    writeHistogramCsv(os, "subtree_segments", m_SubtreeSegments);
+    writeHistogramCsv(os, "subtree_items", m_SubtreeItems);
+    writeHistogramCsv(os, "segment_items", m_SegmentItems);
+    writeHistogramCsv(os, "lifetime", m_Lifetimes);
+}
+
+void TreeStatistics::writeHistogramJson(std::ostream &os, const char *name, const LogHistogram &h) const
+{
+    os << "  \"" << name << "\": {\"min\": " << h.getMin() << ", \"max\": " << h.getMax()
+       << ", \"sum\": " << h.getSum() << ", \"count\": " << h.getCount() << ", \"buckets\": [";
+
+    const std::vector<uint64_t> &b = h.getBuckets();
+    bool firstBucket = true;
+    for (unsigned i = 0; i < b.size(); ++i) {
+        if (!b[i]) {
+            continue;
+        }
+        os << (firstBucket ? "" : ", ") << "[" << LogHistogram::getBucketStart(i) << ", " << b[i] << "]";
+        firstBucket = false;
+    }
+    os << "]}";
+}
+
+void TreeStatistics::writeJson(std::ostream &os) const
+{
+    os << std::dec;
+    os << "{" << std::endl;
+    os << "  \"segments\": " << m_Segments << "," << std::endl;
+    os << "  \"paths\": " << m_Paths << "," << std::endl;
+    os << "  \"items\": " << m_Items << "," << std::endl;
+    os << "  \"longest_path\": {\"id\": " << m_LongestPath << ", \"items\": " << m_LongestPathItems << "}," << std::endl;
+    os << "  \"deepest_path\": {\"id\": " << m_DeepestPath << ", \"depth\": " << m_DeepestPathDepth << "}," << std::endl;
+
+    os << "  \"leaf_depth\": [";
+    for (unsigned i = 0; i < m_LeafDepths.size(); ++i) {
+        os << (i ? ", " : "") << m_LeafDepths[i];
+    }
+    os << "]," << std::endl;
+
+    os << "  \"depth_segments\": [";
+    for (unsigned i = 0; i < m_DepthSegments.size(); ++i) {
+        os << (i ? ", " : "") << m_DepthSegments[i];
+    }
+    os << "]," << std::endl;
+
+    os << "  \"fanout\": {";
+    Distribution::const_iterator it;
+    for (it = m_FanOut.begin(); it != m_FanOut.end(); ++it) {
+        os << (it == m_FanOut.begin() ? "" : ", ") << "\"" << (*it).first << "\": " << (*it).second;
+    }
+    os << "}," << std::endl;
+
+    writeHistogramJson(os, "subtree_segments", m_SubtreeSegments);
+    os << "," << std::endl;
+    writeHistogramJson(os, "subtree_items", m_SubtreeItems);
+    os << "," << std::endl;
+    writeHistogramJson(os, "segment_items", m_SegmentItems);
+    os << "," << std::endl;
+    writeHistogramJson(os, "lifetime", m_Lifetimes);
+    os << std::endl << "}" << std::endl;
+}
+
+}
@@ -0,0 +1,135 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#ifndef S2ETOOLS_EXECTRACER_TREESTATISTICS_H
+#define S2ETOOLS_EXECTRACER_TREESTATISTICS_H
+
+#include <inttypes.h>
+#include <ostream>
+#include <vector>
+#include <map>
+
+#include "LogParser.h"
+
+namespace s2etools
+{
+
+class PathBuilder;
+class PathSegment;
+
+/**
+ *  Distribution of values in power-of-two buckets.
+ *  Bucket 0 holds zeros, bucket i holds [2^(i-1), 2^i).
+ */
+class LogHistogram
+{
+private:
+    std::vector<uint64_t> m_Buckets;
+    uint64_t m_Count, m_Sum, m_Min, m_Max;
+
+public:
+    LogHistogram();
+
+    void add(uint64_t value);
+
+    static uint64_t getBucketStart(unsigned bucket) {
+        return bucket == 0 ? 0 : (uint64_t)1 << (bucket - 1);
+    }
+
+    const std::vector<uint64_t> &getBuckets() const {
+        return m_Buckets;
+    }
+
+    uint64_t getCount() const { return m_Count; }
+    uint64_t getSum() const { return m_Sum; }
+    uint64_t getMin() const { return m_Count ? m_Min : 0; }
+    uint64_t getMax() const { return m_Max; }
+};
+
+/**
+ *  Shape of the execution tree built by a PathBuilder.
+ *  Computed in one depth-first traversal that visits each segment once
+ *  and only keeps the stack of the current path.
+ */
+class TreeStatistics
+{
+public:
+    //Value to number of occurrences
+    typedef std::map<uint64_t, uint64_t> Distribution;
+
+private:
+    LogParser *m_Parser;
+    PathBuilder *m_Builder;
+
+    uint64_t m_Segments;
+    uint64_t m_Paths;
+    uint64_t m_Items;
+
+    //Number of leaves at each depth, and of segments at each depth.
+    //Segments are not states: a state that forks continues in a new
+    //segment one level deeper, next to the states it forked.
+    std::vector<uint64_t> m_LeafDepths;
+    std::vector<uint64_t> m_DepthSegments;
+
+    Distribution m_FanOut;
+
+    LogHistogram m_SubtreeSegments;
+    LogHistogram m_SubtreeItems;
+    LogHistogram m_SegmentItems;
+    LogHistogram m_Lifetimes;
+
+    uint32_t m_LongestPath;
+    uint64_t m_LongestPathItems;
+    uint32_t m_DeepestPath;
+    unsigned m_DeepestPathDepth;
+
+    bool getTimeStamps(const PathSegment *seg, uint64_t &first, uint64_t &last) const;
+
+    void writeHistogramCsv(std::ostream &os, const char *name, const LogHistogram &h) const;
+    void writeHistogramJson(std::ostream &os, const char *name, const LogHistogram &h) const;
+
+public:
+    TreeStatistics(LogParser *parser, PathBuilder *pb);
+
+    void compute();
+
+    //One "metric,value,count" record per line
+    void writeCsv(std::ostream &os) const;
+    void writeJson(std::ostream &os) const;
+};
+
+}
+
+#endif
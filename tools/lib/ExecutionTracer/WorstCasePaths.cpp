@@ -0,0 +1,308 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#include <queue>
+#include <stack>
+#include <iomanip>
+#include <cassert>
+#include <algorithm>
+
+#include "WorstCasePaths.h"
+#include "Path.h"
+
+using namespace s2e::plugins;
+
+namespace s2etools
+{
+
+namespace {
+
+//Subtree on the search frontier. The cost at the start of the segment
+//is exact. Leaf candidates wait for the evaluator, and
+//exact ones have no refinement pending.
+struct SearchCandidate
+{
+    enum Kind {
+        SUBTREE, LEAF, EXACT
+    };
+
+    uint64_t bound;
+    uint64_t startCost;
+    const PathSegment *seg;
+    Kind kind;
+
+    SearchCandidate(uint64_t b, uint64_t start, const PathSegment *s, Kind k) {
+        bound = b;
+        startCost = start;
+        seg = s;
+        kind = k;
+    }
+
+    //Highest bound first, the most refined candidates first on ties
+    bool operator<(const SearchCandidate &c) const {
+        if (bound != c.bound) {
+            return bound < c.bound;
+        }
+        if (kind != c.kind) {
+            return kind < c.kind;
+        }
+        return seg->getStateId() > c.seg->getStateId();
+    }
+};
+
+typedef std::priority_queue<SearchCandidate> SearchFrontier;
+
+}
+
+WorstCasePaths::WorstCasePaths(LogParser *parser, PathBuilder *pb, Metric metric)
+{
+    m_Parser = parser;
+    m_Builder = pb;
+    m_Metric = metric;
+    m_ExpandedSegments = 0;
+    m_VisitedSegments = 0;
+    m_EvaluatedPaths = 0;
+    m_EvaluationPasses = 0;
+}
+
+//Instruction count at the end of the segment, or what the items
+//of the segment add to the page faults or cache misses
+uint64_t WorstCasePaths::getSegmentCost(const PathSegment *seg, uint64_t startCost) const
+{
+    const PathFragmentList &fra = seg->getFragmentList();
+    ExecutionTraceItemHeader hdr;
+    void *data;
+
+    //The instruction count is absolute, only the last one matters
+    if (m_Metric == ICOUNT) {
+        PathFragmentList::const_reverse_iterator rit;
+        for (rit = fra.rbegin(); rit != fra.rend(); ++rit) {
+            for (uint32_t s = (*rit).endIndex + 1; s > (*rit).startIndex; --s) {
+                if (!m_Parser->getItem(s - 1, hdr, &data)) {
+                    assert(false && "Trace is broken");
+                }
+                if (hdr.type == TRACE_ICOUNT) {
+                    uint64_t count = static_cast<ExecutionTraceICount*>(data)->count;
+                    return count > startCost ? count : startCost;
+                }
+            }
+        }
+        return startCost;
+    }
+
+    //Only the headers are looked at, except for cache entries
+    uint64_t cost = 0;
+    PathFragmentList::const_iterator it;
+    for (it = fra.begin(); it != fra.end(); ++it) {
+        for (uint32_t s = (*it).startIndex; s <= (*it).endIndex; ++s) {
+            if (!m_Parser->getItem(s, hdr, &data)) {
+                assert(false && "Trace is broken");
+            }
+
+            if (m_Metric == CACHE_MISSES && hdr.type == TRACE_CACHESIM) {
+                const ExecutionTraceCache *c = static_cast<ExecutionTraceCache*>(data);
+                if (c->type == CACHE_ENTRY) {
+                    cost += c->entry.missCount;
+                }
+            } else if (m_Metric == PAGE_FAULTS && hdr.type == TRACE_PAGEFAULT) {
+                ++cost;
+            }
+        }
+    }
+
+    return cost;
+}
+
+//One pass over the tree. The bound of a subtree is the highest
+//cost of its paths, counted from the start of its root segment.
+void WorstCasePaths::computeBounds()
+{
+    std::stack<std::pair<const PathSegment*, bool> > s;
+    s.push(std::make_pair(m_Builder->getRoot(), false));
+
+    while (!s.empty()) {
+        const PathSegment *seg = s.top().first;
+        const PathSegmentList &children = seg->getChildren();
+
+        if (!s.top().second) {
+            s.top().second = true;
+
+            uint64_t startCost = 0;
+            if (m_Metric == ICOUNT && seg->getParent()) {
+                startCost = m_Costs[seg->getParent()];
+            }
+            m_Costs[seg] = getSegmentCost(seg, startCost);
+
+            PathSegmentList::const_iterator it;
+            for (it = children.begin(); it != children.end(); ++it) {
+                s.push(std::make_pair(*it, false));
+            }
+            continue;
+        }
+
+        s.pop();
+
+        uint64_t childBound = 0;
+        PathSegmentList::const_iterator it;
+        for (it = children.begin(); it != children.end(); ++it) {
+            childBound = std::max(childBound, m_Bounds[*it]);
+        }
+
+        if (m_Metric == ICOUNT) {
+            m_Bounds[seg] = std::max(m_Costs[seg], childBound);
+        } else {
+            m_Bounds[seg] = m_Costs[seg] + childBound;
+        }
+    }
+}
+
+void WorstCasePaths::search(unsigned k, Results &results, PathCostEvaluator *evaluator)
+{
+    results.clear();
+    m_ExpandedSegments = 0;
+    m_VisitedSegments = 0;
+    m_EvaluatedPaths = 0;
+    m_EvaluationPasses = 0;
+
+    if (m_Bounds.empty()) {
+        computeBounds();
+    }
+
+    SearchFrontier frontier;
+    const PathSegment *root = m_Builder->getRoot();
+    frontier.push(SearchCandidate(m_Bounds[root], 0, root, SearchCandidate::SUBTREE));
+
+    //Leaves waiting for the evaluator. The batches grow when the refined
+    //costs keep falling behind the bounds, to bound the number of passes.
+    PathSet pending;
+    std::map<uint32_t, const PathSegment*> pendingLeaves;
+    size_t batchSize = k;
+
+    while (results.size() < k) {
+        //Evaluate the pending leaves once the batch is full,
+        //or before an exact candidate could overtake them
+        bool flush = !pending.empty() &&
+                     (frontier.empty() || frontier.top().kind == SearchCandidate::EXACT ||
+                      pending.size() >= batchSize);
+
+        if (flush) {
+            PathCosts costs;
+            evaluator->getCosts(pending, costs);
+            ++m_EvaluationPasses;
+            m_EvaluatedPaths += pending.size();
+            batchSize *= 2;
+
+            std::map<uint32_t, const PathSegment*>::const_iterator it;
+            for (it = pendingLeaves.begin(); it != pendingLeaves.end(); ++it) {
+                uint64_t cost = costs[(*it).first];
+                frontier.push(SearchCandidate(cost, cost, (*it).second, SearchCandidate::EXACT));
+            }
+            pending.clear();
+            pendingLeaves.clear();
+            continue;
+        }
+
+        if (frontier.empty()) {
+            break;
+        }
+
+        SearchCandidate c = frontier.top();
+        frontier.pop();
+
+        const PathSegmentList &children = c.seg->getChildren();
+
+        if (c.kind == SearchCandidate::SUBTREE) {
+            ++m_VisitedSegments;
+            uint64_t cost = m_Costs[c.seg];
+            if (m_Metric != ICOUNT) {
+                cost += c.startCost;
+            }
+
+            if (children.empty()) {
+                SearchCandidate::Kind kind = evaluator ? SearchCandidate::LEAF : SearchCandidate::EXACT;
+                frontier.push(SearchCandidate(cost, cost, c.seg, kind));
+                continue;
+            }
+
+            //Subtrees whose bound is below the k-th result are never popped
+            ++m_ExpandedSegments;
+            PathSegmentList::const_iterator it;
+            for (it = children.begin(); it != children.end(); ++it) {
+                uint64_t bound = m_Bounds[*it];
+                if (m_Metric != ICOUNT) {
+                    bound += cost;
+                }
+                frontier.push(SearchCandidate(bound, cost, *it, SearchCandidate::SUBTREE));
+            }
+            continue;
+        }
+
+        //The refined cost cannot exceed the bound,
+        //the leaf goes back to the frontier at its actual place.
+        if (c.kind == SearchCandidate::LEAF) {
+            pending.insert(c.seg->getStateId());
+            pendingLeaves[c.seg->getStateId()] = c.seg;
+            continue;
+        }
+
+        Result r;
+        r.pathId = c.seg->getStateId();
+        r.cost = c.bound;
+        r.leaf = c.seg;
+        results.push_back(r);
+    }
+}
+
+void WorstCasePaths::printForkDecisions(const PathSegment *leaf, std::ostream &os)
+{
+    std::vector<const PathSegment*> segments;
+    for (const PathSegment *seg = leaf; seg; seg = seg->getParent()) {
+        segments.push_back(seg);
+    }
+
+    for (int i = segments.size() - 1; i >= 0; --i) {
+        const PathSegment *seg = segments[i];
+        const PathSegment *parent = seg->getParent();
+        if (!parent) {
+            continue;
+        }
+
+        os << "  fork at 0x" << std::hex << seg->getForkPc() << std::dec
+           << ": branch " << seg->getIndexInParent() << "/" << parent->getChildren().size()
+           << " (state " << seg->getStateId() << ")" << std::endl;
+    }
+}
+
+}
@@ -0,0 +1,151 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#ifndef S2ETOOLS_EXECTRACER_WORSTCASEPATHS_H
+#define S2ETOOLS_EXECTRACER_WORSTCASEPATHS_H
+
+#include <s2e/Plugins/ExecutionTracers/TraceEntries.h>
+#include <ostream>
+#include <vector>
+#include <map>
+
+#include "LogParser.h"
+
+namespace s2etools
+{
+
+class PathBuilder;
+class PathSegment;
+
+typedef std::map<uint32_t, uint64_t> PathCosts;
+
+/**
+ *  Computes the exact cost of paths, when the bounds derived
+ *  from the raw trace items may be larger than the actual cost.
+ *  The candidates are handed over in batches, so that they can be
+ *  processed in one traversal of the tree.
+ */
+class PathCostEvaluator
+{
+public:
+    virtual ~PathCostEvaluator() {}
+    virtual void getCosts(const PathSet &paths, PathCosts &costs) = 0;
+};
+
+/**
+ *  Finds the k paths of the execution tree with the highest cost,
+ *  without running the trace processors on every path.
+ *
+ *  The counters only grow along a path. One pass over the tree records
+ *  what each segment adds to the counter, which only needs the item headers
+ *  (and the tail of the segments for the absolute instruction count).
+ *  The bound of a subtree is then the cost of its most expensive path.
+ *
+ *  The tree is explored best-first from these bounds, only the segments
+ *  leading to the top k paths are visited. With an evaluator, e.g., to only
+ *  count the events of some module, the bounds remain valid upper bounds and
+ *  the subtrees that cannot enter the top k are never evaluated.
+ */
+class WorstCasePaths
+{
+public:
+    enum Metric {
+        ICOUNT, CACHE_MISSES, PAGE_FAULTS
+    };
+
+    struct Result {
+        uint32_t pathId;
+        uint64_t cost;
+        const PathSegment *leaf;
+    };
+
+    typedef std::vector<Result> Results;
+
+private:
+    typedef std::map<const PathSegment*, uint64_t> SegmentCosts;
+
+    LogParser *m_Parser;
+    PathBuilder *m_Builder;
+    Metric m_Metric;
+
+    //Instruction count at the end of each segment,
+    //or what the segment adds for the other metrics
+    SegmentCosts m_Costs;
+
+    //Highest instruction count below each segment, or highest
+    //cost that the path can add from the start of the segment
+    SegmentCosts m_Bounds;
+
+    unsigned m_ExpandedSegments;
+    unsigned m_VisitedSegments;
+    unsigned m_EvaluatedPaths;
+    unsigned m_EvaluationPasses;
+
+    uint64_t getSegmentCost(const PathSegment *seg, uint64_t startCost) const;
+    void computeBounds();
+
+public:
+    WorstCasePaths(LogParser *parser, PathBuilder *pb, Metric metric);
+
+    //Results are sorted by decreasing cost. If evaluator is set, the cost of
+    //each candidate leaf is refined with it before entering the results.
+    void search(unsigned k, Results &results, PathCostEvaluator *evaluator = NULL);
+
+    //Segments whose children were pushed on the search frontier
+    unsigned getExpandedSegments() const {
+        return m_ExpandedSegments;
+    }
+
+    //Segments popped from the search frontier
+    unsigned getVisitedSegments() const {
+        return m_VisitedSegments;
+    }
+
+    unsigned getEvaluatedPaths() const {
+        return m_EvaluatedPaths;
+    }
+
+    //Calls to the evaluator
+    unsigned getEvaluationPasses() const {
+        return m_EvaluationPasses;
+    }
+
+    //Prints the fork points and the branch taken at each of them
+    static void printForkDecisions(const PathSegment *leaf, std::ostream &os);
+};
+
+}
+
+#endif
@@ -41,6 +41,8 @@
 #include <lib/ExecutionTracer/Path.h>
 #include <lib/ExecutionTracer/TestCase.h>
 #include <lib/ExecutionTracer/CacheProfiler.h>
+#include <lib/ExecutionTracer/PageFault.h>
+#include <lib/ExecutionTracer/WorstCasePaths.h>
 #include <lib/BinaryReaders/BFDInterface.h>
 #include <lib/BinaryReaders/Library.h>
 
@@ -71,6 +73,33 @@ cl::opt<std::string>
 cl::list<std::string>
     ModPath("modpath", cl::desc("Path to modules"));
 
+cl::opt<std::string>
+    SnapshotFile("snapshot", cl::desc("Periodically save the state of the analysis to this file"), cl::init(""));
+
+cl::opt<unsigned>
+    SnapshotInterval("snapshotinterval", cl::desc("Number of trace items between two snapshots"), cl::init(1000000));
+
+cl::opt<bool>
+    Resume("resume", cl::desc("Resume the analysis from the file given by -snapshot"), cl::init(false));
+
+cl::opt<unsigned>
+    MemBudget("membudget", cl::desc("Memory budget of the processor states in MB, spilled to disk above it (0 for no limit)"), cl::init(0));
+
+cl::opt<bool>
+    MemReport("mem-report", cl::desc("Write the memory used by the states of each trace processor to memreport.txt"), cl::init(false));
+
+cl::opt<std::string>
+    AnaType("type", cl::desc("Type of analysis (cache/worst)"), cl::init("cache"));
+
+cl::opt<std::string>
+    WorstMetric("metric", cl::desc("Worst-case analysis: cost of a path (icount/cachemiss/pagefault)"), cl::init("cachemiss"));
+
+cl::opt<unsigned>
+    WorstCount("topk", cl::desc("Worst-case analysis: number of paths to report"), cl::init(10));
+
+cl::opt<std::string>
+    FilterModule("filtermodule", cl::desc("Worst-case analysis: only count the page faults of this module"), cl::init(""));
+
 }
 
 
@@ -143,6 +172,98 @@ void printGlobalCacheStats(PathBuilder &pb,
     outFile << "#CompletedPaths: " << completedPath << std::endl;
 }
 
+/**
+ *  Page faults outside the filtered module only count in the bounds.
+ *  The exact counts of the candidate paths are obtained by processing
+ *  each batch of candidates in one traversal.
+ */
+class FilteredPageFaults: public PathCostEvaluator
+{
+private:
+    PathBuilder *m_Builder;
+    PageFault *m_PageFault;
+
+public:
+    FilteredPageFaults(PathBuilder *pb, PageFault *pf) {
+        m_Builder = pb;
+        m_PageFault = pf;
+    }
+
+    virtual void getCosts(const PathSet &paths, PathCosts &costs) {
+        m_Builder->processPaths(paths);
+
+        PathSet::const_iterator it;
+        for (it = paths.begin(); it != paths.end(); ++it) {
+            PageFaultState *pfs = static_cast<PageFaultState*>(m_Builder->getState(m_PageFault, *it));
+            costs[*it] = pfs ? pfs->getPageFaults() : 0;
+        }
+    }
+};
+
+//Reports the k most expensive paths without processing the whole tree
+int findWorstPaths(LogParser &parser, PathBuilder &pb, ModuleCache &mc, TestCase &testCase)
+{
+    WorstCasePaths::Metric metric;
+    if (WorstMetric == "icount") {
+        metric = WorstCasePaths::ICOUNT;
+    } else if (WorstMetric == "cachemiss") {
+        metric = WorstCasePaths::CACHE_MISSES;
+    } else if (WorstMetric == "pagefault") {
+        metric = WorstCasePaths::PAGE_FAULTS;
+    } else {
+        std::cerr << "Unknown metric " << WorstMetric << std::endl;
+        return -1;
+    }
+
+    std::string outFileStr = LogDir + "/worstpaths.txt";
+    std::ofstream outFile(outFileStr.c_str());
+
+    PageFault pf(&pb, &mc);
+    FilteredPageFaults filteredPageFaults(&pb, &pf);
+    PathCostEvaluator *evaluator = NULL;
+
+    if (metric == WorstCasePaths::PAGE_FAULTS && FilterModule.size() > 0) {
+        pf.setModule(FilterModule);
+        evaluator = &filteredPageFaults;
+    }
+
+    WorstCasePaths search(&parser, &pb, metric);
+    WorstCasePaths::Results results;
+    search.search(WorstCount, results, evaluator);
+
+    //Only the selected paths go through the trace processors
+    PathSet paths;
+    for (unsigned i = 0; i < results.size(); ++i) {
+        paths.insert(results[i].pathId);
+    }
+    pb.processPaths(paths);
+
+    outFile << "#Top " << std::dec << WorstCount << " paths by " << WorstMetric << std::endl;
+    outFile << "#Expanded segments: " << search.getExpandedSegments()
+            << ", visited segments: " << search.getVisitedSegments()
+            << ", evaluated paths: " << search.getEvaluatedPaths()
+            << " in " << search.getEvaluationPasses() << " passes" << std::endl;
+
+    for (unsigned i = 0; i < results.size(); ++i) {
+        const WorstCasePaths::Result &r = results[i];
+        outFile << "========== Rank " << std::dec << (i + 1) << ": path " << r.pathId
+                << ", " << WorstMetric << " " << r.cost << " ==========" << std::endl;
+
+        WorstCasePaths::printForkDecisions(r.leaf, outFile);
+
+        TestCaseState *tcs = static_cast<TestCaseState*>(pb.getState(&testCase, r.pathId));
+        if (tcs && tcs->hasInputs()) {
+            tcs->printInputs(outFile);
+        } else {
+            outFile << "No test case in the trace file for the current path" << std::endl;
+        }
+
+        outFile << std::endl;
+    }
+
+    return 0;
+}
+
 int main(int argc, char **argv)
 {
     cl::ParseCommandLineOptions(argc, (char**) argv, " debugger");
@@ -159,7 +280,40 @@ int main(int argc, char **argv)
     CacheProfiler cprof(&pb);
     TestCase testCase(&pb);
 
-    pb.processTree();
+    pb.registerProcessor("ModuleCache", &mc, &ModuleCacheState::factory);
+    pb.registerProcessor("CacheProfiler", &cprof, &CacheProfilerState::factory);
+    pb.registerProcessor("TestCase", &testCase, &TestCaseState::factory);
+
+    if (AnaType == "worst") {
+        return findWorstPaths(parser, pb, mc, testCase);
+    } else if (AnaType != "cache") {
+        std::cerr << "Unknown analysis type " << AnaType << std::endl;
+        return -1;
+    }
+
+    if (!SnapshotFile.empty()) {
+        pb.enableSnapshots(SnapshotFile, SnapshotInterval);
+    }
+
+    if (MemBudget || MemReport) {
+        pb.setMemoryBudget((uint64_t)MemBudget << 20, LogDir + "/states.spill");
+    }
+
+    if (Resume) {
+        cprof.loadParameters(&parser);
+        if (!pb.resumeTree(SnapshotFile)) {
+            std::cerr << "Could not resume from " << SnapshotFile << std::endl;
+            return -1;
+        }
+    } else if (!pb.processTree()) {
+        return -1;
+    }
+
+    if (MemReport) {
+        std::string reportFile = LogDir + "/memreport.txt";
+        std::ofstream report(reportFile.c_str());
+        pb.printMemoryReport(report);
+    }
 
     PathSet paths;
     pb.getPaths(paths);
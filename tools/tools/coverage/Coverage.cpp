@@ -77,6 +77,24 @@ ModDir("moddir", cl::desc("Directory containing binary modules, the basic block
 cl::opt<bool>
     Compact("compact", cl::desc("Do not display non-covered blocks"), cl::init(false));
 
+cl::opt<bool>
+    MultiTrace("multitrace", cl::desc("The traces come from parallel S2E workers, stitch them into one tree"), cl::init(false));
+
+cl::opt<unsigned>
+    SampleSize("sample", cl::desc("Process a random sample of this many paths and report estimates (0 for all the paths)"), cl::init(0));
+
+cl::opt<bool>
+    Stratify("stratify", cl::desc("Stratify the path sample by depth"), cl::init(false));
+
+cl::opt<double>
+    TbRate("tbrate", cl::desc("Fraction of the translation blocks to process"), cl::init(1.0));
+
+cl::opt<unsigned>
+    Seed("seed", cl::desc("Seed of the path and block samples"), cl::init(1));
+
+cl::opt<double>
+    Confidence("confidence", cl::desc("Confidence level of the estimated intervals"), cl::init(0.95));
+
 
 //cl::opt<std::string>
 //    CovType("covtype", cl::desc("Coverage type"), cl::init("basicblock"));
@@ -86,12 +104,9 @@ cl::opt<bool>
 
 namespace s2etools
 {
-BasicBlockCoverage::BasicBlockCoverage(const std::string &moduleDir,
+BasicBlockCoverage::BasicBlockCoverage(const llvm::sys::Path &basicBlockListFile,
            const std::string &moduleName)
 {
-    llvm::sys::Path basicBlockListFile(moduleDir);
-    basicBlockListFile.appendComponent(moduleName + ".bblist");
-
     FILE *fp = fopen(basicBlockListFile.str().c_str(), "r");
     if (!fp) {
         std::cerr << "Could not open file " << basicBlockListFile.str() << std::endl;
@@ -130,16 +145,10 @@ BasicBlockCoverage::BasicBlockCoverage(const std::string &moduleDir,
     if (m_allBbs.size() == 0) {
         std::cerr << "No basic blocks found in the list for " << moduleName << ". Check the format of the file." << std::endl;
     }
-
-    parseExcludeFile(moduleDir, moduleName);
 }
 
-void BasicBlockCoverage::parseExcludeFile(const std::string &moduleDir,
-                                          const std::string &moduleName)
+void BasicBlockCoverage::parseExcludeFile(const llvm::sys::Path &excludeFileName)
 {
-    llvm::sys::Path excludeFileName(moduleDir);
-    excludeFileName.appendComponent(moduleName + ".excl");
-
     FILE *fp = fopen(excludeFileName.str().c_str(), "r");
     if (!fp) {
         std::cerr << "Could not open file " << excludeFileName.str() << std::endl;
@@ -392,6 +401,7 @@ Coverage::Coverage(Library *lib, ModuleCache *cache, LogEvents *events)
     m_library = lib;
     m_pathCount = 1;
     m_unknownModuleCount = 0;
+    m_trackPaths = false;
 }
 
 Coverage::~Coverage()
@@ -409,18 +419,23 @@ BasicBlockCoverage *Coverage::loadCoverage(const ModuleInstance *mi)
     BasicBlockCoverage *bbcov = NULL;
     assert(mi);
 
-    BbCoverageMap::iterator it = m_bbCov.find(mi->Name);
+    BbCoverageMap::iterator it = m_bbCov.find(mi->Id);
     if (it == m_bbCov.end()) {
-        //Look for the file containing the bbs.
-        std::string path;
-        if (m_library->findLibrary(mi->Name, path)) {
-            llvm::sys::Path modPath(path);
-            modPath.eraseComponent();
-            BasicBlockCoverage *bb = new BasicBlockCoverage(modPath.str(), mi->Name);
-            m_bbCov[mi->Name] = bb;
+        if (m_notFoundModuleImages.count(mi->Id)) {
+            return NULL;
+        }
+
+        //The lists may be in any of the module directories
+        llvm::sys::Path bbList, exclList;
+        if (m_library->findBasicBlockList(mi->getName(), bbList)) {
+            BasicBlockCoverage *bb = new BasicBlockCoverage(bbList, mi->getName());
+            if (m_library->findSuffixedModule(mi->getName(), "excl", exclList)) {
+                bb->parseExcludeFile(exclList);
+            }
+            m_bbCov[mi->Id] = bb;
             bbcov = bb;
         } else {
-            m_notFoundModuleImages.insert(mi->Name);
+            m_notFoundModuleImages.insert(mi->Id);
         }
     }else {
         bbcov = (*it).second;
@@ -460,6 +475,10 @@ void Coverage::onItem(unsigned traceIndex,
 
     uint64_t relPc = te->pc - mi->LoadBase + mi->ImageBase;
 
+    if (m_trackPaths) {
+        PathCoverageState *state = static_cast<PathCoverageState*>(m_events->getState(this, &PathCoverageState::factory));
+        state->m_tbs.insert(std::make_pair(mi->Id, relPc));
+    }
 
 
     bbcov->addTranslationBlock(hdr.timeStamp, relPc, relPc+te->size-1);
@@ -470,38 +489,89 @@ void Coverage::outputCoverage(const std::string &path) const
     BbCoverageMap::const_iterator it;
 
     for(it = m_bbCov.begin(); it != m_bbCov.end(); ++it) {
+        const std::string &moduleName = ModuleNames::getName((*it).first);
+
         std::stringstream ss;
-        ss << path << "/" << (*it).first << ".timecov";
+        ss << path << "/" << moduleName << ".timecov";
         std::ofstream timecov(ss.str().c_str());
 
         (*it).second->convertTbToBb();
         (*it).second->printTimeCoverage(timecov);
 
         std::stringstream ss1;
-        ss1 << path << "/" << (*it).first << ".repcov";
+        ss1 << path << "/" << moduleName << ".repcov";
         std::ofstream report(ss1.str().c_str());
         (*it).second->printReport(report, m_pathCount);
 
         if ((*it).second->hasIgnoredFunctions() > 0) {
             std::stringstream ss11;
-            ss11 << path << "/" << (*it).first << ".repcov-filtered";
+            ss11 << path << "/" << moduleName << ".repcov-filtered";
             std::ofstream report(ss11.str().c_str());
             (*it).second->printReport(report, m_pathCount, true);
 
             std::stringstream ss12;
-            ss12 << path << "/" << (*it).first << ".repcov-filtered.csv";
+            ss12 << path << "/" << moduleName << ".repcov-filtered.csv";
             std::ofstream reportcsv(ss12.str().c_str());
             (*it).second->printReport(reportcsv, m_pathCount, true, true);
         }
 
 
         std::stringstream ss2;
-        ss2 << path << "/" << (*it).first << ".bbcov";
+        ss2 << path << "/" << moduleName << ".bbcov";
         std::ofstream bbcov(ss2.str().c_str());
         (*it).second->printBBCov(bbcov);
     }
 }
 
+void Coverage::outputEstimates(const std::string &path, const PathSampler &sampler,
+                               double confidence, double tbRate) const
+{
+    std::stringstream ss;
+    ss << path << "/" << "coverage-estimate.txt";
+    std::ofstream estimates(ss.str().c_str());
+
+    typedef std::map<std::pair<ModuleId, uint64_t>, unsigned> Incidence;
+    Incidence incidence;
+    PathValues tbsPerPath;
+
+    const PathSet &paths = sampler.getSample();
+    PathSet::const_iterator pit;
+    for (pit = paths.begin(); pit != paths.end(); ++pit) {
+        const PathCoverageState *state = static_cast<const PathCoverageState*>(m_events->getState((void*)this, *pit));
+        if (!state) {
+            continue;
+        }
+
+        const PathCoverageState::Tbs &tbs = state->getTbs();
+        PathCoverageState::Tbs::const_iterator it;
+        for (it = tbs.begin(); it != tbs.end(); ++it) {
+            ++incidence[*it];
+        }
+        tbsPerPath[*pit] = tbs.size();
+    }
+
+    std::vector<unsigned> counts;
+    Incidence::const_iterator it;
+    for (it = incidence.begin(); it != incidence.end(); ++it) {
+        counts.push_back((*it).second);
+    }
+
+    double z = PathSampler::getZ(confidence);
+    SampleEstimate perPath = sampler.estimateTotal(tbsPerPath, z);
+    SampleEstimate distinct = sampler.estimateRichness(counts, z);
+
+    estimates << "#Estimates from " << std::dec << paths.size() << " of " << sampler.getPathCount()
+              << " paths, confidence " << confidence << std::endl;
+    if (tbRate < 1.0) {
+        estimates << "#Only " << tbRate << " of the blocks were processed, the estimates are lower bounds" << std::endl;
+    }
+    estimates << "#Quantity Observed Estimate Low High" << std::endl;
+    estimates << "DistinctTbs " << counts.size() << " " << distinct.total << " "
+              << distinct.low << " " << distinct.high << std::endl;
+    estimates << "DistinctTbsPerPath - " << perPath.mean << " "
+              << perPath.meanLow << " " << perPath.meanHigh << std::endl;
+}
+
 void Coverage::printErrors() const
 {
     if (m_unknownModuleCount) {
@@ -511,16 +581,31 @@ void Coverage::printErrors() const
     }
 
     if (m_notFoundModuleImages.size() > 0) {
-        std::cerr << "Could not find executable images of the following modules.\n"
+        std::cerr << "Could not find the basic block lists (.bblist) of the following modules.\n"
                 << "Please check your module path settings.\n";
 
-        std::set<std::string>::const_iterator it;
+        std::set<ModuleId>::const_iterator it;
         for (it = m_notFoundModuleImages.begin(); it != m_notFoundModuleImages.end(); ++it) {
-            std::cerr << *it << "\n";
+            std::cerr << ModuleNames::getName(*it) << "\n";
         }
     }
 }
 
+ItemProcessorState *PathCoverageState::factory()
+{
+    return new PathCoverageState();
+}
+
+ItemProcessorState *PathCoverageState::clone() const
+{
+    return new PathCoverageState(*this);
+}
+
+uint64_t PathCoverageState::getMemoryUsage() const
+{
+    return sizeof(*this) + getNodeMemory(m_tbs);
+}
+
 CoverageTool::CoverageTool()
 {
     m_binaries.setPaths(ModDir);
@@ -531,18 +616,42 @@ CoverageTool::~CoverageTool()
 
 }
 
-void CoverageTool::flatTrace()
+bool CoverageTool::flatTrace()
 {
-    PathBuilder pb(&m_parser);
+    PathBuilder pb(&m_parser, MultiTrace);
     m_parser.parse(TraceFiles);
+    if (MultiTrace && !pb.stitchTraces()) {
+        std::cerr << "Could not stitch the traces";
+        for (unsigned i = 0; i < TraceFiles.size(); ++i) {
+            std::cerr << " " << TraceFiles[i];
+        }
+        std::cerr << std::endl;
+        return false;
+    }
 
     ModuleCache mc(&pb);
-    Coverage cov(&m_binaries, &mc, &pb);
-
-    pb.processTree();
+    PathSampler sampler(&pb);
+    ItemSampler items(&pb, TbRate, Seed);
+    Coverage cov(&m_binaries, &mc, &items);
+
+    if (SampleSize) {
+        sampler.sample(SampleSize, Stratify, Seed);
+        cov.trackPaths();
+        if (!pb.processPaths(sampler.getSample())) {
+            std::cerr << "Could not process some of the sampled paths" << std::endl;
+            return false;
+        }
+    } else if (!pb.processTree()) {
+        return false;
+    }
     cov.printErrors();
 
     cov.outputCoverage(LogDir);
+
+    if (SampleSize) {
+        cov.outputEstimates(LogDir, sampler, Confidence, TbRate);
+    }
+    return true;
 }
 
 
@@ -555,7 +664,9 @@ int main(int argc, char **argv)
 
     s2etools::CoverageTool cov;
 
-    cov.flatTrace();
+    if (!cov.flatTrace()) {
+        return -1;
+    }
 
     return 0;
 }
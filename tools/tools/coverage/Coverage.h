@@ -38,6 +38,7 @@
 
 #include <lib/ExecutionTracer/LogParser.h>
 #include <lib/ExecutionTracer/ModuleParser.h>
+#include <lib/ExecutionTracer/PathSampler.h>
 
 #include <lib/BinaryReaders/Library.h>
 
@@ -126,11 +127,10 @@ private:
     FunctionNames m_ignoredFunctions;
     Blocks m_uniqueTbs;
 public:
-    BasicBlockCoverage(const std::string &moduleDir,
+    BasicBlockCoverage(const llvm::sys::Path &basicBlockListFile,
                    const std::string &moduleName);
 
-    void parseExcludeFile(const std::string &moduleDir,
-                          const std::string &moduleName);
+    void parseExcludeFile(const llvm::sys::Path &excludeFileName);
 
     //Start and end must be local to the module
     //Returns true if the added block resulted in covering new basic blocks
@@ -148,6 +148,30 @@ public:
 
 };
 
+/**
+ *  Distinct translation blocks executed by one path,
+ *  as (module, relative pc) pairs.
+ */
+class PathCoverageState: public ItemProcessorState
+{
+public:
+    typedef std::set<std::pair<ModuleId, uint64_t> > Tbs;
+
+private:
+    Tbs m_tbs;
+
+public:
+    static ItemProcessorState *factory();
+    virtual ItemProcessorState *clone() const;
+    virtual uint64_t getMemoryUsage() const;
+
+    const Tbs &getTbs() const {
+        return m_tbs;
+    }
+
+    friend class Coverage;
+};
+
 class Coverage
 {
 public:
@@ -160,18 +184,21 @@ private:
     sigc::connection m_connection;
     uint64_t m_pathCount;
 
-    typedef std::map<std::string, BasicBlockCoverage*> BbCoverageMap;
+    typedef std::map<ModuleId, BasicBlockCoverage*> BbCoverageMap;
     BbCoverageMap m_bbCov;
 
     /* Occurrence count of program counters not in any known module */
     uint64_t m_unknownModuleCount;
 
     /* Module names for which the tool could not find the executable image. */
-    std::set<std::string> m_notFoundModuleImages;
+    std::set<ModuleId> m_notFoundModuleImages;
 
     /* BB lists that were not found. */
     std::set<std::string> m_notFoundBbList;
 
+    /* Whether to keep the blocks of each path */
+    bool m_trackPaths;
+
     BasicBlockCoverage *loadCoverage(const ModuleInstance *mi);
 
     void onItem(unsigned traceIndex,
@@ -190,6 +217,14 @@ public:
 
     void printErrors() const;
 
+    //Needed by outputEstimates()
+    void trackPaths() {
+        m_trackPaths = true;
+    }
+
+    //Extrapolates the coverage of the sampled paths to all the paths
+    void outputEstimates(const std::string &path, const PathSampler &sampler,
+                         double confidence, double tbRate) const;
 };
 
 class CoverageTool
@@ -204,7 +239,7 @@ public:
     ~CoverageTool();
 
     void process();
-    void flatTrace();
+    bool flatTrace();
 };
 
 
@@ -72,6 +72,15 @@ namespace {
     cl::list<std::string>
         ModDir("moddir", cl::desc("Directory containing the binary modules"));
 
+    cl::opt<int>
+        SeekItem("seek", cl::desc("Print the loaded modules and the blocks from the given trace item (-1 to disable)"), cl::init(-1));
+
+    cl::opt<unsigned>
+        SeekCount("count", cl::desc("Number of trace items to print after -seek"), cl::init(100));
+
+    cl::opt<std::string>
+        SnapshotFile("snapshot", cl::desc("Snapshot from which -seek restores the module state"), cl::init(""));
+
 
 }
 
@@ -225,31 +234,42 @@ Debugger::~Debugger()
 
 void Debugger::process()
 {
-assert(false && "Needs rewriting");
-#if 0
-    ExecutionPaths paths;
     std::ofstream logfile;
     logfile.open(LogFile.c_str());
 
     PathBuilder pb(&m_parser);
     m_parser.parse(m_fileName);
 
-    pb.enumeratePaths(paths);
+    ModuleCache mc(&pb);
+    pb.registerProcessor("ModuleCache", &mc, &ModuleCacheState::factory);
 
-    PathBuilder::printPaths(paths, std::cout);
+    if (SeekItem >= 0) {
+        if (!pb.seekItem(SeekItem, SnapshotFile)) {
+            std::cerr << "Could not seek to item " << std::dec << SeekItem << std::endl;
+            return;
+        }
+
+        ModuleCacheState *mcs = static_cast<ModuleCacheState*>(pb.getState(&mc, &ModuleCacheState::factory));
+        logfile << "Modules loaded before item " << std::dec << SeekItem << std::endl;
+        mcs->print(logfile);
+
+        ExecutionDebugger ed(&m_binaries, &mc, &pb, logfile);
+        pb.stepItems(SeekCount);
+        return;
+    }
 
-    ExecutionPaths::iterator pit;
+    PathSet paths;
+    pb.getPaths(paths);
 
-    unsigned pathNum = 0;
+    PathSet::iterator pit;
     for(pit = paths.begin(); pit != paths.end(); ++pit) {
         if (PathId != -1) {
-            if (pathNum != (unsigned)PathId) {
+            if (*pit != (unsigned)PathId) {
                 continue;
             }
         }
 
-        std::cout << "Analyzing path " << pathNum << '\n';
-        ModuleCache mc(&pb);
+        std::cout << "Analyzing path " << std::dec << *pit << '\n';
 
         //MemoryDebugger md(&m_binaries, &mc, &pb, logfile);
         //md.lookForValue(MemoryValue);
@@ -257,9 +277,7 @@ assert(false && "Needs rewriting");
         ExecutionDebugger ed(&m_binaries, &mc, &pb, logfile);
 
         pb.processPath(*pit);
-        ++pathNum;
     }
-#endif
 }
 
 }
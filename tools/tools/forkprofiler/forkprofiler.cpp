@@ -51,6 +51,8 @@
 #include <sstream>
 #include <inttypes.h>
 #include <iomanip>
+#include <cmath>
+#include <algorithm>
 #include "forkprofiler.h"
 
 using namespace llvm;
@@ -70,6 +72,27 @@ cl::opt<std::string>
 cl::list<std::string>
     ModDir("moddir", cl::desc("Directory containing the binary modules"));
 
+cl::opt<bool>
+    MultiTrace("multitrace", cl::desc("The traces come from parallel S2E workers, stitch them into one tree"), cl::init(false));
+
+cl::opt<unsigned>
+    MemBudget("membudget", cl::desc("Memory budget of the processor states in MB, spilled to disk above it (0 for no limit)"), cl::init(0));
+
+cl::opt<bool>
+    MemReport("mem-report", cl::desc("Write the memory used by the states of each trace processor to memreport.txt"), cl::init(false));
+
+cl::opt<unsigned>
+    SampleSize("sample", cl::desc("Process a random sample of this many paths and report estimates (0 for all the paths)"), cl::init(0));
+
+cl::opt<bool>
+    Stratify("stratify", cl::desc("Stratify the path sample by depth"), cl::init(false));
+
+cl::opt<unsigned>
+    Seed("seed", cl::desc("Seed of the path sample"), cl::init(1));
+
+cl::opt<double>
+    Confidence("confidence", cl::desc("Confidence level of the estimated intervals"), cl::init(0.95));
+
 }
 
 namespace s2etools
@@ -82,6 +105,7 @@ ForkProfiler::ForkProfiler(Library *lib, ModuleCache *cache, LogEvents *events)
             );
     m_cache = cache;
     m_library = lib;
+    m_sampler = NULL;
 }
 
 ForkProfiler::~ForkProfiler()
@@ -90,6 +114,7 @@ ForkProfiler::~ForkProfiler()
 }
 
 void ForkProfiler::doProfile(
+        unsigned traceIndex,
         const s2e::plugins::ExecutionTraceItemHeader &hdr,
         const s2e::plugins::ExecutionTraceFork *te)
 {
@@ -103,29 +128,43 @@ void ForkProfiler::doProfile(
     fp.count = 1;
     fp.line = 0;
 
-    m_library->getInfo(mi, te->pc, fp.file, fp.line, fp.function);
+    //Each observed fork stands for 1/pi forks, pi being the probability
+    //that the sample goes through it. The variance ignores the
+    //correlations between the inclusions of different forks.
+    fp.estimate = fp.variance = 0;
+    if (m_sampler) {
+        double pi = m_sampler->getItemInclusion(traceIndex);
+        if (pi > 0) {
+            fp.estimate = 1 / pi;
+            fp.variance = (1 - pi) / (pi * pi);
+        }
+    }
 
     ForkPoints::iterator it = m_forkPoints.find(fp);
     if (it == m_forkPoints.end()) {
         if (mi) {
-            fp.module = mi->Name;
+            fp.module = mi->Id;
             fp.loadbase = mi->LoadBase;
             fp.imagebase = mi->ImageBase;
         } else {
-            fp.module = "";
+            fp.module = ModuleNames::NoModule;
             fp.loadbase = 0;
             fp.imagebase = 0;
         }
         m_forkPoints.insert(fp);
     }else {
+        double estimate = fp.estimate, variance = fp.variance;
         fp = *it;
         m_forkPoints.erase(*it);
         fp.count++;
+        fp.estimate += estimate;
+        fp.variance += variance;
         m_forkPoints.insert(fp);
     }
 }
 
 void ForkProfiler::doGraph(
+        unsigned traceIndex,
         const s2e::plugins::ExecutionTraceItemHeader &hdr,
         const s2e::plugins::ExecutionTraceFork *te)
 {
@@ -134,18 +173,19 @@ void ForkProfiler::doGraph(
     const ModuleInstance *mi = mcs->getInstance(hdr.pid, te->pc);
 
     Fork f;
-    f.id = hdr.stateId;
+    f.id = m_events->getGlobalStateId(traceIndex, hdr.stateId);
     f.pid = hdr.pid;
     f.pc = te->pc;
     if (mi) {
-        f.module = mi->Name;
+        f.module = mi->Id;
         f.relPc = te->pc - mi->LoadBase + mi->ImageBase;
     }else {
+        f.module = ModuleNames::NoModule;
         f.relPc = te->pc;
     }
 
     for (unsigned i=0; i<te->stateCount; ++i) {
-        f.children.push_back(te->children[i]);
+        f.children.push_back(m_events->getGlobalStateId(traceIndex, te->children[i]));
     }
 
     m_forks.push_back(f);
@@ -162,9 +202,66 @@ void ForkProfiler::onItem(unsigned traceIndex,
     const s2e::plugins::ExecutionTraceFork *te =
             (const s2e::plugins::ExecutionTraceFork*) item;
 
-    doProfile(hdr, te);
-    doGraph(hdr, te);
+    doProfile(traceIndex, hdr, te);
+    doGraph(traceIndex, hdr, te);
+
+}
+
+//Fork points only get their debug info once all the traces are read
+void ForkProfiler::symbolize()
+{
+    Library::SymbolQueries queries;
+    ForkPoints::const_iterator it;
+    for (it = m_forkPoints.begin(); it != m_forkPoints.end(); ++it) {
+        const ForkPoint &fp = *it;
+        queries.push_back(Library::SymbolQuery(fp.module, fp.pc - fp.loadbase + fp.imagebase));
+    }
 
+    m_library->getInfoBatch(queries);
+
+    ForkPoints symbolized;
+    unsigned i = 0;
+    for (it = m_forkPoints.begin(); it != m_forkPoints.end(); ++it, ++i) {
+        ForkPoint fp = *it;
+        const Library::SymbolQuery &q = queries[i];
+        if (q.Found) {
+            fp.file = q.File;
+            fp.line = q.Line;
+            fp.function = q.Function;
+        }
+        symbolized.insert(symbolized.end(), fp);
+    }
+    m_forkPoints.swap(symbolized);
+}
+
+void ForkProfiler::outputEstimates(const std::string &path, double confidence) const
+{
+    std::stringstream ss;
+    ss << path << "/" << "forkprofile-estimate.txt";
+    std::ofstream estimates(ss.str().c_str());
+
+    double z = PathSampler::getZ(confidence);
+
+    estimates << "#Fork counts extrapolated from " << std::dec << m_sampler->getSample().size()
+              << " of " << m_sampler->getPathCount() << " paths, confidence " << confidence << std::endl;
+    estimates << "#Pc      \tModule\tObserved\tEstimate\tLow\tHigh\tFunction" << std::endl;
+
+    ForkPoints::const_iterator it;
+    for (it = m_forkPoints.begin(); it != m_forkPoints.end(); ++it) {
+        const ForkPoint &fp = *it;
+        double delta = z * sqrt(fp.variance);
+
+        estimates << std::hex << "0x" << std::setw(8) << std::setfill('0') << (fp.pc - fp.loadbase + fp.imagebase) << "\t";
+        estimates << std::setfill(' ');
+        if (fp.module != ModuleNames::NoModule) {
+            estimates << ModuleNames::getName(fp.module) << "\t";
+        } else {
+            estimates << "?\t";
+        }
+        estimates << std::dec << fp.count << "\t" << fp.estimate << "\t"
+                  << std::max(fp.estimate - delta, (double)fp.count) << "\t" << fp.estimate + delta << "\t";
+        estimates << (fp.function.size() > 0 ? fp.function : "?") << std::endl;
+    }
 }
 
 static std::string getColor(unsigned val, unsigned maxval)
@@ -248,8 +345,8 @@ void ForkProfiler::outputProfile(const std::string &path) const
         const ForkPoint &fp = *cit;
         forkProfile << std::hex << "0x" << std::setw(8) << std::setfill('0') << (fp.pc - fp.loadbase + fp.imagebase) << "\t";
         forkProfile << std::setfill(' ');
-        if (fp.module.size() > 0) {
-            forkProfile << fp.module << "\t";
+        if (fp.module != ModuleNames::NoModule) {
+            forkProfile << ModuleNames::getName(fp.module) << "\t";
         }else {
             forkProfile << "?\t";
         }
@@ -272,6 +369,112 @@ void ForkProfiler::outputProfile(const std::string &path) const
     }
 }
 
+void ForkProfiler::outputFunctionProfile(const std::string &path) const
+{
+    std::stringstream ss;
+    ss << path << "/" << "forkprofile-functions.txt";
+    std::ofstream functionProfile(ss.str().c_str());
+
+    typedef std::pair<ModuleId, const FunctionEntry*> FunctionKey;
+    typedef std::map<FunctionKey, uint64_t> FunctionCounts;
+    FunctionCounts counts;
+    uint64_t unknown = 0;
+
+    ForkPoints::const_iterator it;
+    for (it = m_forkPoints.begin(); it != m_forkPoints.end(); ++it) {
+        const ForkPoint &fp = *it;
+        const FunctionEntry *f = NULL;
+        if (fp.module != ModuleNames::NoModule) {
+            const FunctionEntries *functions = m_library->getFunctionRanges(fp.module);
+            if (functions) {
+                f = ExecutableFile::findFunction(*functions, fp.pc - fp.loadbase + fp.imagebase);
+            }
+        }
+
+        if (f) {
+            counts[FunctionKey(fp.module, f)] += fp.count;
+        } else {
+            unknown += fp.count;
+        }
+    }
+
+    functionProfile << "#Start   \tEnd      \tModule\tForkCnt\tFunction" << std::endl;
+
+    FunctionCounts::const_iterator cit;
+    for (cit = counts.begin(); cit != counts.end(); ++cit) {
+        const FunctionEntry *f = (*cit).first.second;
+        functionProfile << std::hex << "0x" << std::setw(8) << std::setfill('0') << f->start << "\t"
+                        << "0x" << std::setw(8) << f->end << "\t";
+        functionProfile << std::setfill(' ') << std::dec;
+        functionProfile << ModuleNames::getName((*cit).first.first) << "\t"
+                        << (*cit).second << "\t" << f->name << std::endl;
+    }
+
+    if (unknown) {
+        functionProfile << "?\t?\t?\t" << unknown << "\t?" << std::endl;
+    }
+}
+
+void ForkProfiler::outputYield(const std::string &path, const ForkYield &yield) const
+{
+    std::stringstream ss;
+    ss << path << "/" << "forkyield.txt";
+    std::ofstream forkYield(ss.str().c_str());
+
+    ForkYield::Ranking ranking;
+    yield.getRanking(ranking);
+
+    forkYield << "#Sites ranked by cost per useful outcome (test cases and new blocks)" << std::endl;
+    forkYield << "#Pc      \tModule\tForks\tInstructions\tTBs\tTime\tLeaves\tTestCases\tNewBlocks\tCostPerOutcome\tSource\tFunction\tLine" << std::endl;
+
+    ForkYield::Ranking::const_iterator it;
+    for (it = ranking.begin(); it != ranking.end(); ++it) {
+        const ForkSiteYield &y = **it;
+
+        ForkPoint fp;
+        fp.pc = y.pc;
+        fp.pid = y.pid;
+        ForkPoints::const_iterator fpit = m_forkPoints.find(fp);
+
+        uint64_t relPc = y.pc;
+        if (fpit != m_forkPoints.end()) {
+            relPc = y.pc - (*fpit).loadbase + (*fpit).imagebase;
+        }
+
+        forkYield << std::hex << "0x" << std::setw(8) << std::setfill('0') << relPc << "\t";
+        forkYield << std::setfill(' ') << std::dec;
+
+        if (fpit != m_forkPoints.end() && (*fpit).module != ModuleNames::NoModule) {
+            forkYield << ModuleNames::getName((*fpit).module) << "\t";
+        } else {
+            forkYield << "?\t";
+        }
+
+        forkYield << y.forks << "\t" << y.instructions << "\t" << y.blocks << "\t"
+                  << y.time << "\t" << y.leaves << "\t" << y.testCases << "\t"
+                  << y.newBlocks << "\t";
+
+        if (y.getUsefulOutcomes() > 0) {
+            forkYield << y.getCost() / y.getUsefulOutcomes() << "\t";
+        } else {
+            forkYield << "inf\t";
+        }
+
+        if (fpit != m_forkPoints.end() && (*fpit).file.size() > 0) {
+            forkYield << (*fpit).file << "\t";
+        } else {
+            forkYield << "?\t";
+        }
+
+        if (fpit != m_forkPoints.end() && (*fpit).function.size() > 0) {
+            forkYield << (*fpit).function << "\t";
+        } else {
+            forkYield << "?\t";
+        }
+
+        forkYield << (fpit != m_forkPoints.end() ? (*fpit).line : 0) << std::endl;
+    }
+}
 
 }
 
@@ -280,20 +483,67 @@ int main(int argc, char **argv)
 {
     cl::ParseCommandLineOptions(argc, (char**) argv, " debugger");
 
+    //processPaths() does not account the states of the sampled paths
+    if (SampleSize && (MemBudget || MemReport)) {
+        std::cerr << "-membudget and -mem-report cannot be combined with -sample" << std::endl;
+        return -1;
+    }
+
     Library library;
     library.setPaths(ModDir);
 
     LogParser parser;
-    PathBuilder pb(&parser);
+    PathBuilder pb(&parser, MultiTrace);
     parser.parse(TraceFiles);
+    if (MultiTrace && !pb.stitchTraces()) {
+        std::cerr << "Could not stitch the traces";
+        for (unsigned i = 0; i < TraceFiles.size(); ++i) {
+            std::cerr << " " << TraceFiles[i];
+        }
+        std::cerr << std::endl;
+        return -1;
+    }
 
     ModuleCache mc(&pb);
     ForkProfiler fp(&library, &mc, &pb);
 
-    pb.processTree();
+    pb.registerProcessor("ModuleCache", &mc, &ModuleCacheState::factory);
+    if (MemBudget || MemReport) {
+        pb.setMemoryBudget((uint64_t)MemBudget << 20, LogDir + "/states.spill");
+    }
+
+    PathSampler sampler(&pb);
+    if (SampleSize) {
+        sampler.sample(SampleSize, Stratify, Seed);
+        fp.setSampler(&sampler);
+        if (!pb.processPaths(sampler.getSample())) {
+            std::cerr << "Could not process some of the sampled paths" << std::endl;
+            return -1;
+        }
+    } else if (!pb.processTree()) {
+        return -1;
+    }
 
+    if (MemReport) {
+        std::string reportFile = LogDir + "/memreport.txt";
+        std::ofstream report(reportFile.c_str());
+        pb.printMemoryReport(report);
+    }
+
+    fp.symbolize();
     fp.outputProfile(LogDir);
+    fp.outputFunctionProfile(LogDir);
     fp.outputGraph(LogDir);
+    library.getSymbolCache().printStats(std::cout);
+
+    //The yield reads the whole tree, skip it when sampling
+    if (SampleSize) {
+        fp.outputEstimates(LogDir, Confidence);
+    } else {
+        ForkYield yield(&parser, &pb);
+        yield.compute();
+        fp.outputYield(LogDir, yield);
+    }
 
     return 0;
 }
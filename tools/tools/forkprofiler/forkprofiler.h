@@ -38,6 +38,8 @@
 
 #include <lib/ExecutionTracer/LogParser.h>
 #include <lib/ExecutionTracer/ModuleParser.h>
+#include <lib/ExecutionTracer/ForkYield.h>
+#include <lib/ExecutionTracer/PathSampler.h>
 
 #include <lib/BinaryReaders/Library.h>
 
@@ -54,7 +56,7 @@ public:
         uint32_t id;
         uint64_t pid;
         uint64_t relPc, pc;
-        std::string module;
+        ModuleId module;
         std::vector<uint32_t> children;
     };
 
@@ -62,9 +64,13 @@ public:
         uint64_t pc, pid;
         uint64_t count;
         uint64_t line;
-        std::string file, function, module;
+        std::string file, function;
+        ModuleId module;
         uint64_t loadbase, imagebase;
 
+        //Horvitz-Thompson estimate of the count when paths are sampled
+        double estimate, variance;
+
         bool operator()(const ForkPoint &fp1, const ForkPoint &fp2) const {
             if (fp1.pid == fp2.pid) {
                 return fp1.pc < fp2.pc;
@@ -95,6 +101,7 @@ private:
     LogEvents *m_events;
     ModuleCache *m_cache;
     Library *m_library;
+    const PathSampler *m_sampler;
 
     sigc::connection m_connection;
     ForkList m_forks;
@@ -105,9 +112,11 @@ private:
                 void *item);
 
     void doProfile(
+            unsigned traceIndex,
             const s2e::plugins::ExecutionTraceItemHeader &hdr,
             const s2e::plugins::ExecutionTraceFork *te);
     void doGraph(
+            unsigned traceIndex,
             const s2e::plugins::ExecutionTraceItemHeader &hdr,
             const s2e::plugins::ExecutionTraceFork *te);
 
@@ -116,9 +125,20 @@ public:
     virtual ~ForkProfiler();
 
     void process();
+    void symbolize();
+
+    //Fork counts are then extrapolated from the sampled paths
+    void setSampler(const PathSampler *sampler) {
+        m_sampler = sampler;
+    }
 
     void outputProfile(const std::string &path) const;
+
+    //Fork counts summed over the function ranges of the modules
+    void outputFunctionProfile(const std::string &path) const;
     void outputGraph(const std::string &path) const;
+    void outputYield(const std::string &path, const ForkYield &yield) const;
+    void outputEstimates(const std::string &path, double confidence) const;
 };
 
 }
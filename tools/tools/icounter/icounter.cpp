@@ -41,6 +41,7 @@
 #include <lib/ExecutionTracer/Path.h>
 #include <lib/ExecutionTracer/TestCase.h>
 #include <lib/ExecutionTracer/InstructionCounter.h>
+#include <lib/ExecutionTracer/PathSampler.h>
 #include <lib/BinaryReaders/BFDInterface.h>
 #include <lib/BinaryReaders/Library.h>
 
@@ -71,6 +72,21 @@ cl::opt<std::string>
 cl::list<std::string>
     ModPath("modpath", cl::desc("Path to modules"));
 
+cl::opt<bool>
+    MultiTrace("multitrace", cl::desc("The traces come from parallel S2E workers, stitch them into one tree"), cl::init(false));
+
+cl::opt<unsigned>
+    SampleSize("sample", cl::desc("Process a random sample of this many paths and report estimates (0 for all the paths)"), cl::init(0));
+
+cl::opt<bool>
+    Stratify("stratify", cl::desc("Stratify the path sample by depth"), cl::init(false));
+
+cl::opt<unsigned>
+    Seed("seed", cl::desc("Seed of the path sample"), cl::init(1));
+
+cl::opt<double>
+    Confidence("confidence", cl::desc("Confidence level of the estimated intervals"), cl::init(0.95));
+
 }
 
 
@@ -120,20 +136,40 @@ int main(int argc, char **argv)
     library.setPaths(ModPath);
 
     LogParser parser;
-    PathBuilder pb(&parser);
+    PathBuilder pb(&parser, MultiTrace);
     parser.parse(TraceFiles);
+    if (MultiTrace && !pb.stitchTraces()) {
+        std::cerr << "Could not stitch the traces";
+        for (unsigned i = 0; i < TraceFiles.size(); ++i) {
+            std::cerr << " " << TraceFiles[i];
+        }
+        std::cerr << std::endl;
+        return -1;
+    }
 
     ModuleCache mc(&pb);
 
     InstructionCounter icounter(&pb);
     TestCase testCase(&pb);
 
-    pb.processTree();
-
     PathSet paths;
     PathSet::const_iterator pit;
-
-    pb.getPaths(paths);
+    PathSampler sampler(&pb);
+    PathValues icounts;
+
+    //Only the sampled paths are processed, their leaves keep the states
+    if (SampleSize) {
+        sampler.sample(SampleSize, Stratify, Seed);
+        paths = sampler.getSample();
+        if (!pb.processPaths(paths)) {
+            std::cerr << "Could not process some of the sampled paths" << std::endl;
+            return -1;
+        }
+    } else if (!pb.processTree()) {
+        return -1;
+    } else {
+        pb.getPaths(paths);
+    }
 
     std::string outFileStr = LogDir + "/icount.log";
     std::ofstream outFile(outFileStr.c_str());
@@ -149,6 +185,7 @@ int main(int argc, char **argv)
         if (ics) {
             uint64_t icount = ics->getCount();
             outFile << std::dec << icount << " ";
+            icounts[*pit] = icount;
         } else {
             outFile << "No instruction count ";
         }
@@ -166,6 +203,19 @@ int main(int argc, char **argv)
         outFile << std::endl;
     }
 
+    if (SampleSize) {
+        std::string estFileStr = LogDir + "/icount-estimate.txt";
+        std::ofstream estFile(estFileStr.c_str());
+
+        SampleEstimate e = sampler.estimateTotal(icounts, PathSampler::getZ(Confidence));
+
+        estFile << "#Estimates from " << std::dec << paths.size() << " of " << sampler.getPathCount()
+                << " paths" << (Stratify ? " (stratified by depth)" : "")
+                << ", confidence " << Confidence << std::endl;
+        estFile << "#Quantity Estimate Low High" << std::endl;
+        estFile << "TotalICount " << e.total << " " << e.low << " " << e.high << std::endl;
+        estFile << "ICountPerPath " << e.mean << " " << e.meanLow << " " << e.meanHigh << std::endl;
+    }
 
     return 0;
 }
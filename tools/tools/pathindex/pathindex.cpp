@@ -0,0 +1,194 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#define __STDC_FORMAT_MACROS 1
+
+#include "llvm/Support/CommandLine.h"
+
+#include <lib/ExecutionTracer/ModuleParser.h>
+#include <lib/ExecutionTracer/Path.h>
+#include <lib/ExecutionTracer/PathIndex.h>
+#include <lib/BinaryReaders/Library.h>
+
+#include <s2e/Plugins/ExecutionTracers/TraceEntries.h>
+
+#include <stdlib.h>
+#include <iostream>
+#include <inttypes.h>
+
+using namespace llvm;
+using namespace s2etools;
+
+
+namespace {
+
+cl::list<std::string>
+    TraceFiles("trace", llvm::cl::value_desc("Input trace"), llvm::cl::Prefix,
+               llvm::cl::desc("Specify an execution trace file"));
+
+cl::opt<std::string>
+    IndexFile("index", cl::desc("Path index file (default: first trace file with .pathidx extension)"));
+
+cl::list<std::string>
+    ModDir("moddir", cl::desc("Directory containing the binary modules"));
+
+cl::opt<bool>
+    Build("build", cl::desc("Build the index from the traces and save it"), cl::init(false));
+
+cl::opt<bool>
+    MultiTrace("multitrace", cl::desc("The traces come from parallel S2E workers, stitch them into one tree"), cl::init(false));
+
+cl::list<std::string>
+    With("with", cl::desc("Only keep paths that went through the location (module!0xpc, module!function, 0xpc or function)"));
+
+cl::list<std::string>
+    Without("without", cl::desc("Only keep paths that did not go through the location"));
+
+}
+
+static bool lookupLocation(const PathIndex &index, const std::string &location, PathBitmap &paths)
+{
+    std::string module, loc = location;
+    size_t sep = location.find('!');
+    if (sep != std::string::npos) {
+        module = location.substr(0, sep);
+        loc = location.substr(sep + 1);
+    }
+
+    if (loc.size() > 2 && loc[0] == '0' && (loc[1] == 'x' || loc[1] == 'X')) {
+        uint64_t pc = strtoull(loc.c_str(), NULL, 16);
+        return index.getPcPaths(module, pc, paths);
+    }
+
+    return index.getFunctionPaths(module, loc, paths);
+}
+
+static int buildIndex(const std::string &indexFile)
+{
+    Library library;
+    library.setPaths(ModDir);
+
+    LogParser parser;
+    PathBuilder pb(&parser, MultiTrace);
+    parser.parse(TraceFiles);
+    if (MultiTrace && !pb.stitchTraces()) {
+        std::cerr << "Could not stitch the traces";
+        for (unsigned i = 0; i < TraceFiles.size(); ++i) {
+            std::cerr << " " << TraceFiles[i];
+        }
+        std::cerr << std::endl;
+        return -1;
+    }
+
+    ModuleCache mc(&pb);
+    PathIndex index(&pb, &mc);
+
+    pb.processTree();
+
+    index.build(&pb, ModDir.empty() ? NULL : &library);
+
+    if (!index.save(indexFile)) {
+        return -1;
+    }
+
+    std::cout << "Indexed " << index.getAllPaths().cardinality() << " paths, "
+              << index.getPcPaths().size() << " blocks, "
+              << index.getFunctionPaths().size() << " functions" << std::endl;
+    return 0;
+}
+
+static int queryIndex(const std::string &indexFile)
+{
+    PathIndex index;
+    if (!index.load(indexFile)) {
+        return -1;
+    }
+
+    PathBitmap result;
+    PathBitmap paths;
+    unsigned i = 0;
+
+    if (With.empty()) {
+        result = index.getAllPaths();
+    } else {
+        if (!lookupLocation(index, With[0], result)) {
+            std::cerr << "No path went through " << With[0] << std::endl;
+        }
+        i = 1;
+    }
+
+    for (; i < With.size(); ++i) {
+        if (!lookupLocation(index, With[i], paths)) {
+            std::cerr << "No path went through " << With[i] << std::endl;
+        }
+        result.intersect(paths);
+    }
+
+    for (i = 0; i < Without.size(); ++i) {
+        if (lookupLocation(index, Without[i], paths)) {
+            result.subtract(paths);
+        }
+    }
+
+    std::vector<uint32_t> ids;
+    result.getIds(ids);
+
+    std::cout << ids.size() << " paths" << std::endl;
+    for (i = 0; i < ids.size(); ++i) {
+        std::cout << ids[i] << std::endl;
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    cl::ParseCommandLineOptions(argc, (char**) argv, " pathindex");
+
+    std::string indexFile = IndexFile;
+    if (indexFile.empty()) {
+        if (TraceFiles.empty()) {
+            std::cerr << "Specify -index or -trace" << std::endl;
+            return -1;
+        }
+        indexFile = TraceFiles[0] + ".pathidx";
+    }
+
+    if (Build) {
+        return buildIndex(indexFile);
+    }
+
+    return queryIndex(indexFile);
+}
@@ -241,6 +241,7 @@ TopMissesPerModule::TopMissesPerModule(Library *library, CacheProfiler *prof)
     m_displayAllModules = true;
     m_library = library;
     m_totalMisses = 0;
+    m_filteredProcessId = m_filteredModuleId = ModuleNames::NoModule;
 }
 
 TopMissesPerModule::~TopMissesPerModule()
@@ -263,7 +264,7 @@ void TopMissesPerModule::computeStats(uint32_t pathId)
     if (m_filteredProcess.size() > 0) {
         //look for the right process id
         for(it = stats.begin(); it != stats.end(); ++it) {
-            if ((*it).first.first.m && (*it).first.first.m->Name == m_filteredProcess) {
+            if ((*it).first.first.m && (*it).first.first.m->Id == m_filteredProcessId) {
                 filteredPid = (*it).first.first.pid;
                 break;
             }
@@ -278,7 +279,7 @@ void TopMissesPerModule::computeStats(uint32_t pathId)
         //std::cout << ex.stats.c->getName();
 
         if (m_filteredModule.size() > 0) {
-            if ((*it).first.first.m && (*it).first.first.m->Name != m_filteredModule) {
+            if ((*it).first.first.m && (*it).first.first.m->Id != m_filteredModuleId) {
                 continue;
             }
         }
@@ -345,7 +346,7 @@ void TopMissesPerModule::print(std::ostream &os)
             continue;
         }
 
-        std::string modName = s.instr.m ? s.instr.m->Name : "<unknown>";
+        std::string modName = s.instr.m ? s.instr.m->getName() : "<unknown>";
         os << std::setw(15) << modName << std::hex
                 << " 0x" << std::setw(8) << s.instr.pc << " - ";
         //os << std::hex << std::right << std::setfill('0') << "0x" << std::setw(8) << s.instr.pid
@@ -230,6 +230,7 @@ private:
 
     std::string m_filteredProcess;
     std::string m_filteredModule;
+    ModuleId m_filteredProcessId, m_filteredModuleId;
     uint64_t m_minCacheMissThreshold;
 
     //Display debug info for all modules in the trace
@@ -244,11 +245,13 @@ public:
 
     void setFilteredProcess(const std::string &proc) {
         m_filteredProcess = proc;
+        m_filteredProcessId = ModuleNames::intern(proc);
     }
 
 
     void setFilteredModule(const std::string &proc) {
         m_filteredModule = proc;
+        m_filteredModuleId = ModuleNames::intern(proc);
     }
 
     void setMinMissThreshold(uint64_t v) {
@@ -0,0 +1,145 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#include "llvm/Support/CommandLine.h"
+
+#include <lib/BinaryReaders/BFDInterface.h>
+#include <lib/BinaryReaders/DwarfReader.h>
+#include <lib/BinaryReaders/SymbolDatabase.h>
+
+#include <iostream>
+#include <fstream>
+
+using namespace llvm;
+using namespace s2etools;
+
+
+namespace {
+
+cl::list<std::string>
+    Binaries(cl::Positional, cl::OneOrMore, cl::desc("<binaries>"));
+
+cl::opt<std::string>
+    OutputDir("outputdir", cl::desc("Store the databases into the given folder instead of next to the binaries. The tools find them if the folder is passed with -moddir."), cl::init(""));
+
+cl::opt<bool>
+    WriteFcn("fcn", cl::desc("Also write the function ranges of each binary to a .fcn file"), cl::init(false));
+
+}
+
+static std::string getOutputPath(const std::string &binary, const std::string &suffix)
+{
+    if (OutputDir.empty()) {
+        return binary + suffix;
+    }
+
+    size_t pos = binary.find_last_of("\\/");
+    std::string name = pos == std::string::npos ? binary : binary.substr(pos + 1);
+    return OutputDir + "/" + name + suffix;
+}
+
+//Same format as the IDA exports read by TextModule,
+//where the end address of a function is its last byte
+static bool writeFunctions(BFDInterface &bfd, const std::string &binary)
+{
+    std::string path = getOutputPath(binary, ".fcn");
+    std::ofstream os(path.c_str());
+    if (!os) {
+        std::cerr << "Could not create " << path << std::endl;
+        return false;
+    }
+
+    std::string name;
+    bfd.getModuleName(name);
+    os << "#ImageBase 0x" << std::hex << bfd.getImageBase() << std::endl;
+    os << "#ImageName " << name << std::endl;
+    os << "#ImageSize 0x" << std::hex << bfd.getImageSize() << std::endl;
+
+    const FunctionEntries &functions = bfd.functionRanges();
+    FunctionEntries::const_iterator it;
+    for (it = functions.begin(); it != functions.end(); ++it) {
+        os << "0x" << std::hex << (*it).start << " 0x" << (*it).end - 1 << " " << (*it).name << std::endl;
+    }
+
+    std::cout << path << ": " << std::dec << functions.size() << " functions" << std::endl;
+    return os.good();
+}
+
+static bool buildDatabase(const std::string &binary)
+{
+    //Image base and size must be those that BFD would report
+    BFDInterface bfd(binary, false);
+    if (!bfd.initialize()) {
+        return false;
+    }
+
+    //Symbols alone are enough for the function ranges
+    if (WriteFcn && !writeFunctions(bfd, binary)) {
+        return false;
+    }
+
+    DwarfReader reader(bfd.getFile());
+    if (!DwarfReader::isValid(bfd.getFile()) || !reader.initialize()) {
+        std::cerr << binary << ": no DWARF 2-4 debug info in an ELF image, "
+                  << "lookups will keep going through BFD" << std::endl;
+        return false;
+    }
+
+    std::string path = getOutputPath(binary, SymbolDatabase::Suffix);
+
+    if (!SymbolDatabase::write(path, reader.getTables(), bfd.getImageBase(), bfd.getImageSize(), binary)) {
+        return false;
+    }
+
+    const SymbolTables &t = reader.getTables();
+    std::cout << path << ": " << t.sectionCount << " sections, "
+              << t.functionCount << " functions, " << t.lineCount << " lines, "
+              << t.symbolCount << " symbols" << std::endl;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    cl::ParseCommandLineOptions(argc, (char**) argv, " s2esym-build");
+
+    int ret = 0;
+    for (unsigned i = 0; i < Binaries.size(); ++i) {
+        if (!buildDatabase(Binaries[i])) {
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
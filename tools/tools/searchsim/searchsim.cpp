@@ -0,0 +1,162 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#define __STDC_FORMAT_MACROS 1
+
+#include "llvm/Support/CommandLine.h"
+
+#include <lib/ExecutionTracer/Path.h>
+#include <lib/ExecutionTracer/SearcherSimulator.h>
+
+#include <s2e/Plugins/ExecutionTracers/TraceEntries.h>
+
+#include <fstream>
+#include <iostream>
+
+using namespace llvm;
+using namespace s2etools;
+
+
+namespace {
+
+cl::list<std::string>
+    TraceFiles("trace", llvm::cl::value_desc("Input trace"), llvm::cl::Prefix,
+               llvm::cl::desc("Specify an execution trace file"));
+
+cl::opt<std::string>
+    LogDir("outputdir", cl::desc("Store the coverage curves into the given folder"), cl::init("."));
+
+cl::list<std::string>
+    Policies("policy", cl::desc("Searcher to simulate (dfs/bfs/random-path/coverage), all if none is given"));
+
+cl::opt<std::string>
+    Cost("cost", cl::desc("Cost of a segment (time/tb)"), cl::init("time"));
+
+cl::opt<unsigned>
+    Seed("seed", cl::desc("Seed of the random-path searcher"), cl::init(1));
+
+cl::opt<bool>
+    MultiTrace("multitrace", cl::desc("The traces come from parallel S2E workers, stitch them into one tree"), cl::init(false));
+
+}
+
+static SearchPolicy *createPolicy(const std::string &name)
+{
+    if (name == "dfs") {
+        return new DfsPolicy();
+    } else if (name == "bfs") {
+        return new BfsPolicy();
+    } else if (name == "random-path") {
+        return new RandomPathPolicy(Seed);
+    } else if (name == "coverage") {
+        return new CoverageOptimizedPolicy();
+    }
+    return NULL;
+}
+
+//Simulated time at which the given fraction of the blocks was covered
+static uint64_t getTimeToCoverage(const SearcherSimulator::CoverageCurve &curve,
+                                  uint64_t blocks, unsigned percent)
+{
+    for (unsigned i = 0; i < curve.size(); ++i) {
+        if (curve[i].second * 100 >= blocks * percent) {
+            return curve[i].first;
+        }
+    }
+    return curve.back().first;
+}
+
+int main(int argc, char **argv)
+{
+    cl::ParseCommandLineOptions(argc, (char**) argv, " searchsim");
+
+    if (Cost != "time" && Cost != "tb") {
+        std::cerr << "Unknown cost " << Cost << std::endl;
+        return -1;
+    }
+
+    std::vector<std::string> names(Policies.begin(), Policies.end());
+    if (names.empty()) {
+        names.push_back("dfs");
+        names.push_back("bfs");
+        names.push_back("random-path");
+        names.push_back("coverage");
+    }
+
+    LogParser parser;
+    PathBuilder pb(&parser, MultiTrace);
+    parser.parse(TraceFiles);
+    if (MultiTrace && !pb.stitchTraces()) {
+        std::cerr << "Could not stitch the traces";
+        for (unsigned i = 0; i < TraceFiles.size(); ++i) {
+            std::cerr << " " << TraceFiles[i];
+        }
+        std::cerr << std::endl;
+        return -1;
+    }
+
+    SearcherSimulator sim(&parser, &pb);
+    sim.build(Cost == "time");
+
+    std::string outFileStr = LogDir + "/searchsim.csv";
+    std::ofstream outFile(outFileStr.c_str());
+    outFile << "policy," << Cost << ",blocks" << std::endl;
+
+    std::cout << "#Policy  Cost  TimeTo50%  TimeTo90%  TimeTo100%  (" << sim.getBlockCount() << " blocks)" << std::endl;
+
+    for (unsigned i = 0; i < names.size(); ++i) {
+        SearchPolicy *policy = createPolicy(names[i]);
+        if (!policy) {
+            std::cerr << "Unknown policy " << names[i] << std::endl;
+            continue;
+        }
+
+        SearcherSimulator::CoverageCurve curve;
+        sim.simulate(policy, curve);
+
+        for (unsigned j = 0; j < curve.size(); ++j) {
+            outFile << policy->getName() << "," << curve[j].first << "," << curve[j].second << std::endl;
+        }
+
+        std::cout << policy->getName() << "  " << Cost << "  "
+                  << getTimeToCoverage(curve, sim.getBlockCount(), 50) << "  "
+                  << getTimeToCoverage(curve, sim.getBlockCount(), 90) << "  "
+                  << getTimeToCoverage(curve, sim.getBlockCount(), 100) << std::endl;
+
+        delete policy;
+    }
+
+    return 0;
+}
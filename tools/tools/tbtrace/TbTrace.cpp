@@ -78,6 +78,14 @@ cl::list<unsigned>
     PathList("pathId",
              cl::desc("Path id to output, repeat for more. Empty=all paths"), cl::ZeroOrMore);
 
+cl::list<std::string>
+    PathPrefix("pathPrefix",
+               cl::desc("Output the paths whose fork decisions start with the given bits, as listed by -listPaths. Repeat for more."),
+               cl::ZeroOrMore);
+
+cl::opt<bool>
+        ListPaths("listPaths", cl::desc("Write the fork decisions of every path to paths.txt"), cl::init(false));
+
 cl::opt<std::string>
         PrintRegisters("printRegisters", cl::desc("Print register contents for each block. Requires TranslationBlockTracer."), cl::init(""));
 
@@ -93,14 +101,29 @@ cl::opt<bool>
 cl::opt<bool>
         PrintMemoryCheckerStack("printMemoryCheckerStack", cl::desc("Print stack grants/revocations. Requires the MemoryChecker plugin."), cl::init(false));
 
+cl::opt<bool>
+        Cluster("cluster", cl::desc("Group similar paths and only output one representative per group"), cl::init(false));
+
+cl::opt<unsigned>
+        ClusterHashes("clusterHashes", cl::desc("Size of the MinHash signature of each path"), cl::init(64));
+
+cl::opt<unsigned>
+        ClusterBands("clusterBands", cl::desc("Number of LSH bands, must divide clusterHashes"), cl::init(16));
+
+cl::opt<double>
+        ClusterThreshold("clusterThreshold", cl::desc("Minimum estimated similarity of two paths in the same group"), cl::init(0.8));
+
+cl::opt<unsigned>
+        ClusterNGram("clusterNGram", cl::desc("Compare paths by sequences of this many blocks (1 = sets of blocks)"), cl::init(1));
+
 
 }
 
 namespace s2etools
 {
 
-TbTrace::TbTrace(Library *lib, ModuleCache *cache, LogEvents *events, std::ofstream &of)
-    :m_output(of)
+TbTrace::TbTrace(Library *lib, ModuleCache *cache, LogEvents *events, std::ostream &os)
+    :m_output(os)
 {
     m_events = events;
     m_connection = events->onEachItem.connect(
@@ -108,9 +131,6 @@ TbTrace::TbTrace(Library *lib, ModuleCache *cache, LogEvents *events, std::ofstr
             );
     m_cache = cache;
     m_library = lib;
-    m_hasItems = false;
-    m_hasDebugInfo = false;
-    m_hasModuleInfo = false;
 }
 
 TbTrace::~TbTrace()
@@ -118,6 +138,12 @@ TbTrace::~TbTrace()
     m_connection.disconnect();
 }
 
+//The flags follow the paths, processPaths() shares their prefixes
+TbTraceState *TbTrace::getState()
+{
+    return static_cast<TbTraceState*>(m_events->getState(this, &TbTraceState::factory));
+}
+
 bool TbTrace::parseDisassembly(const std::string &listingFile, Disassembly &out)
 {
     //Get the module name
@@ -264,13 +290,13 @@ void TbTrace::printDebugInfo(uint64_t pid, uint64_t pc, unsigned tbSize, bool pr
         return;
     }
     uint64_t relPc = pc - mi->LoadBase + mi->ImageBase;
-    m_output << std::hex << "(" << mi->Name;
+    m_output << std::hex << "(" << mi->getName();
     if (relPc != pc) {
        m_output << " 0x" << relPc;
     }
     m_output << ")";
 
-    m_hasModuleInfo = true;
+    getState()->m_hasModuleInfo = true;
 
     std::string file = "?", function="?";
     uint64_t line=0;
@@ -281,12 +307,12 @@ void TbTrace::printDebugInfo(uint64_t pid, uint64_t pc, unsigned tbSize, bool pr
         }
 
         m_output << " " << file << std::dec << ":" << line << " in " << function;
-        m_hasDebugInfo = true;
+        getState()->m_hasDebugInfo = true;
     }
 
     if (PrintDisassembly && printListing) {
         m_output << std::endl;
-        printDisassembly(mi->Name, relPc, tbSize);
+        printDisassembly(mi->getName(), relPc, tbSize);
     }
 }
 
@@ -425,7 +451,7 @@ void TbTrace::onItem(unsigned traceIndex,
         printDebugInfo(hdr.pid, te->pc, te->size, true);
 
         m_output << std::endl;
-        m_hasItems = true;
+        getState()->m_hasItems = true;
         return;
     }
 
@@ -464,6 +490,43 @@ void TbTrace::onItem(unsigned traceIndex,
     }
 }
 
+TbTraceState::TbTraceState()
+{
+    m_hasItems = false;
+    m_hasModuleInfo = false;
+    m_hasDebugInfo = false;
+}
+
+TbTraceState::~TbTraceState()
+{
+
+}
+
+ItemProcessorState *TbTraceState::factory()
+{
+    return new TbTraceState();
+}
+
+ItemProcessorState *TbTraceState::clone() const
+{
+    return new TbTraceState(*this);
+}
+
+bool TbTraceState::serialize(std::ostream &os) const
+{
+    writeValue(os, m_hasItems);
+    writeValue(os, m_hasModuleInfo);
+    writeValue(os, m_hasDebugInfo);
+    return os.good();
+}
+
+bool TbTraceState::deserialize(std::istream &is)
+{
+    return readValue(is, m_hasItems) &&
+           readValue(is, m_hasModuleInfo) &&
+           readValue(is, m_hasDebugInfo);
+}
+
 TbTraceTool::TbTraceTool()
 {
     m_binaries.setPaths(ModDir);
@@ -474,7 +537,184 @@ TbTraceTool::~TbTraceTool()
 
 }
 
-void TbTraceTool::flatTrace()
+TbTraceFiles::TbTraceFiles(const std::string &outputDir, PathBuilder *pb,
+                           TbTrace *trace, TestCase *testCase)
+{
+    m_outputDir = outputDir;
+    m_pb = pb;
+    m_trace = trace;
+    m_testCase = testCase;
+}
+
+std::ostream *TbTraceFiles::openPath(uint32_t pathId)
+{
+    std::cout << "Writing path " << std::dec << pathId << std::endl;
+
+    std::stringstream ss;
+    ss << m_outputDir << "/" << pathId << ".txt";
+    std::ofstream *traceFile = new std::ofstream(ss.str().c_str());
+    if (!traceFile->is_open()) {
+        std::cerr << "Could not open " << ss.str() << std::endl;
+        delete traceFile;
+        return NULL;
+    }
+
+    return traceFile;
+}
+
+void TbTraceFiles::closePath(uint32_t pathId, std::ostream *os)
+{
+    if (!os) {
+        return;
+    }
+
+    std::ostream &traceFile = *os;
+
+    traceFile << "----------------------" << std::endl;
+
+    //No state means that no item of the path was printed
+    TbTraceState noItems;
+    const TbTraceState *ts = static_cast<TbTraceState*>(m_pb->getState(m_trace, pathId));
+    if (!ts) {
+        ts = &noItems;
+    }
+
+    if (ts->hasDebugInfo() == false) {
+        traceFile << "WARNING: No debug information for any module in the path " << std::dec << pathId << std::endl;
+        traceFile << "WARNING: Make sure you have set the module path properly and the binaries contain debug information."
+                << std::endl << std::endl;
+    }
+
+    if (ts->hasModuleInfo() == false) {
+        traceFile << "WARNING: No module information for any module in the path " << std::dec << pathId << std::endl;
+        traceFile << "WARNING: Make sure to use the ModuleTracer plugin before running this tool."
+                << std::endl << std::endl;
+    }
+
+    if (ts->hasItems() == false ) {
+        traceFile << "WARNING: No basic blocks in the path " << std::dec << pathId << std::endl;
+        traceFile << "WARNING: Make sure to use the TranslationBlockTracer plugin before running this tool. "
+                << std::endl << std::endl;
+    }
+
+    TestCaseState *tcs = static_cast<TestCaseState*>(m_pb->getState(m_testCase, pathId));
+    if (!tcs) {
+        traceFile << "WARNING: No test case in the path " << std::dec << pathId << std::endl;
+        traceFile << "WARNING: Make sure to use the TestCaseGenerator plugin and terminate the states before running this tool. "
+                << std::endl << std::endl;
+    }else {
+        tcs->printInputs(traceFile);
+    }
+
+    delete os;
+}
+
+//Keeps one path of each group of similar paths in selectedPaths
+//and writes the groups to clusters.txt
+bool TbTraceTool::selectRepresentatives(PathBuilder &pb, ModuleCache &mc, TestCase &tc,
+                                        PathSet &selectedPaths)
+{
+    if (ClusterBands == 0 || ClusterHashes % ClusterBands) {
+        std::cerr << "clusterBands must divide clusterHashes" << std::endl;
+        return false;
+    }
+
+    //Only the selected paths need a signature
+    PathSignature signature(&pb, &mc, ClusterHashes, ClusterNGram);
+    if (!pb.processPaths(selectedPaths)) {
+        std::cerr << "Could not compute the signatures of some of the paths" << std::endl;
+        return false;
+    }
+
+    PathClusters clusters(ClusterBands, ClusterThreshold);
+    PathSignatureState noBlocks;
+
+    PathSet::const_iterator pit;
+    for (pit = selectedPaths.begin(); pit != selectedPaths.end(); ++pit) {
+        const PathSignatureState *sig = static_cast<PathSignatureState*>(pb.getState(&signature, *pit));
+        const TestCaseState *tcs = static_cast<TestCaseState*>(pb.getState(&tc, *pit));
+        clusters.addPath(*pit, sig ? sig : &noBlocks, tcs && tcs->hasInputs());
+    }
+
+    PathClusters::Clusters groups;
+    clusters.getClusters(groups);
+
+    std::string clustersFileStr = LogDir + "/clusters.txt";
+    std::ofstream clustersFile(clustersFileStr.c_str());
+    clustersFile << "#Representative PathCount Paths" << std::endl;
+
+    selectedPaths.clear();
+
+    PathClusters::Clusters::const_iterator it;
+    for (it = groups.begin(); it != groups.end(); ++it) {
+        const std::vector<uint32_t> &members = (*it).second;
+        selectedPaths.insert((*it).first);
+
+        clustersFile << std::dec << (*it).first << " " << members.size() << " ";
+        for (unsigned i = 0; i < members.size(); ++i) {
+            clustersFile << (i ? "," : "") << members[i];
+        }
+        clustersFile << std::endl;
+
+        TestCaseState *tcs = static_cast<TestCaseState*>(pb.getState(&tc, (*it).first));
+        if (tcs && tcs->hasInputs()) {
+            clustersFile << "  ";
+            tcs->printInputsLine(clustersFile);
+            clustersFile << std::endl;
+        }
+    }
+
+    std::cout << "Grouped " << clusters.getPathCount() << " paths into "
+              << groups.size() << " clusters" << std::endl;
+    return true;
+}
+
+//Fork decisions of every path, one bit per binary fork
+void TbTraceTool::listPaths(PathBuilder &pb, const SuccinctTree &tree)
+{
+    //Both are in depth-first order
+    EncodedPaths encoded;
+    pb.enumeratePaths(encoded);
+    assert(encoded.size() == tree.getLeafCount());
+
+    std::string pathsFileStr = LogDir + "/paths.txt";
+    std::ofstream pathsFile(pathsFileStr.c_str());
+    pathsFile << "#PathId ForkDecisions" << std::endl;
+
+    for (unsigned i = 0; i < encoded.size(); ++i) {
+        pathsFile << std::dec << tree.getLeafStateId(i) << " ";
+        encoded[i].print(pathsFile);
+        pathsFile << std::endl;
+    }
+}
+
+//Adds the paths below the node reached by the fork decisions in prefix
+bool TbTraceTool::selectPrefix(const SuccinctTree &tree, const std::string &prefix,
+                               PathSet &selectedPaths)
+{
+    EncodedPath path;
+    for (unsigned i = 0; i < prefix.size(); ++i) {
+        if (prefix[i] != '0' && prefix[i] != '1') {
+            return false;
+        }
+        path.append(prefix[i] == '1', 1);
+    }
+
+    uint64_t node = tree.decodePath(path);
+    if (node == SuccinctTree::NONE) {
+        return false;
+    }
+
+    //The leaves of a subtree are numbered consecutively
+    uint64_t first = tree.getLeafIndex(node);
+    uint64_t last = tree.getLeafIndex(tree.findClose(node));
+    for (uint64_t k = first; k < last; ++k) {
+        selectedPaths.insert(tree.getLeafStateId(k));
+    }
+    return true;
+}
+
+bool TbTraceTool::flatTrace()
 {
     PathBuilder pb(&m_parser);
     m_parser.parse(TraceFiles);
@@ -485,67 +725,54 @@ void TbTraceTool::flatTrace()
     PathSet paths;
     pb.getPaths(paths);
 
-    cl::list<unsigned>::const_iterator listit;
+    PathSet selectedPaths;
 
-    if (PathList.empty()) {
-        PathSet::iterator pit;
-        for (pit = paths.begin(); pit != paths.end(); ++pit) {
-            PathList.push_back(*pit);
-        }
+    SuccinctTree *tree = NULL;
+    if (ListPaths || !PathPrefix.empty()) {
+        tree = new SuccinctTree(pb.getRoot());
     }
 
-    //XXX: this is efficient only for short paths or for a small number of
-    //path, because complexity is O(n2): we reprocess the prefixes.
-    for(listit = PathList.begin(); listit != PathList.end(); ++listit) {
-        std::cout << "Processing path " << std::dec << *listit << std::endl;
-        PathSet::iterator pit = paths.find(*listit);
-        if (pit == paths.end()) {
-            std::cerr << "Could not find path with id " << std::dec <<
-                    *listit << " in the execution trace." << std::endl;
-            continue;
-        }
-
-        std::stringstream ss;
-        ss << LogDir << "/" << *listit << ".txt";
-        std::ofstream traceFile(ss.str().c_str());
-
-        TbTrace trace(&m_binaries, &mc, &pb, traceFile);
+    if (ListPaths) {
+        listPaths(pb, *tree);
+    }
 
-        if (!pb.processPath(*listit)) {
-            std::cerr << "Could not process path " << std::dec << *listit << std::endl;
-            continue;
+    if (PathList.empty() && PathPrefix.empty()) {
+        selectedPaths = paths;
+    } else {
+        cl::list<unsigned>::const_iterator listit;
+        for(listit = PathList.begin(); listit != PathList.end(); ++listit) {
+            if (paths.find(*listit) == paths.end()) {
+                std::cerr << "Could not find path with id " << std::dec <<
+                        *listit << " in the execution trace." << std::endl;
+                continue;
+            }
+            selectedPaths.insert(*listit);
         }
 
-        traceFile << "----------------------" << std::endl;
-
-        if (trace.hasDebugInfo() == false) {
-            traceFile << "WARNING: No debug information for any module in the path " << std::dec << *listit << std::endl;
-            traceFile << "WARNING: Make sure you have set the module path properly and the binaries contain debug information."
-                    << std::endl << std::endl;
+        cl::list<std::string>::const_iterator prefixit;
+        for (prefixit = PathPrefix.begin(); prefixit != PathPrefix.end(); ++prefixit) {
+            if (!selectPrefix(*tree, *prefixit, selectedPaths)) {
+                std::cerr << "No path has the fork decisions " << *prefixit << std::endl;
+            }
         }
+    }
 
-        if (trace.hasModuleInfo() == false) {
-            traceFile << "WARNING: No module information for any module in the path " << std::dec << *listit << std::endl;
-            traceFile << "WARNING: Make sure to use the ModuleTracer plugin before running this tool."
-                    << std::endl << std::endl;
-        }
+    delete tree;
 
-        if (trace.hasItems() == false ) {
-            traceFile << "WARNING: No basic blocks in the path " << std::dec << *listit << std::endl;
-            traceFile << "WARNING: Make sure to use the TranslationBlockTracer plugin before running this tool. "
-                    << std::endl << std::endl;
-        }
+    if (Cluster && !selectRepresentatives(pb, mc, tc, selectedPaths)) {
+        return false;
+    }
 
-        TestCaseState *tcs = static_cast<TestCaseState*>(pb.getState(&tc, *pit));
-        if (!tcs) {
-            traceFile << "WARNING: No test case in the path " << std::dec << *listit << std::endl;
-            traceFile << "WARNING: Make sure to use the TestCaseGenerator plugin and terminate the states before running this tool. "
-                    << std::endl << std::endl;
-        }else {
-            tcs->printInputs(traceFile);
-        }
+    //Shared prefixes of the selected paths are processed only once
+    TbTrace trace(&m_binaries, &mc, &pb, pb.getOutput());
+    TbTraceFiles files(LogDir, &pb, &trace, &tc);
+
+    if (!pb.processPaths(selectedPaths, &files)) {
+        std::cerr << "Could not process some of the paths" << std::endl;
     }
 
+    m_binaries.getSymbolCache().printStats(std::cout);
+    return true;
 }
 
 }
@@ -555,7 +782,9 @@ int main(int argc, char **argv)
     cl::ParseCommandLineOptions(argc, (char**) argv, " tbtrace");
 
     s2etools::TbTraceTool trace;
-    trace.flatTrace();
+    if (!trace.flatTrace()) {
+        return -1;
+    }
 
     return 0;
 }
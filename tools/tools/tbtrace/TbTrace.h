@@ -38,6 +38,9 @@
 
 #include <lib/ExecutionTracer/LogParser.h>
 #include <lib/ExecutionTracer/ModuleParser.h>
+#include <lib/ExecutionTracer/Path.h>
+#include <lib/ExecutionTracer/TestCase.h>
+#include <lib/ExecutionTracer/PathSignature.h>
 
 #include <ostream>
 #include <fstream>
@@ -48,6 +51,41 @@
 namespace s2etools
 {
 
+//What the trace of a path contains, for the warnings at the end of the path
+class TbTraceState : public ItemProcessorState
+{
+private:
+    bool m_hasItems;
+    bool m_hasModuleInfo;
+    bool m_hasDebugInfo;
+
+public:
+    TbTraceState();
+    virtual ~TbTraceState();
+
+    static ItemProcessorState *factory();
+    virtual ItemProcessorState *clone() const;
+    virtual bool serialize(std::ostream &os) const;
+    virtual bool deserialize(std::istream &is);
+    virtual uint64_t getMemoryUsage() const {
+        return sizeof(*this);
+    }
+
+    bool hasItems() const {
+        return m_hasItems;
+    }
+
+    bool hasModuleInfo() const {
+        return m_hasModuleInfo;
+    }
+
+    bool hasDebugInfo() const {
+        return m_hasDebugInfo;
+    }
+
+    friend class TbTrace;
+};
+
 class TbTrace
 {
 public:
@@ -71,13 +109,11 @@ private:
     Library *m_library;
     Disassembly m_disassembly;
     ModuleBasicBlocks m_basicBlocks;
-    std::ofstream &m_output;
+    std::ostream &m_output;
 
     sigc::connection m_connection;
 
-    bool m_hasItems;
-    bool m_hasModuleInfo;
-    bool m_hasDebugInfo;
+    TbTraceState *getState();
 
     void onItem(unsigned traceIndex,
                 const s2e::plugins::ExecutionTraceItemHeader &hdr,
@@ -90,22 +126,27 @@ private:
     void printRegisters(const s2e::plugins::ExecutionTraceTb *te, std::string &arch);
     void printMemoryChecker(const s2e::plugins::ExecutionTraceMemChecker::Serialized *item);
 public:
-    TbTrace(Library *lib, ModuleCache *cache, LogEvents *events, std::ofstream &ofs);
+    TbTrace(Library *lib, ModuleCache *cache, LogEvents *events, std::ostream &os);
     virtual ~TbTrace();
 
     void outputTraces(const std::string &Path) const;
-    bool hasItems() const {
-        return m_hasItems;
-    }
+};
 
-    bool hasModuleInfo() const {
-        return m_hasModuleInfo;
-    }
+//Writes each path into its own file in the output directory
+class TbTraceFiles: public PathOutputSink
+{
+private:
+    std::string m_outputDir;
+    PathBuilder *m_pb;
+    TbTrace *m_trace;
+    TestCase *m_testCase;
 
-    bool hasDebugInfo() const {
-        return m_hasDebugInfo;
-    }
+public:
+    TbTraceFiles(const std::string &outputDir, PathBuilder *pb,
+                 TbTrace *trace, TestCase *testCase);
 
+    virtual std::ostream *openPath(uint32_t pathId);
+    virtual void closePath(uint32_t pathId, std::ostream *os);
 };
 
 class TbTraceTool
@@ -115,12 +156,19 @@ private:
 
     Library m_binaries;
 
+    bool selectRepresentatives(PathBuilder &pb, ModuleCache &mc, TestCase &tc,
+                               PathSet &selectedPaths);
+
+    void listPaths(PathBuilder &pb, const SuccinctTree &tree);
+    bool selectPrefix(const SuccinctTree &tree, const std::string &prefix,
+                      PathSet &selectedPaths);
+
 public:
     TbTraceTool();
     ~TbTraceTool();
 
     void process();
-    void flatTrace();
+    bool flatTrace();
 };
 
 
@@ -0,0 +1,104 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#define __STDC_FORMAT_MACROS 1
+
+#include "llvm/Support/CommandLine.h"
+
+#include <lib/ExecutionTracer/Path.h>
+#include <lib/ExecutionTracer/TreeStatistics.h>
+
+#include <s2e/Plugins/ExecutionTracers/TraceEntries.h>
+
+#include <fstream>
+#include <iostream>
+
+using namespace llvm;
+using namespace s2etools;
+
+
+namespace {
+
+cl::list<std::string>
+    TraceFiles("trace", llvm::cl::value_desc("Input trace"), llvm::cl::Prefix,
+               llvm::cl::desc("Specify an execution trace file"));
+
+cl::opt<std::string>
+    LogDir("outputdir", cl::desc("Store the report into the given folder"), cl::init("."));
+
+cl::opt<std::string>
+    Format("format", cl::desc("Format of the report (csv/json)"), cl::init("csv"));
+
+cl::opt<bool>
+    MultiTrace("multitrace", cl::desc("The traces come from parallel S2E workers, stitch them into one tree"), cl::init(false));
+
+}
+
+int main(int argc, char **argv)
+{
+    cl::ParseCommandLineOptions(argc, (char**) argv, " treestats");
+
+    if (Format != "csv" && Format != "json") {
+        std::cerr << "Unknown format " << Format << std::endl;
+        return -1;
+    }
+
+    LogParser parser;
+    PathBuilder pb(&parser, MultiTrace);
+    parser.parse(TraceFiles);
+    if (MultiTrace && !pb.stitchTraces()) {
+        std::cerr << "Could not stitch the traces";
+        for (unsigned i = 0; i < TraceFiles.size(); ++i) {
+            std::cerr << " " << TraceFiles[i];
+        }
+        std::cerr << std::endl;
+        return -1;
+    }
+
+    //The shape of the tree does not require processing the items
+    TreeStatistics stats(&parser, &pb);
+    stats.compute();
+
+    std::string outFileStr = LogDir + "/treestats." + Format;
+    std::ofstream outFile(outFileStr.c_str());
+
+    if (Format == "json") {
+        stats.writeJson(outFile);
+    } else {
+        stats.writeCsv(outFile);
+    }
+
+    return 0;
+}
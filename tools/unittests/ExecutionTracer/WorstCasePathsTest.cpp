@@ -0,0 +1,186 @@
+/*
+ * S2E Selective Symbolic Execution Framework
+ *
+ * Copyright (c) 2010, Dependable Systems Laboratory, EPFL
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the Dependable Systems Laboratory, EPFL nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE DEPENDABLE SYSTEMS LABORATORY, EPFL BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Currently maintained by:
+ *    Vitaly Chipounov <vitaly.chipounov@epfl.ch>
+ *    Volodymyr Kuznetsov <vova.kuznetsov@epfl.ch>
+ *
+ * All contributors are listed in the S2E-AUTHORS file.
+ */
+
+#include <lib/ExecutionTracer/LogParser.h>
+#include <lib/ExecutionTracer/Path.h>
+#include <lib/ExecutionTracer/WorstCasePaths.h>
+
+#include <s2e/Plugins/ExecutionTracers/TraceEntries.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <iostream>
+#include <vector>
+
+using namespace s2etools;
+using namespace s2e::plugins;
+
+namespace {
+
+unsigned s_failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " << #cond << " failed" << std::endl; \
+            ++s_failures; \
+        } \
+    } while (0)
+
+class TraceWriter
+{
+private:
+    FILE *m_file;
+    uint64_t m_timeStamp;
+
+public:
+    TraceWriter(FILE *file) : m_file(file), m_timeStamp(0) {}
+
+    void writeItem(uint32_t stateId, uint8_t type, const void *data, unsigned size) {
+        ExecutionTraceItemHeader hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.timeStamp = m_timeStamp++;
+        hdr.size = size;
+        hdr.type = type;
+        hdr.stateId = stateId;
+        fwrite(&hdr, sizeof(hdr), 1, m_file);
+        fwrite(data, size, 1, m_file);
+    }
+
+    void pageFault(uint32_t stateId) {
+        ExecutionTracePageFault pf;
+        memset(&pf, 0, sizeof(pf));
+        writeItem(stateId, TRACE_PAGEFAULT, &pf, sizeof(pf));
+    }
+
+    //The forking state continues as the first child
+    void fork(uint32_t stateId, uint32_t newStateId) {
+        std::vector<uint8_t> buffer(sizeof(ExecutionTraceFork) + sizeof(uint32_t));
+        ExecutionTraceFork *f = (ExecutionTraceFork*) &buffer[0];
+        f->pc = 0x1000;
+        f->stateCount = 2;
+        f->children[0] = stateId;
+        f->children[1] = newStateId;
+        writeItem(stateId, TRACE_FORK, &buffer[0], sizeof(ExecutionTraceFork) + sizeof(uint32_t));
+    }
+};
+
+//State 0 forks state 1 after two page faults, then takes three more.
+//State 1 forks 20 times and takes one page fault, its forks none.
+//The subtree of state 1 has 41 segments and cannot hold the worst path.
+bool writeTrace(const std::string &path)
+{
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+
+    TraceWriter w(file);
+    w.pageFault(0);
+    w.pageFault(0);
+    w.fork(0, 1);
+    for (unsigned i = 0; i < 3; ++i) {
+        w.pageFault(0);
+    }
+
+    for (uint32_t id = 2; id < 22; ++id) {
+        w.fork(1, id);
+    }
+    w.pageFault(1);
+
+    fclose(file);
+    return true;
+}
+
+void testPruning(const std::string &traceFile)
+{
+    LogParser parser;
+    PathBuilder pb(&parser);
+    CHECK(parser.parse(traceFile));
+
+    PathSet paths;
+    pb.getPaths(paths);
+    CHECK(paths.size() == 22);
+
+    WorstCasePaths search(&parser, &pb, WorstCasePaths::PAGE_FAULTS);
+    WorstCasePaths::Results results;
+
+    //The root and the leaf of state 0, the other subtree is pruned
+    search.search(1, results);
+    CHECK(results.size() == 1);
+    CHECK(results.size() == 1 && results[0].pathId == 0 && results[0].cost == 5);
+    CHECK(search.getVisitedSegments() == 2);
+    CHECK(search.getExpandedSegments() == 1);
+
+    //The second path goes down the chain of state 1, the states
+    //forked along it are pushed on the frontier but never visited
+    search.search(2, results);
+    CHECK(results.size() == 2);
+    CHECK(results.size() == 2 && results[1].pathId == 1 && results[1].cost == 3);
+    CHECK(search.getVisitedSegments() == 23);
+    CHECK(search.getExpandedSegments() == 21);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    char traceFile[] = "/tmp/worstcasepaths-XXXXXX";
+    int fd = mkstemp(traceFile);
+    if (fd < 0) {
+        std::cerr << "Could not create a temporary trace" << std::endl;
+        return -1;
+    }
+    close(fd);
+
+    if (!writeTrace(traceFile)) {
+        std::cerr << "Could not write " << traceFile << std::endl;
+        unlink(traceFile);
+        return -1;
+    }
+
+    testPruning(traceFile);
+    unlink(traceFile);
+
+    if (s_failures) {
+        std::cerr << s_failures << " check(s) failed" << std::endl;
+        return -1;
+    }
+
+    std::cout << "WorstCasePaths: all checks passed" << std::endl;
+    return 0;
+}